@@ -224,11 +224,13 @@ void Image::set_color(float r, float g, float b) {
         image_data = std::vector<float>(number_of_elements(), r);
     } else if (dimensions() >= 3) {
         for(int i = 0; i < width() * height(); ++i) {
-            image_data[i] = r;
+            // pixel i starts at i * stride_[0] in either layout
+            size_t p = static_cast<size_t>(i) * stride_[0];
+            image_data[p] = r;
             if (channels() > 1) // have second channel
-                image_data[i + stride_[2]] = g;
+                image_data[p + stride_[2]] = g;
             if (channels() > 2) // have third channel
-                image_data[i + 2 * stride_[2]] = b;
+                image_data[p + 2 * stride_[2]] = b;
         }
     }
 }
@@ -319,7 +321,59 @@ Image::Image(int x, int y, int z, const std::string &name_) {
 
 }
 
+Image::Image(int x, int y, int z, ImageLayout layout, const std::string &name_)
+  : Image(x, y, z, name_)
+{
+    if (layout == IMAGE_INTERLEAVED && dims == 3) {
+        stride_[0] = z;
+        stride_[1] = x * z;
+        stride_[2] = 1;
+    }
+    layout_ = layout;
+}
+
+Image::Image(const ImageView &view)
+  : Image(view.extent(0), view.extent(1), view.extent(2), view.layout())
+{
+    copyValues(view, *this);
+}
+
+Image Image::toLayout(ImageLayout layout) const {
+    if (layout == layout_ || dims < 3) {
+        Image copy = *this;
+        copy.layout_ = layout;
+        return copy;
+    }
+    Image out(width(), height(), channels(), layout, image_name);
+    int w = width(), c = channels();
+    for (int y = 0; y < height(); ++y) {
+        const float *src = &image_data[y * stride_[1]];
+        float *dst = &out.image_data[y * out.stride_[1]];
+        if (c == 3 && layout == IMAGE_INTERLEAVED) {
+            const float *r = src, *g = src + stride_[2], *b = src + 2 * stride_[2];
+            for (int x = 0; x < w; ++x) {
+                dst[3 * x] = r[x];
+                dst[3 * x + 1] = g[x];
+                dst[3 * x + 2] = b[x];
+            }
+        } else if (c == 3) {
+            float *r = dst, *g = dst + out.stride_[2], *b = dst + 2 * out.stride_[2];
+            for (int x = 0; x < w; ++x) {
+                r[x] = src[3 * x];
+                g[x] = src[3 * x + 1];
+                b[x] = src[3 * x + 2];
+            }
+        } else {
+            for (int z = 0; z < c; ++z)
+                for (int x = 0; x < w; ++x)
+                    dst[x * out.stride_[0] + z * out.stride_[2]] = src[x * stride_[0] + z * stride_[2]];
+        }
+    }
+    return out;
+}
+
 void Image::initialize_image_metadata(int x, int y, int z,  const std::string &name_) {
+    layout_ = IMAGE_PLANAR;
     dim_values[0] = 0;
     dim_values[1] = 0;
     dim_values[2] = 0;
@@ -399,11 +453,11 @@ void Image::write(const std::string &filename) const {
     for (int x= 0; x < width(); x++) {
         for (int y = 0; y < height(); y++) {
             for (c = 0; c < channels(); c++) {
-                uint8_image[c + x*png_channels + y*png_channels*width()] = float_to_uint8(image_data[x+y*width()+c*width()*height()]);
+                uint8_image[c + x*png_channels + y*png_channels*width()] = float_to_uint8(image_data[x*stride_[0]+y*stride_[1]+c*stride_[2]]);
             }
             for ( ; c < 3; c++) { // Only executes when there is one channel
 
-                uint8_image[c + x*png_channels + y*png_channels*width()] = float_to_uint8(image_data[x+y*width()+0*width()*height()]);
+                uint8_image[c + x*png_channels + y*png_channels*width()] = float_to_uint8(image_data[x*stride_[0]+y*stride_[1]]);
             }
         }
     }
@@ -433,7 +487,7 @@ unsigned char Image::float_to_uint8(const float &in) {
 
 }
 
-void compareDimensions(const Image & im1, const Image & im2)  {
+void compareDimensions(const ImageView & im1, const ImageView & im2)  {
     if(im1.dimensions() != im2.dimensions())
         throw MismatchedDimensionsException();
     for (int i = 0; i < im1.dimensions(); i++ ) {
@@ -442,120 +496,129 @@ void compareDimensions(const Image & im1, const Image & im2)  {
     }
 }
 
-
-Image operator+ (const Image & im1, const Image & im2) {
-    compareDimensions(im1, im2);
-    long long total_pixels = im1.number_of_elements();
-
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) + im2(i);
+void copyValues(const ImageView &src, const MutableImageView &dst) {
+    compareDimensions(src, dst);
+    if (src.width() == 0)
+        return;
+    int s = src.stride(0), d = dst.stride(0);
+    for (int z = 0; z < std::max(src.channels(), 1); z++) {
+        for (int y = 0; y < std::max(src.height(), 1); y++) {
+            const float *in = &src.at(0, y, z);
+            float *out = &dst.at(0, y, z);
+            for (int x = 0; x < src.width(); x++)
+                out[x * d] = in[x * s];
+        }
     }
-    return output;
 }
 
-Image operator- (const Image & im1, const Image & im2) {
-    compareDimensions(im1, im2);
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) - im2(i);
+// An image of the dimensions and layout of im1 holding f of the values of
+// the same coordinates in im1 (and im2), visited a row at a time
+template <typename F>
+static Image mapValues(const ImageView & im1, F f) {
+    Image output(im1.extent(0), im1.extent(1), im1.extent(2), im1.layout());
+    if (im1.width() == 0)
+        return output;
+    int s1 = im1.stride(0), so = output.stride(0);
+    for (int z = 0; z < std::max(im1.channels(), 1); z++) {
+        for (int y = 0; y < std::max(im1.height(), 1); y++) {
+            const float *in1 = &im1.at(0, y, z);
+            float *out = &output.at(0, y, z);
+            if (s1 == 1 && so == 1) {
+                for (int x = 0; x < im1.width(); x++)
+                    out[x] = f(in1[x]);
+            } else {
+                for (int x = 0; x < im1.width(); x++)
+                    out[x * so] = f(in1[x * s1]);
+            }
+        }
     }
     return output;
 }
 
-Image operator* (const Image & im1, const Image & im2) {
+template <typename F>
+static Image mapValues(const ImageView & im1, const ImageView & im2, F f) {
     compareDimensions(im1, im2);
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) * im2(i);
+    Image output(im1.extent(0), im1.extent(1), im1.extent(2), im1.layout());
+    if (im1.width() == 0)
+        return output;
+    int s1 = im1.stride(0), s2 = im2.stride(0), so = output.stride(0);
+    for (int z = 0; z < std::max(im1.channels(), 1); z++) {
+        for (int y = 0; y < std::max(im1.height(), 1); y++) {
+            const float *in1 = &im1.at(0, y, z);
+            const float *in2 = &im2.at(0, y, z);
+            float *out = &output.at(0, y, z);
+            if (s1 == 1 && s2 == 1 && so == 1) {
+                for (int x = 0; x < im1.width(); x++)
+                    out[x] = f(in1[x], in2[x]);
+            } else {
+                for (int x = 0; x < im1.width(); x++)
+                    out[x * so] = f(in1[x * s1], in2[x * s2]);
+            }
+        }
     }
     return output;
+}
 
+
+Image operator+ (const ImageView & im1, const ImageView & im2) {
+    return mapValues(im1, im2, [](float a, float b) { return a + b; });
 }
 
-Image operator/ (const Image & im1, const Image & im2) {
-    compareDimensions(im1, im2);
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        if (im2(i) == 0)
+Image operator- (const ImageView & im1, const ImageView & im2) {
+    return mapValues(im1, im2, [](float a, float b) { return a - b; });
+}
+
+Image operator* (const ImageView & im1, const ImageView & im2) {
+    return mapValues(im1, im2, [](float a, float b) { return a * b; });
+}
+
+Image operator/ (const ImageView & im1, const ImageView & im2) {
+    return mapValues(im1, im2, [](float a, float b) {
+        if (b == 0)
             throw DivideByZeroException();
-        output(i) = im1(i) / im2(i);
-    }
-    return output;
+        return a / b;
+    });
 }
 
-Image operator+ (const Image & im1, const float & c) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) + c;
-    }
-    return output;
+Image operator+ (const ImageView & im1, const float & c) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return a + k; });
 }
 
-Image operator- (const Image & im1, const float & c) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) -  c;
-    }
-    return output;
+Image operator- (const ImageView & im1, const float & c) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return a - k; });
 }
-Image operator* (const Image & im1, const float & c) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) * c;
-    }
-    return output;
+Image operator* (const ImageView & im1, const float & c) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return a * k; });
 }
-Image operator/ (const Image & im1, const float & c) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
+Image operator/ (const ImageView & im1, const float & c) {
     if (c==0)
         throw DivideByZeroException();
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i)/c;
-    }
-    return output;
+    float k = c;
+    return mapValues(im1, [k](float a) { return a / k; });
 }
 
-Image operator+(const float & c, const Image & im1) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) + c;
-    }
-    return output;
+Image operator+(const float & c, const ImageView & im1) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return a + k; });
 }
 
-Image operator- (const float & c, const Image & im1) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = c - im1(i);
-    }
-    return output;
+Image operator- (const float & c, const ImageView & im1) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return k - a; });
 }
 
-Image operator* (const float & c, const Image & im1) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        output(i) = im1(i) * c;
-    }
-    return output;
+Image operator* (const float & c, const ImageView & im1) {
+    float k = c;
+    return mapValues(im1, [k](float a) { return a * k; });
 }
-Image operator/ (const float & c, const Image & im1) {
-    long long total_pixels = im1.number_of_elements();
-    Image output(im1.extent(0), im1.extent(1), im1.extent(2));
-    for (int i = 0 ; i < total_pixels; i++) {
-        if (im1(i) == 0)
+Image operator/ (const float & c, const ImageView & im1) {
+    float k = c;
+    return mapValues(im1, [k](float a) {
+        if (a == 0)
             throw DivideByZeroException();
-        output(i) = c/im1(i);
-    }
-    return output;
+        return k / a;
+    });
 }
@@ -17,10 +17,55 @@
 #include <sstream>
 #include <cfloat>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
 
 #include "ImageException.h"
 #include "lodepng.h"
 
+// The fast path accessors below (plane, row, span, at) do no range checks,
+// unless IMAGE_CHECK_BOUNDS is defined (make DEBUG=1), in which case they
+// throw OutOfBoundsException like operator() does. The row accessors always
+// throw LayoutException on an image whose rows are not contiguous.
+#ifdef IMAGE_CHECK_BOUNDS
+#define IMAGE_BOUNDS_CHECK(inside) do { if (!(inside)) throw OutOfBoundsException(); } while (0)
+#else
+#define IMAGE_BOUNDS_CHECK(inside) ((void)0)
+#endif
+
+// How the values of an Image are stored. Planar images hold each channel as
+// a plane of rows (stride x = 1, y = width, channel = width * height), which
+// suits kernels that work on one channel at a time. Interleaved images hold
+// the channels of a pixel next to each other (stride x = channels,
+// y = width * channels, channel = 1), which suits kernels that read every
+// channel of a pixel together. Single channel images are the same in both.
+enum ImageLayout {
+    IMAGE_PLANAR,
+    IMAGE_INTERLEAVED
+};
+
+// The contiguous values of one row of one channel of an Image, usable with
+// range for and the standard algorithms through begin() and end()
+template <typename T>
+class ImageRowSpan {
+public:
+    ImageRowSpan(T *data_, int size_) : values(data_), n(size_) {}
+
+    T * begin() const { return values; }
+    T * end() const { return values + n; }
+    T * data() const { return values; }
+    int size() const { return n; }
+    T & operator[](int x) const { IMAGE_BOUNDS_CHECK(x >= 0 && x < n); return values[x]; }
+
+private:
+    T *values;
+    int n;
+};
+
+template <typename T> class BasicImageView;
+typedef BasicImageView<const float> ImageView;
+typedef BasicImageView<float> MutableImageView;
+
 class Image {
 public:
     // Constructor to initialize an image of size width_*height_*channels_
@@ -28,9 +73,15 @@ public:
     // If channels_ is zero, the image will be two dimensional
     Image(int width_, int height_ = 0, int channels_ = 0,  const std::string &name="");
 
+    // Same, with the given layout (the constructor above is planar)
+    Image(int width_, int height_, int channels_, ImageLayout layout_, const std::string &name="");
+
     // Constructor to create an image from a file. The file needs to be in the PNG format
     Image(const std::string & filename);
 
+    // Copy of the values a view looks at, in the layout of its image
+    explicit Image(const ImageView &view);
+
     // Destructor. Because there is no explicit memory management here, this doesn't do anything
     ~Image();
 
@@ -50,6 +101,12 @@ public:
 
     int extent(int dim) const { return dim_values[dim]; } // Size of dimension
 
+    ImageLayout layout() const { return layout_; }
+
+    // A copy of the image stored with the given layout, converted a row at a
+    // time. Values read through operator() are the same.
+    Image toLayout(ImageLayout layout) const;
+
     // Write an image to a file.
     void write(const std::string & filename) const;
     void debug_write() const; // Writes image to Output directory with automatically chosen name
@@ -69,6 +126,55 @@ public:
     float & operator()(int x, int y);
     float & operator()(int x, int y, int z);
 
+    // Fast path access for inner loops that have already clipped their range
+    // to the image (see IMAGE_CHECK_BOUNDS above).
+    // at(x, y, z): the value operator() returns, in either layout
+    // pixel(x, y): channel 0 of pixel (x, y), channel z is stride(2) * z further
+    // The row accessors need rows of contiguous values (stride(0) is 1), that
+    // is a planar or a single channel image, and throw LayoutException
+    // otherwise:
+    // plane(z): first value of channel z
+    // row(y, z): first value of row y in channel z
+    // span(y, z): the same row as a range of width values
+    float * plane(int z) {
+        if (stride_[0] != 1)
+            throw LayoutException();
+        IMAGE_BOUNDS_CHECK(z >= 0 && z < std::max(channels(), 1));
+        return image_data.data() + static_cast<size_t>(z) * stride_[2];
+    }
+    const float * plane(int z) const {
+        if (stride_[0] != 1)
+            throw LayoutException();
+        IMAGE_BOUNDS_CHECK(z >= 0 && z < std::max(channels(), 1));
+        return image_data.data() + static_cast<size_t>(z) * stride_[2];
+    }
+    float * row(int y, int z = 0) {
+        IMAGE_BOUNDS_CHECK(y >= 0 && y < std::max(height(), 1));
+        return plane(z) + static_cast<size_t>(y) * stride_[1];
+    }
+    const float * row(int y, int z = 0) const {
+        IMAGE_BOUNDS_CHECK(y >= 0 && y < std::max(height(), 1));
+        return plane(z) + static_cast<size_t>(y) * stride_[1];
+    }
+    ImageRowSpan<float> span(int y, int z = 0) { return ImageRowSpan<float>(row(y, z), width()); }
+    ImageRowSpan<const float> span(int y, int z = 0) const { return ImageRowSpan<const float>(row(y, z), width()); }
+    float * pixel(int x, int y) {
+        IMAGE_BOUNDS_CHECK(x >= 0 && x < width() && y >= 0 && y < std::max(height(), 1));
+        return image_data.data() + static_cast<size_t>(x) * stride_[0] + static_cast<size_t>(y) * stride_[1];
+    }
+    const float * pixel(int x, int y) const {
+        IMAGE_BOUNDS_CHECK(x >= 0 && x < width() && y >= 0 && y < std::max(height(), 1));
+        return image_data.data() + static_cast<size_t>(x) * stride_[0] + static_cast<size_t>(y) * stride_[1];
+    }
+    float & at(int x, int y, int z = 0) {
+        IMAGE_BOUNDS_CHECK(z >= 0 && z < std::max(channels(), 1));
+        return pixel(x, y)[static_cast<size_t>(z) * stride_[2]];
+    }
+    const float & at(int x, int y, int z = 0) const {
+        IMAGE_BOUNDS_CHECK(z >= 0 && z < std::max(channels(), 1));
+        return pixel(x, y)[static_cast<size_t>(z) * stride_[2]];
+    }
+
     // set image pixels to corresponding values (only if channel is valid)
     void set_color(float r = 0.0f, float g = 0.0f, float b = 0.0f);
 
@@ -101,9 +207,12 @@ public:
 // The "private" section contains functions and variables that cannot be
 // accessed from outside the class.
 private:
+    template <typename T> friend class BasicImageView;
+
     unsigned int dims;          // Number of dimensions
     unsigned int dim_values[3]; // Size of each dimension
     unsigned int stride_[3];    // strides
+    ImageLayout layout_;        // which of the strides above is 1 for 3 dimensional images
     std::string image_name;     // Image name, will be the filename if read from a file
 
     // This vector stores the values of the pixels. A vector in C++ is an array
@@ -120,25 +229,151 @@ private:
     void initialize_image_metadata(int x, int y, int z, const std::string &name_);
 };
 
-void compareDimensions(const Image & im1, const Image & im2);
+// A window onto values of an Image that it does not own: a width x height x
+// channels box of the image's buffer, walked with the image's strides.
+// Crops, tiles and single channels of an image are views of its buffer, so
+// they cost nothing to make or copy, and the functions that take a
+// const ImageView & (the operators below, the filters, the resamplers)
+// accept them as well as whole images. A view is only valid while its
+// image lives and is not reassigned.
+// ImageView reads the values and MutableImageView can also write them. An
+// Image converts implicitly to either, a MutableImageView to an ImageView.
+// Accessors are those of Image, with the same checks; the row accessors
+// need stride(0) to be 1, which crops and channels of a planar image keep.
+template <typename T>
+class BasicImageView {
+public:
+    typedef typename std::conditional<std::is_const<T>::value, const Image, Image>::type ImageType;
+
+    // The whole image
+    BasicImageView(ImageType &im)
+      : values(im.image_data.data()), dims(im.dims), layout_(im.layout_)
+    {
+        for (int d = 0; d < 3; ++d) {
+            dim_values[d] = im.dim_values[d];
+            stride_[d] = im.stride_[d];
+        }
+    }
+
+    // A MutableImageView is also an ImageView
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+    BasicImageView(const BasicImageView<U> &view)
+      : values(view.values), dims(view.dims), layout_(view.layout_)
+    {
+        for (int d = 0; d < 3; ++d) {
+            dim_values[d] = view.dim_values[d];
+            stride_[d] = view.stride_[d];
+        }
+    }
+
+    int dimensions() const { return dims; }
+    int stride(int dim) const { return stride_[dim]; }
+    int width()    const { return dim_values[0]; }
+    int height()   const { return dim_values[1]; }
+    int channels() const { return dim_values[2]; }
+    int extent(int dim) const { return dim_values[dim]; }
+    ImageLayout layout() const { return layout_; }
+
+    // The w x h rectangle whose top left corner is (x0, y0), every channel
+    BasicImageView crop(int x0, int y0, int w, int h) const {
+        if (x0 < 0 || y0 < 0 || w < 0 || h < 0 || x0 + w > width() || y0 + h > height())
+            throw OutOfBoundsException();
+        BasicImageView view = *this;
+        view.values += offset(x0, y0);
+        view.dim_values[0] = w;
+        view.dim_values[1] = h;
+        return view;
+    }
+
+    // Channel z alone
+    BasicImageView channel(int z) const {
+        if (z < 0 || z >= std::max(channels(), 1))
+            throw OutOfBoundsException();
+        BasicImageView view = *this;
+        view.values += static_cast<size_t>(z) * stride_[2];
+        if (dims == 3)
+            view.dim_values[2] = 1;
+        return view;
+    }
+
+    T & operator()(int x, int y) const {
+        if (x < 0 || x >= width() || y < 0 || y >= height())
+            throw OutOfBoundsException();
+        return values[offset(x, y)];
+    }
+    T & operator()(int x, int y, int z) const {
+        if (x < 0 || x >= width() || y < 0 || y >= height() || z < 0 || z >= channels())
+            throw OutOfBoundsException();
+        return values[offset(x, y) + static_cast<size_t>(z) * stride_[2]];
+    }
+
+    // Image::smartAccessor, at the edges of the view
+    float smartAccessor(int x, int y, int z, bool clamp = false) const {
+        if (x < 0 || x >= width() || y < 0 || y >= height()) {
+            if (!clamp)
+                return 0.0f;
+            x = std::min(std::max(x, 0), width() - 1);
+            y = std::min(std::max(y, 0), height() - 1);
+        }
+        return (*this)(x, y, z);
+    }
+
+    T * row(int y, int z = 0) const {
+        if (stride_[0] != 1)
+            throw LayoutException();
+        IMAGE_BOUNDS_CHECK(y >= 0 && y < std::max(height(), 1) && z >= 0 && z < std::max(channels(), 1));
+        return values + static_cast<size_t>(y) * stride_[1] + static_cast<size_t>(z) * stride_[2];
+    }
+    ImageRowSpan<T> span(int y, int z = 0) const { return ImageRowSpan<T>(row(y, z), width()); }
+    T * pixel(int x, int y) const {
+        IMAGE_BOUNDS_CHECK(x >= 0 && x < width() && y >= 0 && y < std::max(height(), 1));
+        return values + offset(x, y);
+    }
+    T & at(int x, int y, int z = 0) const {
+        IMAGE_BOUNDS_CHECK(z >= 0 && z < std::max(channels(), 1));
+        return pixel(x, y)[static_cast<size_t>(z) * stride_[2]];
+    }
+
+private:
+    template <typename U> friend class BasicImageView;
+
+    size_t offset(int x, int y) const {
+        return static_cast<size_t>(x) * stride_[0] + static_cast<size_t>(y) * stride_[1];
+    }
+
+    T *values;          // value (0, 0, 0) of the view
+    int dims;
+    int dim_values[3];
+    int stride_[3];     // those of the image
+    ImageLayout layout_;
+};
+
+// Copies the values of src into dst, which must have the same dimensions
+void copyValues(const ImageView &src, const MutableImageView &dst);
+
+void compareDimensions(const ImageView & im1, const ImageView & im2);
+
+// Element-wise operations pair the values of the same coordinates, so their
+// arguments may be views, and of different layouts. The result has the
+// layout of im1.
 
 // Image/Image element-wise operations
-Image operator+ (const Image & im1, const Image & im2);
-Image operator- (const Image & im1, const Image & im2);
-Image operator* (const Image & im1, const Image & im2);
-Image operator/ (const Image & im1, const Image & im2);
+Image operator+ (const ImageView & im1, const ImageView & im2);
+Image operator- (const ImageView & im1, const ImageView & im2);
+Image operator* (const ImageView & im1, const ImageView & im2);
+Image operator/ (const ImageView & im1, const ImageView & im2);
 
 // Image/scalar operations
-Image operator+ (const Image & im1, const float & c);
-Image operator- (const Image & im1, const float & c);
-Image operator* (const Image & im1, const float & c);
-Image operator/ (const Image & im1, const float & c);
+Image operator+ (const ImageView & im1, const float & c);
+Image operator- (const ImageView & im1, const float & c);
+Image operator* (const ImageView & im1, const float & c);
+Image operator/ (const ImageView & im1, const float & c);
 
 // scalar/Image operations
-Image operator+ (const float & c, const Image & im1);
-Image operator- (const float & c, const Image & im1);
-Image operator* (const float & c, const Image & im1);
-Image operator/ (const float & c, const Image & im1);
+Image operator+ (const float & c, const ImageView & im1);
+Image operator- (const float & c, const ImageView & im1);
+Image operator* (const float & c, const ImageView & im1);
+Image operator/ (const float & c, const ImageView & im1);
 // ------------------------------------------------------
 
 #endif
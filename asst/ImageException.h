@@ -43,6 +43,12 @@ class OutOfBoundsException : public std::runtime_error {
             std::runtime_error("Index is out of the image bounds.") {}
 };
 
+class LayoutException : public std::runtime_error {
+    public:
+        LayoutException() :
+            std::runtime_error("Image rows are not contiguous in this layout.") {}
+};
+
 class InvalidArgument : public std::runtime_error {
     public:
         InvalidArgument() : 
@@ -55,6 +61,12 @@ class FileNotFoundException : public std::runtime_error {
             std::runtime_error("Empty input or file does not exist.") {}
 };
 
+class FileFormatException : public std::runtime_error {
+    public:
+        FileFormatException() :
+            std::runtime_error("File is not in the expected format.") {}
+};
+
 class NotImplementedException : public std::runtime_error {
     public:
         NotImplementedException() : 
@@ -1,17 +1,26 @@
 #include <iostream>
 #include <cstdlib>
-#include <ctime>
 #include "a10.h"
 #include "basicImageManipulation.h"
 #include "filtering.h"
-#include <Eigen/Eigenvalues>
+#include "brushAtlas.h"
+#include "strokeRasterizer.h"
+#include "importanceSampler.h"
+#include "strokePlan.h"
+#include "parallel.h"
+#include "structureTensor.h"
+#include "sharpness.h"
+#include "blendKernel.h"
+#include "radixSort.h"
+#include "pyramid.h"
+#include "random.h"
 
 using namespace std;
 
 void brush(Image &im,
            int x,
            int y,
-           std::vector<float> color,
+           const std::vector<float> &color,
            const Image &texture)
 {
     // takes as input a mutable image out and splats a single brush stroke centered at x,y
@@ -39,75 +48,379 @@ void brush(Image &im,
         return;
     }
 
-    for (int i = -half_width; i < half_width; ++i)
+    // Composite a row of the brush at a time, so that the blend kernels can
+    // work on several texels per step in either layout of im.
+    for (int j = -half_height; j < half_height; ++j)
+        blendImageRow(im, x - half_width, y + j, texture.row(j + half_height), color.data(), 2 * half_width);
+}
+
+void brush(Image &im,
+           int x,
+           int y,
+           const float color[3],
+           const BrushAtlas &atlas,
+           int bin)
+{
+    // Same as brush() above, but the stroke texture is the brush stored in
+    // bin of a pre-rotated brush atlas.
+    int half_width = atlas.width() / 2;
+    int half_height = atlas.height() / 2;
+
+    if ((x + half_width >= im.width()) || (y + half_height >= im.height()) ||
+        (x - half_width < 0) || (y - half_height < 0))
     {
-        for (int j = -half_height; j < half_height; ++j)
+        return;
+    }
+
+    if (bin < 0 || bin >= atlas.numAngles())
+        throw OutOfBoundsException();
+
+    for (int j = -half_height; j < half_height; ++j)
+        blendImageRow(im, x - half_width, y + j, atlas.brushes().row(j + half_height, bin), color, 2 * half_width);
+}
+
+// Draws strokes positions for a layer from the importance sampler, each with
+// a noisy color read from im, and returns them as a plan for the canvas of
+// im. The random numbers of stroke i only depend on (seed, layer, i), so the
+// strokes are sampled in parallel chunks and concatenated in order: the
+// result is the same for any number of threads. The strokes are strokes
+// first to first + strokes - 1 of the layer.
+static StrokePlan sampleStrokes(const ImageView &im,
+                                const ImportanceSampler &importance,
+                                int strokes,
+                                int size,
+                                float noise,
+                                int numAngles,
+                                unsigned int seed,
+                                int layer,
+                                int first = 0)
+{
+    StrokePlan sampled(im.width(), im.height(), numAngles);
+    if (importance.empty())
+    {
+        // nothing to draw if the importance is zero everywhere
+        return sampled;
+    }
+
+    StrokeRandom rng(seed, layer);
+    const int chunk_size = 4096;
+    int num_chunks = (strokes + chunk_size - 1) / chunk_size;
+    std::vector<StrokePlan> chunks(num_chunks, sampled);
+
+    parallelFor(0, num_chunks, [&](int k) {
+        int end = min(strokes, (k + 1) * chunk_size);
+        chunks[k].reserve(end - k * chunk_size);
+        for (int i = first + k * chunk_size; i < first + end; ++i)
         {
-            float opacity = texture(i + half_width, j + half_height);
-            for (int c = 0; c < im.channels(); ++c)
+            uint32_t w[4];
+            rng.words(i, 0, w);
+
+            // draw x and y according to the importance
+            int x, y;
+            importance.sample(w, x, y);
+
+            // modulate the color by a random amount proportional to noise
+            uint32_t n[4];
+            rng.words(i, 1, n);
+            float color[3];
+            for (int c = 0; c < 3; ++c)
             {
-                im(x + i, y + j, c) = opacity * color[c] + (1.0f - opacity) * im(x + i, y + j, c);
+                color[c] = StrokeRandom::modulate(im.at(x, y, c), noise, n[c]);
             }
+            chunks[k].append(x, y, color, 0, size, layer);
+        }
+    });
+
+    sampled.reserve(strokes);
+    for (int k = 0; k < num_chunks; ++k)
+    {
+        sampled.append(chunks[k]);
+    }
+    return sampled;
+}
+
+// Same as sampleStrokes, until the strokes cover target.fraction of the
+// importance: strokes are sampled a chunk at a time and recorded in a
+// CoverageMap in order, and the layer ends with the stroke that reaches the
+// target. Stroke i is the same as stroke i of sampleStrokes.
+static StrokePlan sampleStrokesCovering(const ImageView &im,
+                                        const ImportanceSampler &importance,
+                                        const CoverageTarget &target,
+                                        int size,
+                                        float noise,
+                                        int numAngles,
+                                        unsigned int seed,
+                                        int layer)
+{
+    StrokePlan sampled(im.width(), im.height(), numAngles);
+    CoverageMap coverage(importance, size);
+    const int chunk_size = 4096;
+    while (sampled.count() < target.maxStrokes)
+    {
+        int n = min(chunk_size, target.maxStrokes - sampled.count());
+        StrokePlan chunk = sampleStrokes(im, importance, n, size, noise, numAngles, seed, layer, sampled.count());
+        if (chunk.count() == 0)
+            break;
+        for (int i = 0; i < chunk.count(); ++i)
+        {
+            float color[3] = {chunk.r[i], chunk.g[i], chunk.b[i]};
+            sampled.append(chunk.x[i], chunk.y[i], color, 0, size, layer);
+            coverage.cover(chunk.x[i], chunk.y[i]);
+            if (coverage.coverage() >= target.fraction)
+                return sampled;
         }
     }
+    return sampled;
+}
+
+// Sets the bin of every stroke of sampled to the angle at its position
+static void orientStrokes(StrokePlan &sampled, const ImageView &angles)
+{
+    for (int i = 0; i < sampled.count(); ++i)
+    {
+        float angle = angles.at(sampled.x[i], sampled.y[i]);
+        sampled.bin[i] = angleToBin(angle, sampled.numAngles);
+    }
+}
+
+// Same, reading the bins of a quantized field
+static void orientStrokes(StrokePlan &sampled, const AngleBins &bins)
+{
+    if (bins.numAngles() != sampled.numAngles)
+        throw MismatchedDimensionsException();
+    for (int i = 0; i < sampled.count(); ++i)
+        sampled.bin[i] = bins(sampled.x[i], sampled.y[i]);
+}
+
+// Orders sampled by stroke luminance, darkest first (or lightest first if
+// lightFirst), and appends it to plan. Every stroke keeps its own color and
+// bin, and the order comes from a stable radix sort on the luminance
+// quantized to 16 bits over the range of the layer.
+static void appendByLuminance(StrokePlan &plan,
+                              const StrokePlan &sampled,
+                              bool lightFirst)
+{
+    int n = sampled.count();
+    // [0.3, 0.6, 0.1]
+    vector<float> lumi(n);
+    float lo = FLT_MAX, hi = -FLT_MAX;
+    for (int i = 0; i < n; ++i)
+    {
+        lumi[i] = sampled.r[i] * 0.3f + sampled.g[i] * 0.6f + sampled.b[i] * 0.1f;
+        lo = min(lo, lumi[i]);
+        hi = max(hi, lumi[i]);
+    }
+
+    float scale = hi > lo ? 65535.0f / (hi - lo) : 0.0f;
+    vector<uint16_t> keys(n);
+    for (int i = 0; i < n; ++i)
+    {
+        uint16_t key = static_cast<uint16_t>((lumi[i] - lo) * scale + 0.5f);
+        keys[i] = lightFirst ? 65535 - key : key;
+    }
+
+    StrokePlan ordered = sampled;
+    ordered.permute(radixSortOrder(keys));
+    plan.append(ordered);
+}
+
+void sampleSingleScale(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed,
+                       int layer)
+{
+    // For each of N random locations (x, y), a stroke of size size.
+
+    // The color of the brush should be read from im at (x, y). To make things
+    // more interesting, modulate the color by multiplying it by a random amount
+    // proportional to noise: (1-noise/2+noise*numpy.random.rand(3))
+    plan.append(sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer));
+}
+
+void sampleSingleScaleOriented(StrokePlan &plan,
+                               const ImageView &im,
+                               const ImageView &angles,
+                               const ImportanceSampler &importance,
+                               int size,
+                               int strokes,
+                               float noise,
+                               unsigned int seed,
+                               int layer)
+{
+    // same as sampleSingleScale but now the brush strokes will be oriented
+    // according to the angles in angles.
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, angles);
+    plan.append(sampled);
+}
+
+void sampleSingleScaleOriented(StrokePlan &plan,
+                               const ImageView &im,
+                               const AngleBins &bins,
+                               const ImportanceSampler &importance,
+                               int size,
+                               int strokes,
+                               float noise,
+                               unsigned int seed,
+                               int layer)
+{
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, bins);
+    plan.append(sampled);
+}
+
+int sampleSingleScale(StrokePlan &plan,
+                      const ImageView &im,
+                      const ImportanceSampler &importance,
+                      int size,
+                      const CoverageTarget &target,
+                      float noise,
+                      unsigned int seed,
+                      int layer)
+{
+    StrokePlan sampled = sampleStrokesCovering(im, importance, target, size, noise, plan.numAngles, seed, layer);
+    plan.append(sampled);
+    return sampled.count();
+}
+
+int sampleSingleScaleOriented(StrokePlan &plan,
+                              const ImageView &im,
+                              const ImageView &angles,
+                              const ImportanceSampler &importance,
+                              int size,
+                              const CoverageTarget &target,
+                              float noise,
+                              unsigned int seed,
+                              int layer)
+{
+    StrokePlan sampled = sampleStrokesCovering(im, importance, target, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, angles);
+    plan.append(sampled);
+    return sampled.count();
+}
+
+int sampleSingleScaleOriented(StrokePlan &plan,
+                              const ImageView &im,
+                              const AngleBins &bins,
+                              const ImportanceSampler &importance,
+                              int size,
+                              const CoverageTarget &target,
+                              float noise,
+                              unsigned int seed,
+                              int layer)
+{
+    StrokePlan sampled = sampleStrokesCovering(im, importance, target, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, bins);
+    plan.append(sampled);
+    return sampled.count();
+}
+
+void sampleLightToDark(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImageView &angles,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed,
+                       int layer)
+{
+    // light to dark means paint strokes with greater luminance first.
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, angles);
+    appendByLuminance(plan, sampled, true);
+}
+
+void sampleLightToDark(StrokePlan &plan,
+                       const ImageView &im,
+                       const AngleBins &bins,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed,
+                       int layer)
+{
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, bins);
+    appendByLuminance(plan, sampled, true);
+}
+
+void sampleDarkToLight(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImageView &angles,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed,
+                       int layer)
+{
+    // painting from dark to light means painting those with less luminance first
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, angles);
+    appendByLuminance(plan, sampled, false);
+}
+
+void sampleDarkToLight(StrokePlan &plan,
+                       const ImageView &im,
+                       const AngleBins &bins,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed,
+                       int layer)
+{
+    StrokePlan sampled = sampleStrokes(im, importance, strokes, size, noise, plan.numAngles, seed, layer);
+    orientStrokes(sampled, bins);
+    appendByLuminance(plan, sampled, false);
 }
 
 void singleScalePaint(const Image &im,
                       Image &out,
-                      const Image &importance,
+                      const ImportanceSampler &importance,
                       const Image &texture,
                       int size,
                       int strokes,
-                      float noise)
+                      float noise,
+                      unsigned int seed,
+                      int layer)
 {
     // Paints with all brushed at the same scale using importance sampling.
 
     // First, scale the texture image so that it has maximum size size.
     // For each of N random locations (x, y), splat a brush in out.
+    StrokePlan plan(im.width(), im.height(), 1);
+    sampleSingleScale(plan, im, importance, size, strokes, noise, seed, layer);
+    rasterizeTiled(out, plan, texture);
+}
 
-    // The color of the brush should be read from im at (x, y). To make things
-    // more interesting, modulate the color by multiplying it by a random amount
-    // proportional to noise: (1-noise/2+noise*numpy.random.rand(3))
-
-    // first, scale texture image
-    float factor = static_cast<float>(size) / max(texture.width(), texture.height());
-    Image scaled_texture = scaleLin(texture, factor);
-
-    srand(static_cast<unsigned>(time(0)));
-
-    float average_prob = importance.mean();
-    if (average_prob == 0.0f)
-    {
-        // avoid divide by 0 errors
-        // if average_probability = 0, then we always reject.
-        return;
-    }
-
-    // Since we rejected a number of samples, we do not splat the required N
-    // strokes. To fix this, multiply N by a normalization factor based on the
-    // average probability of accepting samples.
-    int strokes_to_draw = static_cast<int>(static_cast<float>(strokes) / average_prob);
-    // cout << "number of strokes to draw:" << strokes_to_draw << endl;
-    for (int i = 0; i < strokes_to_draw; ++i)
-    {
-        // generate random x and y coordinates
-        int x = rand() % im.width();
-        int y = rand() % im.height();
+void singleScalePaint(const Image &im,
+                      Image &out,
+                      const Image &importance,
+                      const Image &texture,
+                      int size,
+                      int strokes,
+                      float noise,
+                      unsigned int seed,
+                      int layer)
+{
+    // Same as above, with positions drawn proportionally to importance.
+    singleScalePaint(im, out, ImportanceSampler(importance), texture, size, strokes, noise, seed, layer);
+}
 
-        // if random value < importance sample value, keep. otherwise, skip.
-        float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        if (r <= importance(x, y))
-        {
-            std::vector<float> color;
-            for (int c = 0; c < 3; ++c)
-            {
-                float n = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                float mod = (1.0f - (noise / 2.0f)) + (noise * n);
-                color.push_back(im(x, y, c) * mod);
-            }
-            brush(out, x, y, color, scaled_texture);
-        }
-    }
+Image sharpnessEnergy(const Image &im,
+                      float sigma,
+                      float truncate,
+                      bool clamp)
+{
+    // Local energy of the luminance above the frequency cut by sigma
+    return highPassEnergy(im, sigma, truncate, clamp, false);
 }
 
 Image sharpnessMap(const Image &im,
@@ -116,149 +429,131 @@ Image sharpnessMap(const Image &im,
                    bool clamp)
 {
     // Return image where values correspond to strength of frequencies.
-    Image L = color2gray(im);
-    Image blur = gaussianBlur_separable(L, sigma, truncate, clamp);
-    Image highPass = L - blur;
-    Image energy = highPass * highPass;
-    Image sharpness = gaussianBlur_separable(energy, 4.0f * sigma);
-    Image normalized_sharpness = sharpness / sharpness.max();
-    Image three_channel_normalized_sharpness = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < im.width(); ++x)
-    {
-        for (int y = 0; y < im.height(); ++y)
-        {
-            for (int c = 0; c < 3; ++c)
-            {
-                three_channel_normalized_sharpness(x, y, c) = normalized_sharpness(x, y);
-            }
-        }
-    }
-    return three_channel_normalized_sharpness;
+    return highPassEnergy(im, sigma, truncate, clamp, true);
 }
 
-Image painterly(const Image &im,
-                const Image &texture,
-                int strokes,
-                int size,
-                float noise)
+// ------------- PAINT ANALYSIS ---------------------
+PaintAnalysis::PaintAnalysis(const Image &im_) : im(im_) {}
+
+PaintAnalysis::~PaintAnalysis() {}
+
+const Image & PaintAnalysis::angles() const {
+    call_once(angles_once, [this]() { angles_.reset(new Image(computeAngles(im))); });
+    return *angles_;
+}
+
+const AngleBins & PaintAnalysis::angleBins(int numAngles) const {
+    const Image &field = angles();
+    lock_guard<mutex> lock(bins_mutex);
+    unique_ptr<AngleBins> &bins = bins_[numAngles];
+    if (!bins)
+        bins.reset(new AngleBins(field, numAngles));
+    return *bins;
+}
+
+const ImportanceSampler & PaintAnalysis::sharpness() const {
+    call_once(sharpness_once, [this]() { sharpness_.reset(new ImportanceSampler(sharpnessEnergy(im))); });
+    return *sharpness_;
+}
+
+const LuminancePyramid & PaintAnalysis::pyramid() const {
+    call_once(pyramid_once, [this]() { pyramid_.reset(new LuminancePyramid(im)); });
+    return *pyramid_;
+}
+// --------- END PAINT ANALYSIS ---------------------
+
+StrokePlan painterlyPlan(const Image &im,
+                         int strokes,
+                         int size,
+                         float noise,
+                         unsigned int seed)
+{
+    return painterlyPlan(PaintAnalysis(im), strokes, size, noise, seed);
+}
+
+StrokePlan painterlyPlan(const PaintAnalysis &analysis,
+                         int strokes,
+                         int size,
+                         float noise,
+                         unsigned int seed)
 {
     // First paints at a coarse scale using all 1's for importance sampling,
     // then paints again at size/4 scale using the sharpness map for importance sampling.
-    Image importance = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < importance.width(); ++x)
-    {
-        for (int y = 0; y < importance.height(); ++y)
-        {
-            importance(x, y, 0) = 1.0f;
-            importance(x, y, 1) = 1.0f;
-            importance(x, y, 2) = 1.0f;
-        }
-    }
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), 1);
+    ImportanceSampler importance(im.width(), im.height());
 
-    Image sharpness = sharpnessMap(im);
-    Image out(im.width(), im.height(), im.channels());
-    Image out2(im.width(), im.height(), im.channels());
+    sampleSingleScale(plan, im, importance, size, strokes, noise, seed, 0);
+    sampleSingleScale(plan, im, analysis.sharpness(), size / 4, strokes, noise, seed, 1);
+    return plan;
+}
 
-    singleScalePaint(im, out, importance, texture, size, strokes, noise);
-    singleScalePaint(im, out, sharpness, texture, size / 4, strokes, noise);
+StrokePlan painterlyPlan(const PaintAnalysis &analysis,
+                         const CoverageTarget &target,
+                         int size,
+                         float noise,
+                         unsigned int seed)
+{
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), 1);
+    ImportanceSampler importance(im.width(), im.height());
 
-    // out2 is for debugging purposes only
-    singleScalePaint(im, out2, sharpness, texture, size / 4, strokes, noise);
-    out2.debug_write();
-    // out2.debug_write();
-    return out;
+    sampleSingleScale(plan, im, importance, size, target, noise, seed, 0);
+    sampleSingleScale(plan, im, analysis.sharpness(), size / 4, target, noise, seed, 1);
+    return plan;
+}
+
+Image painterly(const Image &im,
+                const Image &texture,
+                int strokes,
+                int size,
+                float noise,
+                unsigned int seed)
+{
+    return renderStrokePlan(painterlyPlan(im, strokes, size, noise, seed), texture);
+}
+
+Image painterly(const Image &im,
+                const Image &texture,
+                const RenderControl &control,
+                int strokes,
+                int size,
+                float noise,
+                unsigned int seed)
+{
+    // Same layers as painterlyPlan, but each one is painted as soon as it is
+    // sampled so that the coarse layer shows up before the sharpness map is
+    // even computed.
+    ProgressiveRenderer renderer(im.width(), im.height(), texture, control);
+
+    StrokePlan coarse(im.width(), im.height(), 1);
+    sampleSingleScale(coarse, im, ImportanceSampler(im.width(), im.height()), size, strokes, noise, seed, 0);
+    if (!renderer.render(coarse))
+        return renderer.canvas();
+
+    StrokePlan fine(im.width(), im.height(), 1);
+    sampleSingleScale(fine, im, ImportanceSampler(sharpnessEnergy(im)), size / 4, strokes, noise, seed, 1);
+    if (renderer.render(fine))
+        renderer.finish();
+    return renderer.canvas();
 }
 
 Image computeTensor(const Image &im,
                     float sigmaG,
                     float factorSigma)
 {
-    // // --------- from PS07 ------------------------------
     // Compute xx/xy/yy Tensor of an image. (stored in that order)
-
-    // first, extract the luminance and blur
-    std::vector<Image> lc = lumiChromi(im);
-    Image lumi = lc[0];
-    Image lumi_blurred = gaussianBlur_separable(lumi, sigmaG);
-    Image lumi_gradX = gradientX(lumi_blurred);
-    Image lumi_gradY = gradientY(lumi_blurred);
-
-    int width = im.width();
-    int height = im.height();
-    Image tensor(width, height, 3);
-
-    for (int x = 0; x < width; ++x)
-    {
-        for (int y = 0; y < height; ++y)
-        {
-            float Ix = lumi_gradX(x, y);
-            float Iy = lumi_gradY(x, y);
-
-            tensor(x, y, 0) = Ix * Ix;
-            tensor(x, y, 1) = Ix * Iy;
-            tensor(x, y, 2) = Iy * Iy;
-        }
-    }
-
-    Image weighted_tensor = gaussianBlur_separable(tensor, sigmaG * factorSigma);
-    return weighted_tensor;
+    // Luminance, blur, Sobel gradients and products are fused into one
+    // streaming pass (see structureTensor.h).
+    return structureTensor(im, sigmaG, factorSigma);
 }
 
 Image computeAngles(const Image &im)
 {
-    // Return an image that holds the angle of the smallest eigenvector
-    // of the structure tensor at each pixel.
-    int width = im.width();
-    int height = im.height();
-    int channels = im.channels();
-    Image response(width, height, channels);
-    Image tensor = computeTensor(im);
-    for (int x = 0; x < width; ++x)
-    {
-        for (int y = 0; y < height; ++y)
-        {
-            float IxIx = tensor(x, y, 0);
-            float IxIy = tensor(x, y, 1);
-            float IyIy = tensor(x, y, 2);
-
-            // Change from pset 7:
-            // extract eigenvectors + compute angle of the smallest one
-            // with respect to horizontal direction
-
-            // construct matrix
-            Eigen::Matrix<float, 2, 2> M;
-            M << IxIx, IxIy,
-                IxIy, IyIy;
-
-            Eigen::EigenSolver<Eigen::Matrix<float, 2, 2>> s(M);
-            float e1_x = s.eigenvectors()(0, 0).real();
-            float e1_y = s.eigenvectors()(1, 0).real();
-            float e2_x = s.eigenvectors()(0, 1).real();
-            float e2_y = s.eigenvectors()(1, 1).real();
-
-            float angle1 = atan2(e1_y, e1_x);
-            float angle2 = atan2(e2_y, e2_x);
-            float angle = angle1;
-            // if (abs(s.eigenvalues()(1)) < abs(s.eigenvalues()(0)))
-            // {
-            //     angle = angle2;
-            // }
-
-            if (real(s.eigenvalues()(1)) < real(s.eigenvalues()(0)))
-            {
-                angle = angle2;
-            }
-            if (angle < 0)
-                angle += 2 * M_PI;
-
-            for (int c = 0; c < channels; ++c)
-            {
-                response(x, y, c) = angle;
-            }
-        }
-    }
-    // response.debug_write();
-    return response;
+    // Return a single channel image that holds the angle of the smallest
+    // eigenvector of the structure tensor at each pixel, in closed form
+    // (see structureTensor.h).
+    return tensorAngles(computeTensor(im));
 }
 
 std::vector<Image> rotatedBrushes(const Image &texture,
@@ -278,95 +573,131 @@ std::vector<Image> rotatedBrushes(const Image &texture,
 void singleScaleOrientedPaint(const Image &im,
                               Image &out,
                               const Image &angles,
-                              const Image &importance,
+                              const ImportanceSampler &importance,
                               const Image &texture,
                               int strokes,
                               int size,
                               float noise,
-                              int numAngles)
+                              int numAngles,
+                              unsigned int seed,
+                              int layer)
 {
     // '''same as single scale paint but now the brush strokes will be oriented
     //  according to the angles in angles.'''
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    sampleSingleScaleOriented(plan, im, angles, importance, size, strokes, noise, seed, layer);
+    rasterizeTiled(out, plan, texture);
+}
 
-    // first, scale texture image
-    float factor = static_cast<float>(size) / max(texture.width(), texture.height());
-    Image scaled_texture = scaleLin(texture, factor);
-    // std::vector<Image> rotated = rotatedBrushes(scaled_texture, numAngles);
-
-    srand(static_cast<unsigned>(time(0)));
+void singleScaleOrientedPaint(const Image &im,
+                              Image &out,
+                              const Image &angles,
+                              const Image &importance,
+                              const Image &texture,
+                              int strokes,
+                              int size,
+                              float noise,
+                              int numAngles,
+                              unsigned int seed,
+                              int layer)
+{
+    // Same as above, with positions drawn proportionally to importance.
+    singleScaleOrientedPaint(im, out, angles, ImportanceSampler(importance), texture, strokes, size, noise, numAngles, seed, layer);
+}
 
-    float average_prob = importance.mean();
-    if (average_prob == 0.0f)
-    {
-        // avoid divide by 0 errors
-        // if average_probability = 0, then we always reject.
-        return;
-    }
+StrokePlan orientedPaintPlan(const Image &im,
+                             int strokes,
+                             int size,
+                             float noise,
+                             unsigned int seed,
+                             int numAngles)
+{
+    return orientedPaintPlan(PaintAnalysis(im), strokes, size, noise, seed, numAngles);
+}
 
-    // // Since we rejected a number of samples, we do not splat the required N
-    // // strokes. To fix this, multiply N by a normalization factor based on the
-    // // average probability of accepting samples.
-    int strokes_to_draw = static_cast<int>(static_cast<float>(strokes) / average_prob);
-    // // cout << "number of strokes to draw:" << strokes_to_draw << endl;
-    for (int i = 0; i < strokes_to_draw; ++i)
-    {
-        // generate random x and y coordinates
-        int x = rand() % im.width();
-        int y = rand() % im.height();
+StrokePlan orientedPaintPlan(const PaintAnalysis &analysis,
+                             int strokes,
+                             int size,
+                             float noise,
+                             unsigned int seed,
+                             int numAngles)
+{
+    // Same as painterly but computes and uses the local orientation
+    // information to orient strokes.
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    ImportanceSampler importance(im.width(), im.height());
 
-        // if random value < importance sample value, keep. otherwise, skip.
-        float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        if (r <= importance(x, y))
-        {
-            std::vector<float> color;
-            for (int c = 0; c < 3; ++c)
-            {
-                float n = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                float mod = (1.0f - (noise / 2.0f)) + (noise * n);
-                color.push_back(im(x, y, c) * mod);
-            }
-            float angle = angles(x, y);
-            // int index = (angle) * static_cast<float>(numAngles);
-            // cout << angle << ", index:" << index << "out of " << rotated.size() << endl;
+    sampleSingleScaleOriented(plan, im, analysis.angleBins(numAngles), importance, size, strokes, noise, seed, 0);
+    sampleSingleScaleOriented(plan, im, analysis.angleBins(numAngles), analysis.sharpness(), size / 4, strokes, noise, seed, 1);
+    return plan;
+}
 
-            Image r = rotate(scaled_texture, angle);
+StrokePlan orientedPaintPlan(const PaintAnalysis &analysis,
+                             const CoverageTarget &target,
+                             int size,
+                             float noise,
+                             unsigned int seed,
+                             int numAngles)
+{
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    ImportanceSampler importance(im.width(), im.height());
 
-            brush(out, x, y, color, r);
-        }
-    }
+    sampleSingleScaleOriented(plan, im, analysis.angleBins(numAngles), importance, size, target, noise, seed, 0);
+    sampleSingleScaleOriented(plan, im, analysis.angleBins(numAngles), analysis.sharpness(), size / 4, target, noise, seed, 1);
+    return plan;
 }
 
 Image orientedPaint(const Image &im,
                     const Image &texture,
                     int strokes,
-                    int size, float noise)
+                    int size, float noise,
+                    unsigned int seed)
 {
-    // Same as painterly but computes and uses the local orientation
-    // information to orient strokes.
-
-    Image importance = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < importance.width(); ++x)
-    {
-        for (int y = 0; y < importance.height(); ++y)
-        {
-            importance(x, y, 0) = 1.0f;
-            importance(x, y, 1) = 1.0f;
-            importance(x, y, 2) = 1.0f;
-        }
-    }
+    return renderStrokePlan(orientedPaintPlan(im, strokes, size, noise, seed), texture);
+}
 
-    Image sharpness = sharpnessMap(im);
-    Image out(im.width(), im.height(), im.channels());
+Image orientedPaint(const Image &im,
+                    const Image &texture,
+                    const RenderControl &control,
+                    int strokes,
+                    int size, float noise,
+                    unsigned int seed)
+{
+    // Progressive version of orientedPaintPlan, see painterly() above
+    ProgressiveRenderer renderer(im.width(), im.height(), texture, control);
     Image angles = computeAngles(im);
 
-    singleScaleOrientedPaint(im, out, angles, importance, texture, strokes, size, noise, 36);
-    singleScaleOrientedPaint(im, out, angles, sharpness, texture, strokes, size / 4, noise, 36);
+    StrokePlan coarse(im.width(), im.height(), 36);
+    sampleSingleScaleOriented(coarse, im, angles, ImportanceSampler(im.width(), im.height()),
+                              size, strokes, noise, seed, 0);
+    if (!renderer.render(coarse))
+        return renderer.canvas();
+
+    StrokePlan fine(im.width(), im.height(), 36);
+    sampleSingleScaleOriented(fine, im, angles, ImportanceSampler(sharpnessEnergy(im)),
+                              size / 4, strokes, noise, seed, 1);
+    if (renderer.render(fine))
+        renderer.finish();
+    return renderer.canvas();
+}
 
-    // out2 is for debugging purposes only
-    // Image out2(im.width(), im.height(), im.channels());
-    // singleScaleOrientedPaint(im, out2, angles, sharpness, texture, strokes, size / 4, noise, 36);
-    // out2.debug_write();
-    return out;
+void lightToDarkPaintHelper(const Image &im,
+                            Image &out,
+                            const Image &angles,
+                            const ImportanceSampler &importance,
+                            const Image &texture,
+                            int strokes,
+                            int size,
+                            float noise,
+                            int numAngles,
+                            unsigned int seed,
+                            int layer)
+{
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    sampleLightToDark(plan, im, angles, importance, size, strokes, noise, seed, layer);
+    rasterizeTiled(out, plan, texture);
 }
 
 void lightToDarkPaintHelper(const Image &im,
@@ -377,106 +708,65 @@ void lightToDarkPaintHelper(const Image &im,
                             int strokes,
                             int size,
                             float noise,
-                            int numAngles)
+                            int numAngles,
+                            unsigned int seed,
+                            int layer)
 {
+    // Same as above, with positions drawn proportionally to importance.
+    lightToDarkPaintHelper(im, out, angles, ImportanceSampler(importance), texture, strokes, size, noise, numAngles, seed, layer);
+}
 
-    float factor = static_cast<float>(size) / max(texture.width(), texture.height());
-    Image scaled_texture = scaleLin(texture, factor);
-    std::vector<Image> rotated = rotatedBrushes(scaled_texture, numAngles);
-
-    srand(static_cast<unsigned>(time(0)));
-
-    float average_prob = importance.mean();
-    if (average_prob == 0.0f)
-    {
-        // avoid divide by 0 errors
-        // if average_probability = 0, then we always reject.
-        return;
-    }
-
-    // // Since we rejected a number of samples, we do not splat the required N
-    // // strokes. To fix this, multiply N by a normalization factor based on the
-    // // average probability of accepting samples.
-    int strokes_to_draw = static_cast<int>(static_cast<float>(strokes) / average_prob);
-    Image color_image(im.width(), im.height(), im.channels());
-    // lumi, x, y
-    vector<tuple<float, int, int>> v;
-    // [0.3, 0.6, 0.1
-    for (int i = 0; i < strokes_to_draw; ++i)
-    {
-        // generate random x and y coordinates
-        int x = rand() % im.width();
-        int y = rand() % im.height();
-
-        // if random value < importance sample value, keep. otherwise, skip.
-        float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        if (r <= importance(x, y))
-        {
-            std::vector<float> color;
-            for (int c = 0; c < 3; ++c)
-            {
-                float n = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                float mod = (1.0f - (noise / 2.0f)) + (noise * n);
-                color.push_back(im(x, y, c) * mod);
-                color_image(x, y, c) = color[c];
-            }
-            v.push_back(make_tuple(color[0] * 0.3f + color[1] * 0.6f + color[2] * 0.1f, x, y));
-        }
-    }
-
-    // light to dark means paint strokes with greater luminance first.
-
-    sort(v.begin(), v.end());
-    // for (int i = 0; i < v.size(); ++i)
-
-    for (int i = v.size() - 1; i >= 0; --i)
-    {
-        int x = get<1>(v[i]);
-        int y = get<2>(v[i]);
-        std::vector<float> q;
-        for (int c = 0; c < 3; ++c)
-        {
-            q.push_back(color_image(x, y, c));
-        }
-        float angle = angles(x, y);
-
-        Image r = rotate(scaled_texture, angle);
+StrokePlan lightToDarkPlan(const Image &im,
+                           int strokes,
+                           int size,
+                           float noise,
+                           unsigned int seed,
+                           int numAngles)
+{
+    return lightToDarkPlan(PaintAnalysis(im), strokes, size, noise, seed, numAngles);
+}
 
-        brush(out, x, y, q, r);
-    }
+StrokePlan lightToDarkPlan(const PaintAnalysis &analysis,
+                           int strokes,
+                           int size,
+                           float noise,
+                           unsigned int seed,
+                           int numAngles)
+{
+    // Same as orientedPaint, but each layer paints its lightest strokes first.
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    ImportanceSampler importance(im.width(), im.height());
+
+    sampleLightToDark(plan, im, analysis.angleBins(numAngles), importance, size, strokes, noise, seed, 0);
+    sampleLightToDark(plan, im, analysis.angleBins(numAngles), analysis.sharpness(), size / 4, strokes, noise, seed, 1);
+    return plan;
 }
 
 Image lightToDarkPaint(const Image &im,
                        const Image &texture,
                        int strokes,
-                       int size, float noise)
+                       int size, float noise,
+                       unsigned int seed)
 {
-    // Same as painterly but computes and uses the local orientation
-    // information to orient strokes.
-
-    Image importance = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < importance.width(); ++x)
-    {
-        for (int y = 0; y < importance.height(); ++y)
-        {
-            importance(x, y, 0) = 1.0f;
-            importance(x, y, 1) = 1.0f;
-            importance(x, y, 2) = 1.0f;
-        }
-    }
-
-    Image sharpness = sharpnessMap(im);
-    Image out(im.width(), im.height(), im.channels());
-    Image angles = computeAngles(im);
-
-    lightToDarkPaintHelper(im, out, angles, importance, texture, strokes, size, noise, 36);
-    lightToDarkPaintHelper(im, out, angles, sharpness, texture, strokes, size / 4, noise, 36);
+    return renderStrokePlan(lightToDarkPlan(im, strokes, size, noise, seed), texture);
+}
 
-    // out2 is for debugging purposes only
-    // Image out2(im.width(), im.height(), im.channels());
-    // lightToDarkPaintHelper(im, out2, angles, sharpness, texture, strokes, size / 4, noise, 36);
-    // out2.debug_write();
-    return out;
+void darkToLightPaintHelper(const Image &im,
+                            Image &out,
+                            const Image &angles,
+                            const ImportanceSampler &importance,
+                            const Image &texture,
+                            int strokes,
+                            int size,
+                            float noise,
+                            int numAngles,
+                            unsigned int seed,
+                            int layer)
+{
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    sampleDarkToLight(plan, im, angles, importance, size, strokes, noise, seed, layer);
+    rasterizeTiled(out, plan, texture);
 }
 
 void darkToLightPaintHelper(const Image &im,
@@ -487,128 +777,76 @@ void darkToLightPaintHelper(const Image &im,
                             int strokes,
                             int size,
                             float noise,
-                            int numAngles)
+                            int numAngles,
+                            unsigned int seed,
+                            int layer)
 {
+    // Same as above, with positions drawn proportionally to importance.
+    darkToLightPaintHelper(im, out, angles, ImportanceSampler(importance), texture, strokes, size, noise, numAngles, seed, layer);
+}
 
-    float factor = static_cast<float>(size) / max(texture.width(), texture.height());
-    Image scaled_texture = scaleLin(texture, factor);
-    std::vector<Image> rotated = rotatedBrushes(scaled_texture, numAngles);
-
-    srand(static_cast<unsigned>(time(0)));
-
-    float average_prob = importance.mean();
-    if (average_prob == 0.0f)
-    {
-        // avoid divide by 0 errors
-        // if average_probability = 0, then we always reject.
-        return;
-    }
-
-    // // Since we rejected a number of samples, we do not splat the required N
-    // // strokes. To fix this, multiply N by a normalization factor based on the
-    // // average probability of accepting samples.
-    int strokes_to_draw = static_cast<int>(static_cast<float>(strokes) / average_prob);
-    // // cout << "number of strokes to draw:" << strokes_to_draw << endl;
-
-    Image color_image(im.width(), im.height(), im.channels());
-    // lumi, x, y
-    vector<tuple<float, int, int>> v;
-    // [0.3, 0.6, 0.1
-    for (int i = 0; i < strokes_to_draw; ++i)
-    {
-        // generate random x and y coordinates
-        int x = rand() % im.width();
-        int y = rand() % im.height();
-
-        // if random value < importance sample value, keep. otherwise, skip.
-        float r = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        if (r <= importance(x, y))
-        {
-            std::vector<float> color;
-            for (int c = 0; c < 3; ++c)
-            {
-                float n = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-                float mod = (1.0f - (noise / 2.0f)) + (noise * n);
-                color.push_back(im(x, y, c) * mod);
-                color_image(x, y, c) = color[c];
-            }
-            v.push_back(make_tuple(color[0] * 0.3f + color[1] * 0.6f + color[2] * 0.1f, x, y));
-        }
-    }
-
-    sort(v.begin(), v.end());
-    // painting from dark to light means painting those with less luminance first
-    for (int i = 0; i < v.size(); ++i)
-    {
-        int x = get<1>(v[i]);
-        int y = get<2>(v[i]);
-        std::vector<float> q;
-        for (int c = 0; c < 3; ++c)
-        {
-            q.push_back(color_image(x, y, c));
-        }
-        float angle = angles(x, y);
-
-        Image r = rotate(scaled_texture, angle);
+StrokePlan darkToLightPlan(const Image &im,
+                           int strokes,
+                           int size,
+                           float noise,
+                           unsigned int seed,
+                           int numAngles)
+{
+    return darkToLightPlan(PaintAnalysis(im), strokes, size, noise, seed, numAngles);
+}
 
-        brush(out, x, y, q, r);
-    }
+StrokePlan darkToLightPlan(const PaintAnalysis &analysis,
+                           int strokes,
+                           int size,
+                           float noise,
+                           unsigned int seed,
+                           int numAngles)
+{
+    // Same as orientedPaint, but each layer paints its darkest strokes first.
+    const Image &im = analysis.image();
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    ImportanceSampler importance(im.width(), im.height());
+
+    sampleDarkToLight(plan, im, analysis.angleBins(numAngles), importance, size, strokes, noise, seed, 0);
+    sampleDarkToLight(plan, im, analysis.angleBins(numAngles), analysis.sharpness(), size / 4, strokes, noise, seed, 1);
+    return plan;
 }
 
 Image darkToLightPaint(const Image &im,
                        const Image &texture,
                        int strokes,
-                       int size, float noise)
+                       int size, float noise,
+                       unsigned int seed)
 {
-    // Same as painterly but computes and uses the local orientation
-    // information to orient strokes.
-
-    Image importance = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < importance.width(); ++x)
-    {
-        for (int y = 0; y < importance.height(); ++y)
-        {
-            importance(x, y, 0) = 1.0f;
-            importance(x, y, 1) = 1.0f;
-            importance(x, y, 2) = 1.0f;
-        }
-    }
-
-    Image sharpness = sharpnessMap(im);
-    Image out(im.width(), im.height(), im.channels());
-    Image angles = computeAngles(im);
-
-    darkToLightPaintHelper(im, out, angles, importance, texture, strokes, size, noise, 36);
-    darkToLightPaintHelper(im, out, angles, sharpness, texture, strokes, size / 4, noise, 36);
-
-    // out2 is for debugging purposes only
-    // Image out2(im.width(), im.height(), im.channels());
-    // darkToLightPaintHelper(im, out2, angles, sharpness, texture, strokes, size / 4, noise, 36);
-    // out2.debug_write();
-    return out;
+    return renderStrokePlan(darkToLightPlan(im, strokes, size, noise, seed), texture);
 }
 
-Image multiScaleOrientedPaint(const Image &im,
-                              const Image &texture,
-                              int strokes,
-                              int size, float noise, int numScales)
+StrokePlan multiScaleOrientedPlan(const Image &im,
+                                  int strokes,
+                                  int size, float noise, int numScales,
+                                  unsigned int seed,
+                                  int numAngles)
 {
-    Image importance = Image(im.width(), im.height(), im.channels());
-    for (int x = 0; x < importance.width(); ++x)
-    {
-        for (int y = 0; y < importance.height(); ++y)
-        {
-            importance(x, y, 0) = 1.0f;
-            importance(x, y, 1) = 1.0f;
-            importance(x, y, 2) = 1.0f;
-        }
-    }
-
-    Image sharpness = sharpnessMap(im);
-    Image out(im.width(), im.height(), im.channels());
-    Image angles = computeAngles(im);
+    return multiScaleOrientedPlan(PaintAnalysis(im), strokes, size, noise, numScales, seed, numAngles);
+}
 
-    singleScaleOrientedPaint(im, out, angles, importance, texture, strokes, size, noise, 36);
+StrokePlan multiScaleOrientedPlan(const PaintAnalysis &analysis,
+                                  int strokes,
+                                  int size, float noise, int numScales,
+                                  unsigned int seed,
+                                  int numAngles)
+{
+    // Paints a uniform coarse layer, then numScales layers of strokes that
+    // get smaller and follow sharpness maps of decreasing blur. The luminance
+    // pyramid is built once; each layer's sharpness is computed on the
+    // coarsest level that still resolves its brush size and blur.
+    const Image &im = analysis.image();
+    const AngleBins &angles = analysis.angleBins(numAngles);
+    const LuminancePyramid &pyramid = analysis.pyramid();
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    ImportanceSampler importance(im.width(), im.height());
+
+    sampleSingleScaleOriented(plan, im, angles, importance, size, strokes, noise, seed, 0);
 
     int scale = 1;
     float truncate = 6.0f;
@@ -616,17 +854,22 @@ Image multiScaleOrientedPaint(const Image &im,
     while (scale <= numScales)
     {
         // cout << scale << "," << static_cast<int>(size / scale) << endl;
-        sharpness = sharpnessMap(im, sigma, truncate);
-        // sharpness.debug_write();
-        singleScaleOrientedPaint(im, out, angles, sharpness, texture, strokes, size / (scale * 2), noise, 36);
+        int layer_size = size / (scale * 2);
+        int level = pyramid.levelFor(layer_size, sigma);
+        ImportanceSampler sharpness(pyramid.energy(level, sigma, truncate), im.width(), im.height());
+        sampleSingleScaleOriented(plan, im, angles, sharpness, layer_size, strokes, noise, seed, scale);
         scale += 1;
         sigma -= 0.2f;
         truncate -= 0.5f;
     }
+    return plan;
+}
 
-    // out2 is for debugging purposes only
-    // Image out2(im.width(), im.height(), im.channels());
-    // singleScaleOrientedPaint(im, out2, angles, sharpness, texture, strokes, size / 4, noise, 36);
-    // out2.debug_write();
-    return out;
+Image multiScaleOrientedPaint(const Image &im,
+                              const Image &texture,
+                              int strokes,
+                              int size, float noise, int numScales,
+                              unsigned int seed)
+{
+    return renderStrokePlan(multiScaleOrientedPlan(im, strokes, size, noise, numScales, seed), texture);
 }
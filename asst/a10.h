@@ -3,20 +3,58 @@
 #endif /* end of include guard: A10_H_PHUDVTKB */
 
 #include "Image.h"
+#include "brushAtlas.h"
+#include "importanceSampler.h"
+#include "strokePlan.h"
+#include "progressive.h"
+#include "coverage.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+class LuminancePyramid;
 
 void brush(Image &im,
            int x,
            int y,
-           std::vector<float> color,
+           const std::vector<float> &color,
            const Image &texture);
 
+void brush(Image &im,
+           int x,
+           int y,
+           const float color[3],
+           const BrushAtlas &atlas,
+           int bin);
+
+void singleScalePaint(const Image &im,
+                      Image &out,
+                      const ImportanceSampler &importance,
+                      const Image &texture,
+                      int size = 10,
+                      int strokes = 1000,
+                      float noise = 0.3f,
+                      unsigned int seed = 0,
+                      int layer = 0);
+
 void singleScalePaint(const Image &im,
                       Image &out,
                       const Image &importance,
                       const Image &texture,
                       int size = 10,
                       int strokes = 1000,
-                      float noise = 0.3f);
+                      float noise = 0.3f,
+                      unsigned int seed = 0,
+                      int layer = 0);
+
+// Single channel sharpness before normalization: sharpnessMap() is this
+// image divided by its maximum (see highPassEnergy in sharpness.h). An
+// ImportanceSampler does not depend on the scale of its map, so the paint
+// modes draw from this and skip the normalization pass.
+Image sharpnessEnergy(const Image &im,
+                      float sigma = 1.0f,
+                      float truncate = 4.0f,
+                      bool clamp = true);
 
 Image sharpnessMap(const Image &im,
                    float sigma = 1.0f,
@@ -27,17 +65,44 @@ Image painterly(const Image &im,
                 const Image &texture,
                 int strokes = 10000,
                 int size = 50,
-                float noise = 0.3f);
+                float noise = 0.3f,
+                unsigned int seed = 0);
+
+// Progressive painterly(): the coarse layer is sampled and painted before
+// the sharpness map is computed, frames are reported to control.onFrame and
+// the render stops when control.timeBudget runs out, returning the canvas
+// as painted so far.
+Image painterly(const Image &im,
+                const Image &texture,
+                const RenderControl &control,
+                int strokes = 10000,
+                int size = 50,
+                float noise = 0.3f,
+                unsigned int seed = 0);
 
 Image computeTensor(const Image &im,
                     float sigmaG = 3.0f,
                     float factorSigma = 5.0f);
 
+// Angle in [0, pi) of the smallest eigenvector of the structure tensor, one
+// channel
 Image computeAngles(const Image &im);
 
 std::vector<Image> rotatedBrushes(const Image &texture,
                                   int numAngles = 36);
 
+void singleScaleOrientedPaint(const Image &im,
+                              Image &out,
+                              const Image &angles,
+                              const ImportanceSampler &importance,
+                              const Image &texture,
+                              int strokes,
+                              int size,
+                              float noise,
+                              int numAngles = 36,
+                              unsigned int seed = 0,
+                              int layer = 0);
+
 void singleScaleOrientedPaint(const Image &im,
                               Image &out,
                               const Image &angles,
@@ -46,13 +111,25 @@ void singleScaleOrientedPaint(const Image &im,
                               int strokes,
                               int size,
                               float noise,
-                              int numAngles = 36);
+                              int numAngles = 36,
+                              unsigned int seed = 0,
+                              int layer = 0);
+
+Image orientedPaint(const Image &im,
+                    const Image &texture,
+                    int strokes = 7000,
+                    int size = 50,
+                    float noise = 0.3f,
+                    unsigned int seed = 0);
 
+// Progressive orientedPaint(), see the progressive painterly() above
 Image orientedPaint(const Image &im,
                     const Image &texture,
+                    const RenderControl &control,
                     int strokes = 7000,
                     int size = 50,
-                    float noise = 0.3f);
+                    float noise = 0.3f,
+                    unsigned int seed = 0);
 
 
 
@@ -60,13 +137,27 @@ Image darkToLightPaint(const Image &im,
                        const Image &texture,
                        int strokes = 10000,
                        int size = 50,
-                       float noise = 0.3f);
+                       float noise = 0.3f,
+                       unsigned int seed = 0);
 
 Image lightToDarkPaint(const Image &im,
                        const Image &texture,
                        int strokes = 1000,
                        int size = 50,
-                       float noise = 0.3f);
+                       float noise = 0.3f,
+                       unsigned int seed = 0);
+
+void lightToDarkPaintHelper(const Image &im,
+                            Image &out,
+                            const Image &angles,
+                            const ImportanceSampler &importance,
+                            const Image &texture,
+                            int strokes = 7000,
+                            int size = 50,
+                            float noise = 0.3f,
+                            int numAngles = 36,
+                            unsigned int seed = 0,
+                            int layer = 0);
 
 void lightToDarkPaintHelper(const Image &im,
                             Image &out,
@@ -76,7 +167,21 @@ void lightToDarkPaintHelper(const Image &im,
                             int strokes = 7000,
                             int size = 50,
                             float noise = 0.3f,
-                            int numAngles = 36);
+                            int numAngles = 36,
+                            unsigned int seed = 0,
+                            int layer = 0);
+
+void darkToLightPaintHelper(const Image &im,
+                            Image &out,
+                            const Image &angles,
+                            const ImportanceSampler &importance,
+                            const Image &texture,
+                            int strokes = 7000,
+                            int size = 50,
+                            float noise = 0.3f,
+                            int numAngles = 36,
+                            unsigned int seed = 0,
+                            int layer = 0);
 
 void darkToLightPaintHelper(const Image &im,
                             Image &out,
@@ -86,9 +191,238 @@ void darkToLightPaintHelper(const Image &im,
                             int strokes = 7000,
                             int size = 50,
                             float noise = 0.3f,
-                            int numAngles = 36);
+                            int numAngles = 36,
+                            unsigned int seed = 0,
+                            int layer = 0);
 
 Image multiScaleOrientedPaint(const Image &im,
                     const Image &texture,
                     int strokes,
-                    int size, float noise, int numScales = 2);
\ No newline at end of file
+                    int size, float noise, int numScales = 2,
+                    unsigned int seed = 0);
+
+// ------------- STROKE PLANS -----------------------
+// The sampling half of the paint modes above: instead of painting, they
+// produce the strokes as a StrokePlan that can be saved, reloaded and
+// rendered with any brush texture (see strokeRasterizer.h).
+
+// Append one layer of strokes of the given size to plan. Bins refer to
+// plan.numAngles rotations.
+void sampleSingleScale(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed = 0,
+                       int layer = 0);
+
+void sampleSingleScaleOriented(StrokePlan &plan,
+                               const ImageView &im,
+                               const ImageView &angles,
+                               const ImportanceSampler &importance,
+                               int size,
+                               int strokes,
+                               float noise,
+                               unsigned int seed = 0,
+                               int layer = 0);
+
+// Coverage driven versions: strokes are drawn until they cover
+// target.fraction of the importance (see CoverageMap), instead of a fixed
+// count, so that the number of strokes follows the image size and content.
+// Stroke i is the same as stroke i of the versions above. Return the number
+// of strokes drawn.
+int sampleSingleScale(StrokePlan &plan,
+                      const ImageView &im,
+                      const ImportanceSampler &importance,
+                      int size,
+                      const CoverageTarget &target,
+                      float noise,
+                      unsigned int seed = 0,
+                      int layer = 0);
+
+int sampleSingleScaleOriented(StrokePlan &plan,
+                              const ImageView &im,
+                              const ImageView &angles,
+                              const ImportanceSampler &importance,
+                              int size,
+                              const CoverageTarget &target,
+                              float noise,
+                              unsigned int seed = 0,
+                              int layer = 0);
+
+void sampleLightToDark(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImageView &angles,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed = 0,
+                       int layer = 0);
+
+void sampleDarkToLight(StrokePlan &plan,
+                       const ImageView &im,
+                       const ImageView &angles,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed = 0,
+                       int layer = 0);
+
+// Versions of the oriented layers that read the brush bins from a quantized
+// field instead of the float angles, which gives the same strokes without
+// converting an angle per stroke. bins.numAngles() must be plan.numAngles.
+void sampleSingleScaleOriented(StrokePlan &plan,
+                               const ImageView &im,
+                               const AngleBins &bins,
+                               const ImportanceSampler &importance,
+                               int size,
+                               int strokes,
+                               float noise,
+                               unsigned int seed = 0,
+                               int layer = 0);
+
+int sampleSingleScaleOriented(StrokePlan &plan,
+                              const ImageView &im,
+                              const AngleBins &bins,
+                              const ImportanceSampler &importance,
+                              int size,
+                              const CoverageTarget &target,
+                              float noise,
+                              unsigned int seed = 0,
+                              int layer = 0);
+
+void sampleLightToDark(StrokePlan &plan,
+                       const ImageView &im,
+                       const AngleBins &bins,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed = 0,
+                       int layer = 0);
+
+void sampleDarkToLight(StrokePlan &plan,
+                       const ImageView &im,
+                       const AngleBins &bins,
+                       const ImportanceSampler &importance,
+                       int size,
+                       int strokes,
+                       float noise,
+                       unsigned int seed = 0,
+                       int layer = 0);
+
+// Analysis of an image shared by the plans below: each part is computed the
+// first time a plan asks for it and then reused, so painting several styles
+// from the same input analyses it once. Safe to share between threads. The
+// image must outlive the analysis.
+class PaintAnalysis {
+public:
+    explicit PaintAnalysis(const Image &im);
+    ~PaintAnalysis();
+
+    const Image & image() const { return im; }
+    const Image & angles() const;                  // computeAngles(im)
+    const AngleBins & angleBins(int numAngles) const;  // AngleBins(angles(), numAngles)
+    const ImportanceSampler & sharpness() const;   // drawn from sharpnessEnergy(im)
+    const LuminancePyramid & pyramid() const;
+
+private:
+    const Image &im;
+    mutable std::once_flag angles_once, sharpness_once, pyramid_once;
+    mutable std::unique_ptr<Image> angles_;
+    mutable std::unique_ptr<ImportanceSampler> sharpness_;
+    mutable std::unique_ptr<LuminancePyramid> pyramid_;
+    mutable std::mutex bins_mutex;
+    mutable std::map<int, std::unique_ptr<AngleBins> > bins_;
+
+    PaintAnalysis(const PaintAnalysis &);
+    PaintAnalysis & operator=(const PaintAnalysis &);
+};
+
+// Every layer of the corresponding paint mode.
+// painterly(im, texture, ...) == renderStrokePlan(painterlyPlan(im, ...), texture)
+// The PaintAnalysis overloads return the same plans as the Image ones.
+StrokePlan painterlyPlan(const Image &im,
+                         int strokes = 10000,
+                         int size = 50,
+                         float noise = 0.3f,
+                         unsigned int seed = 0);
+
+StrokePlan orientedPaintPlan(const Image &im,
+                             int strokes = 7000,
+                             int size = 50,
+                             float noise = 0.3f,
+                             unsigned int seed = 0,
+                             int numAngles = 36);
+
+StrokePlan lightToDarkPlan(const Image &im,
+                           int strokes = 1000,
+                           int size = 50,
+                           float noise = 0.3f,
+                           unsigned int seed = 0,
+                           int numAngles = 36);
+
+StrokePlan darkToLightPlan(const Image &im,
+                           int strokes = 10000,
+                           int size = 50,
+                           float noise = 0.3f,
+                           unsigned int seed = 0,
+                           int numAngles = 36);
+
+StrokePlan multiScaleOrientedPlan(const Image &im,
+                                  int strokes,
+                                  int size, float noise, int numScales = 2,
+                                  unsigned int seed = 0,
+                                  int numAngles = 36);
+
+StrokePlan painterlyPlan(const PaintAnalysis &analysis,
+                         int strokes = 10000,
+                         int size = 50,
+                         float noise = 0.3f,
+                         unsigned int seed = 0);
+
+StrokePlan orientedPaintPlan(const PaintAnalysis &analysis,
+                             int strokes = 7000,
+                             int size = 50,
+                             float noise = 0.3f,
+                             unsigned int seed = 0,
+                             int numAngles = 36);
+
+StrokePlan lightToDarkPlan(const PaintAnalysis &analysis,
+                           int strokes = 1000,
+                           int size = 50,
+                           float noise = 0.3f,
+                           unsigned int seed = 0,
+                           int numAngles = 36);
+
+StrokePlan darkToLightPlan(const PaintAnalysis &analysis,
+                           int strokes = 10000,
+                           int size = 50,
+                           float noise = 0.3f,
+                           unsigned int seed = 0,
+                           int numAngles = 36);
+
+StrokePlan multiScaleOrientedPlan(const PaintAnalysis &analysis,
+                                  int strokes,
+                                  int size, float noise, int numScales = 2,
+                                  unsigned int seed = 0,
+                                  int numAngles = 36);
+
+// painterlyPlan and orientedPaintPlan with both layers drawn until they
+// cover target. The plan's layer array tells how many strokes each got.
+StrokePlan painterlyPlan(const PaintAnalysis &analysis,
+                         const CoverageTarget &target,
+                         int size = 50,
+                         float noise = 0.3f,
+                         unsigned int seed = 0);
+
+StrokePlan orientedPaintPlan(const PaintAnalysis &analysis,
+                             const CoverageTarget &target,
+                             int size = 50,
+                             float noise = 0.3f,
+                             unsigned int seed = 0,
+                             int numAngles = 36);
+// ------------------------------------------------------
@@ -1,13 +1,43 @@
 #include <iostream>
 #include "a10.h"
+#include "strokeRasterizer.h"
+#include "fixedCanvas.h"
+#include "blendKernel.h"
+#include "radixSort.h"
+#include "pyramid.h"
+#include "tiledPainter.h"
+#include "videoPainter.h"
+#include "batch.h"
+#include "curvedStroke.h"
+#include "errorDriven.h"
+#include "structureTensor.h"
+#include "basicImageManipulation.h"
+#include "filtering.h"
+#include "parallel.h"
+#include "random.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <fstream>
+#include <Eigen/Eigenvalues>
 
 using namespace std;
 
+// Milliseconds taken by f
+template <typename F>
+double timeMs(F f)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
 void testBrush()
 {
   Image black(1000, 1000, 3);
@@ -43,6 +73,1146 @@ void testBrush()
   black_two.write("./Output/half_opaque_brush.png");
 };
 
+void testRasterizeStrokes()
+{
+  // the tiled rasterizer must match the serial brush() loop bit for bit
+  Image brush_texture("./Input/brush.png");
+
+  StrokePlan plan(400, 300, 36);
+  for (int i = 0; i < 5000; ++i)
+  {
+    float color[3] = {rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX};
+    plan.append(rand() % 400, rand() % 300, color, rand() % 36, 20 + rand() % 40, 0);
+  }
+
+  Image serial(400, 300, 3);
+  rasterizeSerial(serial, plan, brush_texture);
+
+  Image tiled(400, 300, 3);
+  rasterizeTiled(tiled, plan, brush_texture, 64);
+
+  int mismatches = 0;
+  for (int i = 0; i < serial.number_of_elements(); ++i)
+  {
+    mismatches += (serial(i) != tiled(i));
+  }
+  cout << "rasterizeTiled mismatches: " << mismatches << endl;
+  tiled.write("./Output/rasterize_strokes.png");
+}
+
+void testStrokePlan()
+{
+  // sample once, save and reload the plan, then render it with every brush
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  Image long_brush("./Input/longBrush.png");
+  Image long_brush2("./Input/longBrush2.png");
+
+  StrokePlan plan = orientedPaintPlan(archie, 10000, 50, 0.3f);
+  plan.write("./Output/orientedPaint_archie.plan");
+  StrokePlan loaded = StrokePlan::read("./Output/orientedPaint_archie.plan");
+  cout << "plan strokes: " << plan.count() << ", reloaded: " << loaded.count() << endl;
+  if (loaded.width != plan.width || loaded.height != plan.height || loaded.numAngles != plan.numAngles ||
+      loaded.x != plan.x || loaded.y != plan.y || loaded.r != plan.r || loaded.g != plan.g ||
+      loaded.b != plan.b || loaded.bin != plan.bin || loaded.size != plan.size || loaded.layer != plan.layer)
+    cout << "FAILED: the reloaded plan differs" << endl;
+
+  // truncated files, and bins or header values out of range, are rejected
+  // before anything is allocated for them
+  auto rejected = [](const string &bytes) {
+    {
+      ofstream out("./Output/bad.plan", ios::binary);
+      out.write(bytes.data(), bytes.size());
+    }
+    try
+    {
+      StrokePlan::read("./Output/bad.plan");
+    }
+    catch (const FileFormatException &)
+    {
+      return true;
+    }
+    return false;
+  };
+  string file;
+  {
+    ifstream in("./Output/orientedPaint_archie.plan", ios::binary);
+    file.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  string truncated = file.substr(0, file.size() - 1);
+  string huge = file.substr(0, 24);
+  uint32_t many = 0xffffffffu;
+  memcpy(&huge[20], &many, 4);
+  string no_angles = file;
+  int32_t zero = 0;
+  memcpy(&no_angles[16], &zero, 4);
+  string bad_bin = file;
+  bad_bin[24 + 20 * plan.count()] = static_cast<char>(plan.numAngles);
+  if (!rejected(truncated) || !rejected(huge) || !rejected(no_angles) || !rejected(bad_bin))
+    cout << "FAILED: a corrupt plan was read" << endl;
+
+  // values that do not fit the arrays are refused
+  const float gray[3] = {0.5f, 0.5f, 0.5f};
+  int refused = 0;
+  const int bad[3][3] = {{plan.numAngles, 50, 0}, {0, 70000, 0}, {0, 50, 256}};
+  for (int k = 0; k < 3; ++k)
+  {
+    try
+    {
+      plan.append(0, 0, gray, bad[k][0], bad[k][1], bad[k][2]);
+    }
+    catch (const InvalidArgument &)
+    {
+      ++refused;
+    }
+  }
+  if (refused != 3)
+    cout << "FAILED: StrokePlan::append stored an out of range value" << endl;
+
+  renderStrokePlan(loaded, brush).write("./Output/plan_archie.png");
+  renderStrokePlan(loaded, long_brush).write("./Output/plan_archie_long.png");
+  renderStrokePlan(loaded, long_brush2).write("./Output/plan_archie_long2.png");
+}
+
+void testSamplingThreads()
+{
+  // the random numbers of a stroke only depend on (seed, layer, index), so
+  // a plan is the same on 1 thread and on several, chunk by chunk
+  Image archie("./Input/archie.png");
+  auto samePlans = [](const StrokePlan &a, const StrokePlan &b) {
+    return a.x == b.x && a.y == b.y && a.r == b.r && a.g == b.g && a.b == b.b &&
+           a.bin == b.bin && a.size == b.size && a.layer == b.layer;
+  };
+  StrokePlan oriented[2], painterly[2];
+  const int threads[2] = {1, 4};
+  for (int t = 0; t < 2; ++t)
+  {
+    threadCountOverride() = threads[t];
+    oriented[t] = orientedPaintPlan(archie, 20000, 50, 0.3f, 7);
+    painterly[t] = painterlyPlan(archie, 20000, 50, 0.3f, 7);
+  }
+  threadCountOverride() = 0;
+  if (!samePlans(oriented[0], oriented[1]) || !samePlans(painterly[0], painterly[1]))
+    cout << "FAILED: a plan depends on the number of threads" << endl;
+
+  // each layer draws its own stream: the same seed and settings on two
+  // layers give different strokes
+  ImportanceSampler uniform(archie.width(), archie.height());
+  StrokePlan layers[2] = {StrokePlan(archie.width(), archie.height()), StrokePlan(archie.width(), archie.height())};
+  for (int l = 0; l < 2; ++l)
+    sampleSingleScale(layers[l], archie, uniform, 20, 5000, 0.3f, 7, l);
+  int same = 0;
+  for (int i = 0; i < layers[0].count(); ++i)
+    same += layers[0].x[i] == layers[1].x[i] && layers[0].y[i] == layers[1].y[i];
+  cout << "sampling: plans equal on 1 and 4 threads, " << same << "/" << layers[0].count()
+       << " strokes at the same place on two layers" << endl;
+  if (same > layers[0].count() / 100)
+    cout << "FAILED: two layers draw the same strokes" << endl;
+}
+
+void testImportanceSampler()
+{
+  // histograms of many draws against density(): a map with zero and
+  // negative weights, a map coarser than its canvas (with cells of unequal
+  // sizes), the uniform sampler, and maps with nothing to draw
+  Image weights(6, 4, 1);
+  for (int y = 0; y < 4; ++y)
+    for (int x = 0; x < 6; ++x)
+      weights(x, y) = (x + y) % 4 == 0 ? 0.0f : (x + y) % 4 == 1 ? -1.0f : static_cast<float>(x + 2 * y);
+  Image coarse(3, 2, 1);
+  for (int i = 0; i < 6; ++i)
+    coarse(i) = static_cast<float>(i + 1);
+
+  const ImportanceSampler samplers[3] = {ImportanceSampler(weights), ImportanceSampler(coarse, 10, 7),
+                                         ImportanceSampler(10, 7)};
+  const char *names[3] = {"weights", "coarse", "uniform"};
+  const int draws = 200000;
+  StrokeRandom rng(1, 0);
+  for (int k = 0; k < 3; ++k)
+  {
+    const ImportanceSampler &sampler = samplers[k];
+    Image density = sampler.density();
+    vector<int> histogram(sampler.width() * sampler.height(), 0);
+    for (int i = 0; i < draws; ++i)
+    {
+      uint32_t w[4];
+      rng.words(i, 0, w);
+      int x, y;
+      sampler.sample(w, x, y);
+      ++histogram[x + y * sampler.width()];
+    }
+    // within 5 standard deviations of the expected count, and never where
+    // the density is zero
+    double sum = 0.0, worst = 0.0;
+    int bad = 0;
+    for (int i = 0; i < static_cast<int>(histogram.size()); ++i)
+    {
+      double expected = density(i) * draws;
+      double deviation = fabs(histogram[i] - expected) / sqrt(max(expected, 1.0));
+      worst = max(worst, deviation);
+      bad += deviation > 5.0 || (density(i) == 0.0f && histogram[i] > 0);
+      sum += density(i);
+    }
+    cout << "importance " << names[k] << ": worst deviation " << worst << " sigma" << endl;
+    if (bad || fabs(sum - 1.0) > 1e-4 || sampler.empty())
+      cout << "FAILED: " << names[k] << " draws do not follow density()" << endl;
+  }
+
+  // no weight anywhere: empty, and a zero density
+  Image zero(5, 5, 1), negative(5, 5, 1);
+  negative.set_color(-1.0f);
+  const ImportanceSampler nothing[2] = {ImportanceSampler(zero), ImportanceSampler(negative)};
+  for (int k = 0; k < 2; ++k)
+  {
+    Image density = nothing[k].density();
+    float peak = 0.0f;
+    for (int i = 0; i < density.number_of_elements(); ++i)
+      peak = max(peak, fabs(density(i)));
+    if (!nothing[k].empty() || peak != 0.0f)
+      cout << "FAILED: a map without weight is not empty" << endl;
+  }
+}
+
+void benchmarkRasterizers()
+{
+  // time every rasterizer backend on the same plan
+  Image ville("./Input/villeperdue.png");
+  Image brush("./Input/brush.png");
+  StrokePlan plan = orientedPaintPlan(ville, 10000, 50, 0.3f);
+
+  Image warmup(plan.width, plan.height, 3);
+  rasterizeSerial(warmup, plan, brush); // builds the brush atlases
+
+  const int runs = 5;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i)
+  {
+    Image out(plan.width, plan.height, 3);
+    rasterizeSerial(out, plan, brush);
+  }
+  double serial_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i)
+  {
+    Image out(plan.width, plan.height, 3);
+    rasterizeTiled(out, plan, brush);
+  }
+  double tiled_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / runs;
+
+  cout << plan.count() << " strokes: serial " << serial_ms << " ms, tiled " << tiled_ms << " ms" << endl;
+}
+
+// brush() as it was before the row kernel: column order, bounds checked
+// accessors, colour passed by value. Kept as the reference for the tests below.
+static void brushReference(Image &im, int x, int y, vector<float> color, const Image &texture)
+{
+  int half_width = texture.width() / 2;
+  int half_height = texture.height() / 2;
+  if ((x + half_width >= im.width()) || (y + half_height >= im.height()) ||
+      (x - half_width < 0) || (y - half_height < 0))
+  {
+    return;
+  }
+  for (int i = -half_width; i < half_width; ++i)
+  {
+    for (int j = -half_height; j < half_height; ++j)
+    {
+      float opacity = texture(i + half_width, j + half_height);
+      for (int c = 0; c < im.channels(); ++c)
+      {
+        im(x + i, y + j, c) = opacity * color[c] + (1.0f - opacity) * im(x + i, y + j, c);
+      }
+    }
+  }
+}
+
+void testBlendKernel()
+{
+  // every kernel, and brush() itself, must match the reference loop exactly
+  Image brush_texture("./Input/brush.png");
+  Image reference(400, 300, 3);
+  Image vectorized(400, 300, 3);
+  for (int i = 0; i < 2000; ++i)
+  {
+    vector<float> color = {rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX};
+    int x = rand() % 400, y = rand() % 300;
+    brushReference(reference, x, y, color, brush_texture);
+    brush(vectorized, x, y, color, brush_texture);
+  }
+  int mismatches = 0;
+  for (int i = 0; i < reference.number_of_elements(); ++i)
+    mismatches += (reference(i) != vectorized(i));
+  cout << "brush() (" << blendKernelName(bestBlendKernel()) << ") mismatches: " << mismatches << endl;
+
+  // odd lengths exercise the scalar tail of the vector kernels
+  for (int k = BLEND_SCALAR; k <= bestBlendKernel(); ++k)
+  {
+    mismatches = 0;
+    for (int n = 1; n < 40; ++n)
+    {
+      vector<float> opacity(n), expected(2 * n), actual(2 * n);
+      for (int i = 0; i < n; ++i)
+        opacity[i] = rand() / (float)RAND_MAX;
+      for (int i = 0; i < 2 * n; ++i)
+        expected[i] = actual[i] = rand() / (float)RAND_MAX;
+      float color[2] = {0.25f, 0.8f};
+      float *expected_planes[2] = {&expected[0], &expected[n]};
+      float *actual_planes[2] = {&actual[0], &actual[n]};
+      blendRow(expected_planes, 2, opacity.data(), color, n, BLEND_SCALAR);
+      blendRow(actual_planes, 2, opacity.data(), color, n, static_cast<BlendKernel>(k));
+      for (int i = 0; i < 2 * n; ++i)
+        mismatches += (expected[i] != actual[i]);
+    }
+    cout << blendKernelName(static_cast<BlendKernel>(k)) << " kernel mismatches: " << mismatches << endl;
+  }
+}
+
+void benchmarkBrush()
+{
+  // texels per second of the reference loop against brush()
+  Image brush_texture("./Input/brush.png");
+  Image canvas(1000, 1000, 3);
+  vector<float> color = {0.8f, 0.4f, 0.1f};
+  const int strokes = 20000;
+  double texels = static_cast<double>(strokes) * (brush_texture.width() / 2 * 2)
+                  * (brush_texture.height() / 2 * 2);
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int i = 0; i < strokes; ++i)
+    brushReference(canvas, 200 + i % 600, 200 + (i / 600) % 600, color, brush_texture);
+  double reference_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < strokes; ++i)
+    brush(canvas, 200 + i % 600, 200 + (i / 600) % 600, color, brush_texture);
+  double kernel_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "brush texels/s: reference " << texels / reference_s / 1e6 << "M, "
+       << blendKernelName(bestBlendKernel()) << " " << texels / kernel_s / 1e6 << "M" << endl;
+}
+
+void testRadixSort()
+{
+  // the radix sort must give the same order as a stable comparison sort,
+  // whatever the number of threads
+  vector<uint16_t> keys(100000);
+  for (size_t i = 0; i < keys.size(); ++i)
+    keys[i] = rand() % 1000;
+  vector<int> expected(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i)
+    expected[i] = i;
+  stable_sort(expected.begin(), expected.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+  for (int threads = 1; threads <= 4; threads *= 2)
+  {
+    vector<int> order = radixSortOrder(keys, threads);
+    cout << "radixSortOrder (" << threads << " threads) matches stable_sort: "
+         << (order == expected ? "yes" : "no") << endl;
+  }
+}
+
+void testProgressivePaint()
+{
+  // without a budget the progressive render matches the blocking one, with
+  // a budget it stops early and returns the partial canvas
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+
+  RenderControl control;
+  control.strokesPerFrame = 2500;
+  int frames = 0;
+  control.onFrame = [&](const Image &canvas, const RenderProgress &progress) {
+    cout << "frame " << frames << ": " << progress.strokes << " strokes, layer " << progress.layer
+         << (progress.layerDone ? " (layer done)" : "") << (progress.complete ? " (complete)" : "")
+         << ", " << progress.seconds << " s" << endl;
+    if (progress.layerDone && !progress.complete)
+    {
+      ostringstream name;
+      name << "./Output/progressive_archie_layer" << progress.layer << ".png";
+      canvas.write(name.str());
+    }
+    ++frames;
+    return true;
+  };
+  Image progressive = orientedPaint(archie, brush, control, 10000, 50, 0.3f);
+  Image blocking = orientedPaint(archie, brush, 10000, 50, 0.3f);
+  int mismatches = 0;
+  for (int i = 0; i < blocking.number_of_elements(); ++i)
+    mismatches += (progressive(i) != blocking(i));
+  cout << "progressive orientedPaint mismatches: " << mismatches << endl;
+
+  RenderControl budget;
+  budget.timeBudget = 0.05;
+  budget.onFrame = [](const Image &, const RenderProgress &progress) {
+    cout << "budgeted: " << progress.strokes << " strokes in " << progress.seconds << " s"
+         << (progress.complete ? " (complete)" : "") << endl;
+    return true;
+  };
+  painterly(archie, brush, budget, 10000, 50, 0.3f).write("./Output/progressive_archie_budget.png");
+}
+
+void testTiledPainter()
+{
+  // compositing tile by tile must give the same image as rendering all the
+  // planned strokes at once, and streaming through PPM files must not
+  // change anything beyond 8-bit rounding
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+
+  ImageTileSource source(archie);
+  TiledPainter painter(source, brush, 128);
+  painter.plan(10000, 50, 0.3f);
+  Image tiled(archie.width(), archie.height(), 3);
+  ImageTileSink sink(tiled);
+  painter.composite(sink);
+
+  StrokePlan strokes = painter.strokes();
+  Image whole = renderStrokePlan(strokes, brush);
+  int mismatches = 0;
+  for (int i = 0; i < whole.number_of_elements(); ++i)
+    mismatches += (whole(i) != tiled(i));
+  cout << "tiled painter: " << painter.tilesX() << "x" << painter.tilesY() << " tiles, "
+       << strokes.count() << " strokes, mismatches with whole canvas: " << mismatches << endl;
+  tiled.write("./Output/tiled_archie.png");
+
+  {
+    PPMTileSink input("./Output/archie.ppm", archie.width(), archie.height());
+    copyTiles(source, input, 100);
+  }
+  {
+    PPMTileSource input("./Output/archie.ppm");
+    PPMTileSink output("./Output/tiled_archie.ppm", archie.width(), archie.height());
+    tiledOrientedPaint(input, output, brush, 10000, 50, 0.3f, 0, 128);
+  }
+  Image streamed(archie.width(), archie.height(), 3);
+  ImageTileSink streamed_sink(streamed);
+  copyTiles(PPMTileSource("./Output/tiled_archie.ppm"), streamed_sink);
+  float max_error = 0.0f;
+  for (int i = 0; i < streamed.number_of_elements(); ++i)
+    max_error = max(max_error, fabs(streamed(i) - min(max(tiled(i), 0.0f), 1.0f)));
+  cout << "tiled painter through PPM files: max error " << max_error * 255.0f << "/255" << endl;
+}
+
+void testVideoPainter()
+{
+  // a mostly static clip: archie with a small square moving across it
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  const int num_frames = 6;
+  vector<Image> clip;
+  for (int f = 0; f < num_frames; ++f)
+  {
+    Image frame = archie;
+    frame.create_rectangle(300 + 12 * f, 200, 347 + 12 * f, 247, 0.1f, 0.3f, 0.9f);
+    clip.push_back(frame);
+  }
+
+  // only paint() is timed, not writing the frames out
+  VideoPainter painter(brush, 10000, 50, 0.3f);
+  double incremental_ms = 0.0;
+  for (int f = 0; f < num_frames; ++f)
+  {
+    const Image *out = 0;
+    double ms = timeMs([&]() { out = &painter.paint(clip[f]); });
+    if (f > 0)
+      incremental_ms += ms;  // the first frame is a full paint
+    cout << "video frame " << f << ": " << painter.dirtyBlocks() << " dirty, "
+         << painter.repaintedBlocks() << " repainted of " << painter.numBlocks() << " blocks, " << ms << " ms" << endl;
+    ostringstream name;
+    name << "./Output/video_archie_" << f << ".png";
+    out->write(name.str());
+  }
+
+  // a repeated frame changes nothing
+  painter.paint(clip[num_frames - 1]);
+  cout << "repeated frame: " << painter.dirtyBlocks() << " dirty blocks" << endl;
+  if (painter.dirtyBlocks())
+    cout << "FAILED: a repeated frame has dirty blocks" << endl;
+
+  // the same frames painted from scratch
+  double full_ms = 0.0;
+  for (int f = 1; f < num_frames; ++f)
+    full_ms += timeMs([&]() { orientedPaint(clip[f], brush, 10000, 50, 0.3f); });
+  cout << "frames/s: incremental " << 1000.0 * (num_frames - 1) / incremental_ms
+       << ", from scratch " << 1000.0 * (num_frames - 1) / full_ms
+       << ", speedup " << full_ms / incremental_ms << "x" << endl;
+}
+
+void testBatch()
+{
+  // two inputs, two styles each, and a job whose input does not exist
+  {
+    ofstream manifest("./Output/batch_manifest.txt");
+    manifest << "# input style output [options]\n"
+             << "./Input/archie.png painterly ./Output/batch_archie_painterly.png strokes=3000\n"
+             << "./Input/archie.png oriented ./Output/batch_archie_oriented.png strokes=3000 seed=3\n"
+             << "./Input/china.png oriented ./Output/batch_china_oriented.png strokes=3000\n"
+             << "./Input/china.png darkToLight ./Output/batch_china_dark.png strokes=3000 size=40\n"
+             << "./Input/missing.png painterly ./Output/batch_missing.png\n";
+  }
+  vector<BatchJob> jobs = readManifest("./Output/batch_manifest.txt");
+  BatchReport report = runBatch(jobs, 2);
+  cout << "batch: " << report.images << " images, " << report.failures << " failed, "
+       << report.imagesPerMinute() << " images/minute" << endl;
+
+  // same pictures as the paint functions
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  orientedPaint(archie, brush, 3000, 50, 0.3f, 3).write("./Output/batch_archie_reference.png");
+  Image expected("./Output/batch_archie_reference.png");
+  Image batched("./Output/batch_archie_oriented.png");
+  int mismatches = 0;
+  for (int i = 0; i < expected.number_of_elements(); ++i)
+    mismatches += expected(i) != batched(i);
+  cout << "batch vs orientedPaint: " << mismatches << " mismatches" << endl;
+}
+
+void testBrushMipChain()
+{
+  // a brush served from the mip chain keeps the coverage of the texture; a
+  // direct bilinear downscale point-samples it
+  Image texture("./Input/longBrush2.png");
+  const BrushMipChain &mips = brushMipChain(texture);
+  cout << "brush mip chain: " << mips.numLevels() << " levels from "
+       << texture.width() << "x" << texture.height() << endl;
+
+  // opacity mean and centroid, in units of the image size
+  auto moments = [](const Image &im, double &mean, double &cx, double &cy)
+  {
+    mean = cx = cy = 0.0;
+    for (int y = 0; y < im.height(); ++y)
+      for (int x = 0; x < im.width(); ++x)
+      {
+        mean += im(x, y, 0);
+        cx += im(x, y, 0) * (x + 0.5) / im.width();
+        cy += im(x, y, 0) * (y + 0.5) / im.height();
+      }
+    cx /= mean;
+    cy /= mean;
+    mean /= static_cast<double>(im.width()) * im.height();
+  };
+  double full_mean, full_cx, full_cy;
+  moments(texture, full_mean, full_cx, full_cy);
+
+  const int sizes[] = {50, 25, 12, 6};
+  for (int i = 0; i < 4; ++i)
+  {
+    float factor = static_cast<float>(sizes[i]) / max(texture.width(), texture.height());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Image direct = scaleLin(texture, factor);
+    double direct_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    Image mip = mips.resample(sizes[i]);
+    double mip_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    double direct_mean = 0.0;
+    for (int y = 0; y < mip.height(); ++y)
+      for (int x = 0; x < mip.width(); ++x)
+        direct_mean += direct(x, y, 0);
+    direct_mean /= static_cast<double>(mip.width()) * mip.height();
+    double mip_mean, mip_cx, mip_cy;
+    moments(mip, mip_mean, mip_cx, mip_cy);
+    cout << "size " << sizes[i] << " (" << mip.width() << "x" << mip.height() << "): mean opacity "
+         << full_mean << " texture, " << direct_mean << " scaleLin (" << direct_ms << " ms), "
+         << mip_mean << " mip chain (" << mip_ms << " ms)" << endl;
+
+    // odd level sizes must not pull the brush off centre
+    double drift = max(fabs(mip_cx - full_cx) * mip.width(), fabs(mip_cy - full_cy) * mip.height());
+    if (drift > 0.1)
+      cout << "FAILED: mip chain brush of size " << sizes[i] << " is " << drift
+           << " pixels off the texture's centroid" << endl;
+  }
+  mips.resample(12).write("./Output/brush_mip_12.png");
+}
+
+void testFixedCanvas()
+{
+  // the fixed point kernels agree with their scalar version, including the
+  // end points of the opacity and color ranges
+  for (int k = BLEND_SCALAR; k <= bestBlendKernel(); ++k)
+  {
+    int mismatches = 0;
+    for (int n = 1; n < 40; ++n)
+    {
+      vector<uint16_t> opacity(n);
+      for (int i = 0; i < n; ++i)
+        opacity[i] = i % 5 == 0 ? 0 : i % 7 == 0 ? opacity_one : rand() % (opacity_one + 1);
+      int16_t color8[3] = {0, 255 << 7, static_cast<int16_t>((rand() % 256) << 7)};
+      uint16_t color16[3] = {0, 65535, static_cast<uint16_t>(rand() % 65536)};
+      vector<int16_t> expected8(3 * n), actual8(3 * n);
+      vector<uint16_t> expected16(3 * n), actual16(3 * n);
+      for (int i = 0; i < 3 * n; ++i)
+      {
+        expected8[i] = actual8[i] = static_cast<int16_t>(rand() % ((255 << 7) + 1));
+        expected16[i] = actual16[i] = static_cast<uint16_t>(rand() % 65536);
+      }
+      int16_t *e8[3] = {&expected8[0], &expected8[n], &expected8[2 * n]};
+      int16_t *a8[3] = {&actual8[0], &actual8[n], &actual8[2 * n]};
+      uint16_t *e16[3] = {&expected16[0], &expected16[n], &expected16[2 * n]};
+      uint16_t *a16[3] = {&actual16[0], &actual16[n], &actual16[2 * n]};
+      blendRowFixed8(e8, opacity.data(), color8, n, BLEND_SCALAR);
+      blendRowFixed8(a8, opacity.data(), color8, n, static_cast<BlendKernel>(k));
+      blendRowFixed16(e16, opacity.data(), color16, n, BLEND_SCALAR);
+      blendRowFixed16(a16, opacity.data(), color16, n, static_cast<BlendKernel>(k));
+      for (int i = 0; i < 3 * n; ++i)
+        mismatches += (expected8[i] != actual8[i]) + (expected16[i] != actual16[i]);
+    }
+    cout << blendKernelName(static_cast<BlendKernel>(k)) << " fixed point kernel mismatches: " << mismatches << endl;
+  }
+
+  // the same plan on float, 16 bit and 8 bit canvases
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  StrokePlan plan = orientedPaintPlan(archie, 10000, 50, 0.3f);
+  renderStrokePlan(plan, brush);   // build the atlases outside the timings
+
+  const CanvasPrecision precisions[] = {CANVAS_FLOAT32, CANVAS_UINT16, CANVAS_UINT8};
+  Image reference(1, 1, 1);
+  for (int p = 0; p < 3; ++p)
+  {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Image out = renderStrokePlan(plan, brush, precisions[p]);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out.write("./Output/fixed_" + string(canvasPrecisionName(precisions[p])) + ".png");
+    if (p == 0)
+    {
+      reference = out;
+      cout << canvasPrecisionName(precisions[p]) << " canvas: " << ms << " ms" << endl;
+      continue;
+    }
+    // against the float canvas, both as they would be written to a PNG
+    double worst = 0.0, sum = 0.0;
+    for (int i = 0; i < out.number_of_elements(); ++i)
+    {
+      double d = fabs(min(max(out(i), 0.0f), 1.0f) - min(max(reference(i), 0.0f), 1.0f));
+      worst = max(worst, d);
+      sum += d;
+    }
+    cout << canvasPrecisionName(precisions[p]) << " canvas: " << ms << " ms, max error "
+         << worst * 255 << "/255, mean error " << sum / out.number_of_elements() * 255 << "/255" << endl;
+    if (worst * 255 > 1.0)
+      cout << "FAILED: " << canvasPrecisionName(precisions[p]) << " canvas is more than 1/255 off the float one" << endl;
+  }
+
+  // Compositing alone, without the conversion to an Image. With every
+  // stroke of archie's plan, a 64 pixel tile of the float canvas (48 KB)
+  // stays in cache while its strokes are blended, so only the arithmetic
+  // counts, and per texel the integer kernels do about as much (a 16 bit
+  // multiply with rounding) as the float multiply-add; the 8 bit canvas
+  // blends a 16 bit copy of the tile anyway. The smaller canvas barely
+  // shows. It does once few strokes land on each tile of a large canvas,
+  // where moving the canvas in and out of cache dominates.
+  Image large = scaleLin(archie, 3.0f);
+  StrokePlan sparse = orientedPaintPlan(large, 10000, 50, 0.3f);
+  renderStrokePlan(sparse, brush);
+  const StrokePlan *plans[2] = {&plan, &sparse};
+  const char *names[2] = {"dense", "sparse"};
+  for (int k = 0; k < 2; ++k)
+  {
+    const StrokePlan &pl = *plans[k];
+    Image canvas(pl.width, pl.height, 3);
+    FixedCanvas canvas16(pl.width, pl.height, CANVAS_UINT16), canvas8(pl.width, pl.height, CANVAS_UINT8);
+    double float_ms = timeMs([&]() { rasterizeTiled(canvas, pl, brush); });
+    double ms16 = timeMs([&]() { rasterizeFixed(canvas16, pl, brush); });
+    double ms8 = timeMs([&]() { rasterizeFixed(canvas8, pl, brush); });
+    cout << names[k] << " " << pl.width << "x" << pl.height << ", " << pl.count() << " strokes: float32 "
+         << float_ms << " ms, uint16 " << ms16 << " ms, uint8 " << ms8 << " ms" << endl;
+  }
+}
+
+void testFrontToBack()
+{
+  // front to back with the under operator against the back to front path,
+  // on a dense plan where most strokes end up under others
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  StrokePlan plan = orientedPaintPlan(archie, 40000, 50, 0.3f);
+  renderStrokePlan(plan, brush);   // build the atlases outside the timings
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  Image reference = renderStrokePlan(plan, brush);
+  double reference_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  cout << "back to front: " << reference_ms << " ms" << endl;
+
+  // the deviation the header allows: float rounding, plus saturation times
+  // the brightest stroke color
+  float brightest = 0.0f;
+  for (int s = 0; s < plan.count(); ++s)
+    brightest = max(brightest, max(plan.r[s], max(plan.g[s], plan.b[s])));
+  const float saturations[] = {0.0f, 1.0f / 1024};
+  for (int i = 0; i < 2; ++i)
+  {
+    Image out(plan.width, plan.height, 3);
+    start = chrono::steady_clock::now();
+    FrontToBackStats stats = rasterizeFrontToBack(out, plan, brush, saturations[i]);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    double worst = 0.0;
+    for (int k = 0; k < out.number_of_elements(); ++k)
+      worst = max(worst, static_cast<double>(fabs(out(k) - reference(k))));
+    cout << "front to back, saturation " << saturations[i] << ": " << ms << " ms, max difference " << worst
+         << ", skipped " << stats.skippedStrokes << "/" << stats.strokes << " stroke tiles, "
+         << stats.saturatedTiles << " tiles saturated" << endl;
+    if (worst > 1e-5 + saturations[i] * brightest)
+      cout << "FAILED: front to back differs by more than saturation " << saturations[i] << " allows" << endl;
+  }
+}
+
+void testCurvedPaint()
+{
+  // curved strokes against the stamped strokes of orientedPaint: coverage
+  // (pixels left black), error against the input and time
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  orientedPaint(archie, brush, 100);   // build the atlases outside the timings
+  curvedPaint(archie, brush, 100);
+
+  auto report = [&](const char *name, const Image &out, int strokes, double ms) {
+    int uncovered = 0;
+    double error = 0.0;
+    for (int y = 0; y < out.height(); ++y)
+      for (int x = 0; x < out.width(); ++x)
+      {
+        if (out(x, y, 0) == 0.0f && out(x, y, 1) == 0.0f && out(x, y, 2) == 0.0f)
+          ++uncovered;
+        for (int c = 0; c < 3; ++c)
+          error += fabs(out(x, y, c) - archie(x, y, c));
+      }
+    cout << name << ": " << strokes << " strokes, " << ms << " ms, "
+         << 100.0 * uncovered / (out.width() * out.height()) << "% uncovered, mean error "
+         << error / out.number_of_elements() << endl;
+  };
+
+  // End to end on one shared analysis, planning and compositing timed
+  // apart. A curved stroke covers several stamps' worth of canvas with
+  // fewer dabs of the same brush, and is traced rather than sampled one
+  // stamp at a time, so it must take less time on both counts.
+  PaintAnalysis analysis(archie);
+  Image stamped(archie.width(), archie.height(), 3), curved(archie.width(), archie.height(), 3);
+  StrokePlan stamped_plan;
+  CurvedStrokes curved_plan;
+
+  // one uniform layer: singleScaleOrientedPaint against as many curved
+  // strokes as cover about the same canvas
+  ImportanceSampler uniform(archie.width(), archie.height());
+  double stamped_ms = timeMs([&]() {
+    singleScaleOrientedPaint(archie, stamped, analysis.angles(), uniform, brush, 7000, 50, 0.3f);
+  });
+  report("single layer stamped", stamped, 7000, stamped_ms);
+  double curved_ms = timeMs([&]() {
+    CurvedStrokes layer(archie.width(), archie.height());
+    sampleCurvedStrokes(layer, archie, analysis.angles(), uniform, 50, 1000, 0.3f);
+    rasterizeCurved(curved, layer, brush);
+  });
+  report("single layer curved", curved, 1000, curved_ms);
+  cout << "single layer curved / stamped time: " << curved_ms / stamped_ms << endl;
+  if (curved_ms >= stamped_ms)
+    cout << "FAILED: a curved layer takes longer than singleScaleOrientedPaint" << endl;
+
+  // both layers of orientedPaint and curvedPaint
+  stamped = Image(archie.width(), archie.height(), 3);
+  curved = Image(archie.width(), archie.height(), 3);
+  double plan_ms = timeMs([&]() { stamped_plan = orientedPaintPlan(analysis, 7000); });
+  double raster_ms = timeMs([&]() { rasterizeTiled(stamped, stamped_plan, brush); });
+  report("stamped", stamped, stamped_plan.count(), plan_ms + raster_ms);
+  cout << "  plan " << plan_ms << " ms, composite " << raster_ms << " ms" << endl;
+  double curved_plan_ms = timeMs([&]() { curved_plan = curvedPaintPlan(analysis, 1000); });
+  double curved_raster_ms = timeMs([&]() { rasterizeCurved(curved, curved_plan, brush); });
+  report("curved", curved, curved_plan.count(), curved_plan_ms + curved_raster_ms);
+  cout << "  plan " << curved_plan_ms << " ms, composite " << curved_raster_ms << " ms" << endl;
+  cout << "curved / stamped time: " << (curved_plan_ms + curved_raster_ms) / (plan_ms + raster_ms) << endl;
+  if (curved_plan_ms + curved_raster_ms >= plan_ms + raster_ms)
+    cout << "FAILED: curvedPaint takes longer than orientedPaint" << endl;
+  curved.write("./Output/curved_archie.png");
+
+  // a stroke along a straight horizontal field is a straight run of points
+  Image flat(200, 100, 3);
+  flat.set_color(0.5f, 0.5f, 0.5f);
+  Image angles(200, 100, 1);
+  CurvedStrokes strokes(200, 100);
+  sampleCurvedStrokes(strokes, flat, angles, ImportanceSampler(200, 100), 20, 10, 0.0f);
+  for (int s = 0; s < strokes.count(); ++s)
+    for (int p = strokes.first[s] + 1; p < strokes.first[s + 1]; ++p)
+      if (fabs(strokes.py[p] - strokes.py[p - 1]) > 1e-4f || strokes.px[p] <= strokes.px[p - 1])
+        cout << "FAILED: stroke " << s << " does not follow the field" << endl;
+}
+
+void testCoverage()
+{
+  // strokes drawn to a coverage target follow the canvas size: a thumbnail
+  // gets few strokes, a 2x enlargement about 4 times as many coarse strokes
+  // as the original
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  const float factors[] = {0.25f, 1.0f, 2.0f};
+  for (int f = 0; f < 3; ++f)
+  {
+    Image im = factors[f] == 1.0f ? archie : scaleLin(archie, factors[f]);
+    PaintAnalysis analysis(im);
+    StrokePlan plan = orientedPaintPlan(analysis, CoverageTarget(0.95f));
+    int coarse = static_cast<int>(count(plan.layer.begin(), plan.layer.end(), 0));
+    cout << im.width() << "x" << im.height() << ": " << coarse << " + " << plan.count() - coarse
+         << " strokes for 95% coverage" << endl;
+    if (f == 1)
+      renderStrokePlan(plan, brush).write("./Output/coverage_archie.png");
+
+    // the same strokes as the fixed count plan, up to where each layer stops
+    StrokePlan fixed = orientedPaintPlan(analysis, coarse);
+    for (int i = 0; i < coarse; ++i)
+      if (plan.x[i] != fixed.x[i] || plan.y[i] != fixed.y[i] || plan.r[i] != fixed.r[i] || plan.bin[i] != fixed.bin[i])
+      {
+        cout << "FAILED: stroke " << i << " differs from the fixed count plan" << endl;
+        break;
+      }
+
+    // the uniform coarse layer stops right when the canvas is 95% covered
+    CoverageMap map(ImportanceSampler(im.width(), im.height()), 50);
+    for (int i = 0; i < coarse - 1; ++i)
+      map.cover(plan.x[i], plan.y[i]);
+    double before = map.coverage();
+    map.cover(plan.x[coarse - 1], plan.y[coarse - 1]);
+    if (before >= 0.95 || map.coverage() < 0.95)
+      cout << "FAILED: coarse layer stops at " << before << ", " << map.coverage() << endl;
+  }
+}
+
+void testErrorDriven()
+{
+  // the error of every cell read from the summed-area tables matches a
+  // direct sum, before and after painting part of the canvas
+  Image archie("./Input/archie.png");
+  Image brush("./Input/brush.png");
+  Image canvas(archie.width(), archie.height(), 3);
+  ErrorMap error(canvas, archie, 7);
+  for (int y = 100; y < 180; ++y)
+    for (int x = 50; x < 150; ++x)
+      for (int c = 0; c < 3; ++c)
+        canvas(x, y, c) = 0.5f;
+  error.update(50, 100, 150, 180);
+  double worst = 0.0;
+  for (int cy = 0; cy < error.cellsY(); ++cy)
+    for (int cx = 0; cx < error.cellsX(); ++cx)
+    {
+      double sum = 0.0;
+      int n = 0;
+      for (int y = cy * 7; y < min(cy * 7 + 7, canvas.height()); ++y)
+        for (int x = cx * 7; x < min(cx * 7 + 7, canvas.width()); ++x, ++n)
+          for (int c = 0; c < 3; ++c)
+            sum += fabs(canvas(x, y, c) - archie(x, y, c)) / 3.0;
+      worst = max(worst, fabs(sum / n - error.cellError(cx, cy)));
+    }
+  if (worst > 1e-5)
+    cout << "FAILED: cell error off by " << worst << endl;
+
+  // against the fixed count layers of orientedPaint
+  PaintAnalysis analysis(archie);
+  Image fixed = renderStrokePlan(orientedPaintPlan(analysis, 7000), brush);
+  vector<int> strokes;
+  Image placed = renderStrokePlan(errorDrivenPlan(analysis, brush, 50, 2, 0.1f, 0.3f, 0, 36, &strokes), brush);
+  double fixed_error = 0.0, placed_error = 0.0;
+  for (int i = 0; i < archie.number_of_elements(); ++i)
+  {
+    fixed_error += fabs(fixed(i) - archie(i));
+    placed_error += fabs(placed(i) - archie(i));
+  }
+  cout << "fixed count: 7000 + 7000 strokes, mean error " << fixed_error / archie.number_of_elements() << endl;
+  cout << "error driven: " << strokes[0] << " + " << strokes[1] << " strokes, mean error "
+       << placed_error / archie.number_of_elements() << endl;
+  placed.write("./Output/error_driven_archie.png");
+}
+
+void testAngleBins()
+{
+  // the quantized field gives the same strokes as the float angles
+  Image archie("./Input/archie.png");
+  Image angles = computeAngles(archie);
+  if (angles.channels() != 1)
+    cout << "FAILED: computeAngles returned " << angles.channels() << " channels" << endl;
+  AngleBins bins(angles, 36);
+  PaintAnalysis analysis(archie);
+  StrokePlan from_angles(archie.width(), archie.height(), 36);
+  StrokePlan from_bins(archie.width(), archie.height(), 36);
+  sampleSingleScaleOriented(from_angles, archie, angles, analysis.sharpness(), 12, 5000, 0.3f, 0, 1);
+  sampleSingleScaleOriented(from_bins, archie, bins, analysis.sharpness(), 12, 5000, 0.3f, 0, 1);
+  int mismatches = 0;
+  for (int i = 0; i < from_angles.count(); ++i)
+    if (from_angles.bin[i] != from_bins.bin[i] || from_angles.x[i] != from_bins.x[i])
+      ++mismatches;
+  if (mismatches)
+    cout << "FAILED: " << mismatches << " strokes differ" << endl;
+  cout << "angle field: " << angles.number_of_elements() * sizeof(float) << " bytes, bins: "
+       << bins.width() * bins.height() << " bytes" << endl;
+}
+
+void testTensorAngles()
+{
+  // the closed form angles match the smallest eigenvector found by Eigen,
+  // up to its sign, wherever the tensor is not vanishingly small
+  const char *names[] = {"archie", "castle", "china", "round", "taipei", "villeperdue"};
+  for (const char *name : names)
+  {
+    Image im(string("./Input/") + name + ".png");
+    Image tensor = computeTensor(im);
+    auto start = chrono::steady_clock::now();
+    Image angles = tensorAngles(tensor);
+    double closed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    int mismatches = 0;
+    for (int y = 0; y < im.height(); ++y)
+      for (int x = 0; x < im.width(); ++x)
+      {
+        Eigen::Matrix2f M;
+        M << tensor(x, y, 0), tensor(x, y, 1), tensor(x, y, 1), tensor(x, y, 2);
+        Eigen::EigenSolver<Eigen::Matrix2f> s(M);
+        int j = real(s.eigenvalues()(1)) < real(s.eigenvalues()(0)) ? 1 : 0;
+        float reference = atan2(s.eigenvectors()(1, j).real(), s.eigenvectors()(0, j).real());
+        double d = fmod(fabs(reference - angles(x, y)), M_PI);
+        if (min(d, M_PI - d) > 1e-3 && M.norm() > 1e-12f)
+          ++mismatches;
+      }
+    double eigen_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    if (mismatches)
+      cout << "FAILED: " << name << " " << mismatches << " angles differ from Eigen" << endl;
+    cout << name << ": closed form " << closed_ms << " ms, Eigen " << eigen_ms << " ms" << endl;
+  }
+}
+
+void testStructureTensor()
+{
+  // the streamed tensor matches the stage by stage computation, with one
+  // strip and with several
+  Image archie("./Input/archie.png");
+  auto start = chrono::steady_clock::now();
+  Image lumi = gaussianBlur_separable(lumiChromi(archie)[0], 3.0f);
+  Image gx = gradientX(lumi), gy = gradientY(lumi);
+  Image products(archie.width(), archie.height(), 3);
+  for (int i = 0; i < lumi.number_of_elements(); ++i)
+  {
+    products(i) = gx(i) * gx(i);
+    products(i + lumi.number_of_elements()) = gx(i) * gy(i);
+    products(i + 2 * lumi.number_of_elements()) = gy(i) * gy(i);
+  }
+  Image staged = gaussianBlur_separable(products, 15.0f);
+  double staged_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  start = chrono::steady_clock::now();
+  Image streamed = structureTensor(archie);
+  double streamed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  Image strips = structureTensor(archie, 3.0f, 5.0f, 4);
+  float worst = 0.0f;
+  for (int i = 0; i < staged.number_of_elements(); ++i)
+    worst = max(worst, max(fabs(staged(i) - streamed(i)), fabs(staged(i) - strips(i))));
+  if (worst > 1e-6f)
+    cout << "FAILED: streamed tensor off by " << worst << endl;
+  cout << "tensor: staged " << staged_ms << " ms, streamed " << streamed_ms << " ms" << endl;
+}
+
+void testImageAccess()
+{
+  // the fast path accessors read the same values as operator(), and the
+  // row by row interior of Filter::convolve matches a per pixel reference
+  Image round("./Input/round.png");
+  int mismatches = 0;
+  for (int z = 0; z < round.channels(); ++z)
+    for (int y = 0; y < round.height(); ++y)
+    {
+      int x = 0;
+      for (float v : round.span(y, z))
+      {
+        mismatches += (v != round(x, y, z)) + (round.at(x, y, z) != round(x, y, z));
+        ++x;
+      }
+    }
+  if (mismatches)
+    cout << "FAILED: " << mismatches << " fast path reads differ" << endl;
+
+  Filter f(vector<float>{0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f}, 4, 2);
+  for (int clamp = 0; clamp < 2; ++clamp)
+  {
+    Image out = f.convolve(round, clamp);
+    mismatches = 0;
+    for (int z = 0; z < round.channels(); ++z)
+      for (int y = 0; y < round.height(); ++y)
+        for (int x = 0; x < round.width(); ++x)
+        {
+          float accum = 0.0f;
+          for (int yf = 0; yf < 2; ++yf)
+            for (int xf = 0; xf < 4; ++xf)
+              accum += f(xf, yf) * round.smartAccessor(x - xf + 1, y - yf, z, clamp);
+          mismatches += (accum != out(x, y, z));
+        }
+    if (mismatches)
+      cout << "FAILED: convolve differs from the reference at " << mismatches << " pixels" << endl;
+  }
+}
+
+void testImageLayout()
+{
+  // conversions keep every value, and the kernels that handle both layouts
+  // give the same result in each; the timings show which layout suits which
+  Image archie("./Input/archie.png");
+  Image interleaved(1, 1, 1), planar(1, 1, 1);
+  double to_ms = timeMs([&]() { interleaved = archie.toLayout(IMAGE_INTERLEAVED); });
+  double back_ms = timeMs([&]() { planar = interleaved.toLayout(IMAGE_PLANAR); });
+  int mismatches = 0;
+  for (int z = 0; z < 3; ++z)
+    for (int y = 0; y < archie.height(); ++y)
+      for (int x = 0; x < archie.width(); ++x)
+        mismatches += (interleaved(x, y, z) != archie(x, y, z)) + (planar(x, y, z) != archie(x, y, z));
+  if (mismatches || interleaved.stride(0) != 3 || planar.stride(0) != 1)
+    cout << "FAILED: layout conversion changed " << mismatches << " values" << endl;
+  cout << "layout conversion: to interleaved " << to_ms << " ms, back " << back_ms << " ms" << endl;
+
+  auto differing = [](const Image &a, const Image &b) {
+    int differ = 0;
+    for (int z = 0; z < a.channels(); ++z)
+      for (int y = 0; y < a.height(); ++y)
+        for (int x = 0; x < a.width(); ++x)
+          differ += (a(x, y, z) != b(x, y, z));
+    return differ;
+  };
+  auto compare = [&](const string &kernel, const Image &a, const Image &b, double a_ms, double b_ms) {
+    int differ = differing(a, b);
+    if (differ)
+      cout << "FAILED: " << kernel << " differs between layouts at " << differ << " values" << endl;
+    cout << kernel << ": planar " << a_ms << " ms, interleaved " << b_ms << " ms" << endl;
+  };
+
+  Image a(1, 1, 1), b(1, 1, 1);
+  double a_ms = timeMs([&]() { a = rgb2yuv(archie); });
+  double b_ms = timeMs([&]() { b = rgb2yuv(interleaved); });
+  compare("rgb2yuv", a, b, a_ms, b_ms);
+
+  Image round("./Input/round.png");
+  Image round_interleaved = round.toLayout(IMAGE_INTERLEAVED);
+  a_ms = timeMs([&]() { a = bilateral(round, 0.1f, 1.0f); });
+  b_ms = timeMs([&]() { b = bilateral(round_interleaved, 0.1f, 1.0f); });
+  compare("bilateral", a, b, a_ms, b_ms);
+
+  a_ms = timeMs([&]() { a = gaussianBlur_separable(round, 2.0f); });
+  b_ms = timeMs([&]() { b = gaussianBlur_separable(round_interleaved, 2.0f); });
+  compare("gaussianBlur_separable", a, b, a_ms, b_ms);
+
+  Image texture("./Input/brush.png");
+  StrokePlan plan = orientedPaintPlan(archie, 7000);
+  Image canvas(archie.width(), archie.height(), 3);
+  Image canvas_interleaved(archie.width(), archie.height(), 3, IMAGE_INTERLEAVED);
+  auto stamp = [&](Image &out) {
+    for (int i = 0; i < plan.count(); ++i)
+    {
+      float color[3] = {plan.r[i], plan.g[i], plan.b[i]};
+      brush(out, plan.x[i], plan.y[i], color, brushAtlas(texture, plan.size[i], plan.numAngles), plan.bin[i]);
+    }
+  };
+  stamp(canvas_interleaved);  // builds the atlases
+  canvas_interleaved = Image(archie.width(), archie.height(), 3, IMAGE_INTERLEAVED);
+  a_ms = timeMs([&]() { stamp(canvas); });
+  b_ms = timeMs([&]() { stamp(canvas_interleaved); });
+  compare("brush", canvas, canvas_interleaved, a_ms, b_ms);
+
+  // the analysis reads either layout
+  a_ms = timeMs([&]() { a = computeAngles(archie); });
+  b_ms = timeMs([&]() { b = computeAngles(interleaved); });
+  compare("computeAngles", a, b, a_ms, b_ms);
+  a_ms = timeMs([&]() { a = sharpnessMap(archie); });
+  b_ms = timeMs([&]() { b = sharpnessMap(interleaved); });
+  compare("sharpnessMap", a, b, a_ms, b_ms);
+  a_ms = timeMs([&]() { a = tensorAngles(computeTensor(archie)); });
+  b_ms = timeMs([&]() { b = tensorAngles(computeTensor(archie).toLayout(IMAGE_INTERLEAVED)); });
+  compare("tensorAngles", a, b, a_ms, b_ms);
+
+  // and the rasterizers paint either layout
+  auto paintBoth = [&](const string &kernel, const function<void(Image &)> &paint) {
+    Image p(archie.width(), archie.height(), 3);
+    Image i(archie.width(), archie.height(), 3, IMAGE_INTERLEAVED);
+    double p_ms = timeMs([&]() { paint(p); });
+    double i_ms = timeMs([&]() { paint(i); });
+    compare(kernel, p, i, p_ms, i_ms);
+  };
+  paintBoth("rasterizeTiled", [&](Image &out) { rasterizeTiled(out, plan, texture); });
+  paintBoth("rasterizeFrontToBack", [&](Image &out) { rasterizeFrontToBack(out, plan, texture); });
+  paintBoth("singleScalePaint", [&](Image &out) {
+    singleScalePaint(archie, out, ImportanceSampler(archie.width(), archie.height()), texture, 20, 5000);
+  });
+  CurvedStrokes curved = curvedPaintPlan(PaintAnalysis(archie), 1000);
+  paintBoth("rasterizeCurved", [&](Image &out) { rasterizeCurved(out, curved, texture); });
+
+  // tiles are read and written in either layout
+  Image region(64, 48, 3), region_interleaved(64, 48, 3, IMAGE_INTERLEAVED);
+  ImageTileSource(archie).read(-10, 300, region);
+  ImageTileSource(interleaved).read(-10, 300, region_interleaved);
+  if (int differ = differing(region, region_interleaved))
+    cout << "FAILED: ImageTileSource differs between layouts at " << differ << " values" << endl;
+  Image sink(archie.width(), archie.height(), 3, IMAGE_INTERLEAVED);
+  ImageTileSink(sink).write(100, 200, region);
+  if (int differ = differing(crop(sink, 100, 200, 64, 48), region))
+    cout << "FAILED: ImageTileSink differs between layouts at " << differ << " values" << endl;
+
+  // rows are only handed out where they are contiguous
+  try
+  {
+    interleaved.row(0, 1);
+    cout << "FAILED: row() of an interleaved image did not throw" << endl;
+  }
+  catch (const LayoutException &) {}
+}
+
+void testImageView()
+{
+  // a view reads its image in place: filters, resamplers and operators give
+  // the same result on a cropped view as on a cropped copy, and writes
+  // through a mutable view land in the image
+  Image round("./Input/round.png");
+  int x0 = 37, y0 = 21, w = 120, h = 90;
+  Image copied(1, 1, 1);
+  ImageView view(round);
+  double copy_ms = timeMs([&]() { copied = crop(round, x0, y0, w, h); });
+  double view_ms = timeMs([&]() { view = view.crop(x0, y0, w, h); });
+  cout << "crop " << w << "x" << h << ": copy " << copy_ms << " ms, view " << view_ms << " ms" << endl;
+
+  auto same = [](const string &what, const Image &a, const Image &b) {
+    int differ = a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels();
+    for (int z = 0; z < a.channels() && !differ; ++z)
+      for (int y = 0; y < a.height(); ++y)
+        for (int x = 0; x < a.width(); ++x)
+          differ += (a(x, y, z) != b(x, y, z));
+    if (differ)
+      cout << "FAILED: " << what << " differs between the view and the copy" << endl;
+  };
+  same("Image(view)", Image(view), copied);
+  same("gaussianBlur_separable", gaussianBlur_separable(view, 2.0f), gaussianBlur_separable(copied, 2.0f));
+  same("bilateral", bilateral(view), bilateral(copied));
+  same("scaleLin", scaleLin(view, 1.7f), scaleLin(copied, 1.7f));
+  same("rotate", rotate(view, 0.3f), rotate(copied, 0.3f));
+  same("operators", view * 2.0f - view + 0.5f * copied, copied * 2.0f - copied + 0.5f * copied);
+  same("lumiChromi", lumiChromi(view)[1], lumiChromi(copied)[1]);
+
+  // a single channel of an interleaved crop, and operators across layouts
+  Image interleaved = round.toLayout(IMAGE_INTERLEAVED);
+  ImageView green_view = ImageView(interleaved).crop(x0, y0, w, h).channel(1);
+  Image green(w, h, 1);
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      green(x, y, 0) = round(x0 + x, y0 + y, 1);
+  same("channel", Image(green_view), green);
+  same("channel blur", gaussianBlur_separable(green_view, 2.0f), gaussianBlur_separable(green, 2.0f));
+  same("mixed layouts", round + interleaved, round + round);
+
+  Image canvas(round.width(), round.height(), 3);
+  copyValues(view, MutableImageView(canvas).crop(x0, y0, w, h));
+  same("copyValues", crop(canvas, x0, y0, w, h), copied);
+  if (canvas(x0 - 1, y0, 0) != 0.0f || canvas(x0, y0 + h, 2) != 0.0f)
+    cout << "FAILED: copyValues wrote outside the view" << endl;
+
+  try
+  {
+    ImageView(round).crop(round.width() - 10, 0, 11, 1);
+    cout << "FAILED: crop past the border did not throw" << endl;
+  }
+  catch (const OutOfBoundsException &) {}
+}
+
 void testSingleScalePaint()
 {
   Image archie("./Input/archie.png");
@@ -229,7 +1399,62 @@ void testSharpnessMap()
 
   Image s_ville = sharpnessMap(ville);
   s_ville.write("./Output/sharpness_ville.png");
+
+  // the streamed map is single channel and matches the stage by stage
+  // computation, with black borders as well as clamped ones
+  for (int clamp = 0; clamp < 2; ++clamp)
+  {
+    Image L = color2gray(ville);
+    Image highPass = L - gaussianBlur_separable(L, 1.0f, 4.0f, clamp);
+    Image staged = gaussianBlur_separable(highPass * highPass, 4.0f);
+    staged = staged / staged.max();
+    Image streamed = sharpnessMap(ville, 1.0f, 4.0f, clamp);
+    float worst = 0.0f;
+    for (int i = 0; i < staged.number_of_elements(); ++i)
+      worst = max(worst, fabs(staged(i) - streamed(i)));
+    if (streamed.channels() != 1 || worst > 1e-5f)
+      cout << "FAILED: streamed sharpness off by " << worst << endl;
+  }
 }
+
+void testSharpnessPyramid()
+{
+  // level 0 of the pyramid must reproduce sharpnessMap, and the coarser
+  // levels should be much cheaper to analyse
+  Image ville("./Input/villeperdue.png");
+  LuminancePyramid pyramid(ville);
+
+  Image full = sharpnessMap(ville, 2.0f, 6.0f);
+  Image level0 = pyramid.sharpness(0, 2.0f, 6.0f);
+  int mismatches = 0;
+  for (int y = 0; y < ville.height(); ++y)
+    for (int x = 0; x < ville.width(); ++x)
+      mismatches += (full(x, y, 0) != level0(x, y));
+  cout << "pyramid level 0 sharpness mismatches: " << mismatches << endl;
+
+  for (int l = 1; l < pyramid.numLevels(); ++l)
+  {
+    ostringstream name;
+    name << "./Output/sharpness_ville_level" << l << ".png";
+    pyramid.sharpness(l, 2.0f, 6.0f).write(name.str());
+  }
+
+  // the four sharpness maps of multiScaleOrientedPaint(..., size = 50, numScales = 4)
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  float sigma = 2.0f, truncate = 6.0f;
+  for (int scale = 1; scale <= 4; ++scale, sigma -= 0.2f, truncate -= 0.5f)
+    sharpnessMap(ville, sigma, truncate);
+  double full_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  start = chrono::steady_clock::now();
+  LuminancePyramid timed(ville);
+  sigma = 2.0f, truncate = 6.0f;
+  for (int scale = 1; scale <= 4; ++scale, sigma -= 0.2f, truncate -= 0.5f)
+    timed.sharpness(timed.levelFor(50 / (scale * 2), sigma), sigma, truncate);
+  double pyramid_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  cout << "4 scale analysis: full resolution " << full_ms << " ms, pyramid " << pyramid_ms << " ms" << endl;
+}
+
 void testSSOPHelper(const Image &i, const std::string &name, int numStrokes, int size)
 {
   Image brush("./Input/brush.png");
@@ -461,6 +1686,30 @@ int main()
 {
   // Test your intermediate functions
   // testBrush();
+  testRasterizeStrokes();
+  testStrokePlan();
+  testSamplingThreads();
+  testImportanceSampler();
+  // benchmarkRasterizers();
+  testBlendKernel();
+  testRadixSort();
+  testProgressivePaint();
+  testTiledPainter();
+  testVideoPainter();
+  testBatch();
+  testBrushMipChain();
+  testFixedCanvas();
+  testFrontToBack();
+  testCurvedPaint();
+  testCoverage();
+  testErrorDriven();
+  testAngleBins();
+  testTensorAngles();
+  testStructureTensor();
+  testImageAccess();
+  testImageLayout();
+  testImageView();
+  // benchmarkBrush();
   testSingleScalePaint();
   testPainterly();
 
@@ -478,5 +1727,6 @@ int main()
   testMultiScaleOrientedPaint();
 
   testSharpnessMap();
+  testSharpnessPyramid();
   return EXIT_SUCCESS;
 }
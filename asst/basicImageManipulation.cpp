@@ -9,13 +9,14 @@
 
 
 #include "basicImageManipulation.h"
+#include <algorithm>
 using namespace std;
 
 
 // --------- HANDOUT PS05 ------------------------------
 // -----------------------------------------------------
 //
-Image scaleNN(const Image &im, float factor){
+Image scaleNN(const ImageView &im, float factor){
     // --------- HANDOUT  PS05 ------------------------------
     // create a new image that is factor times bigger than the input by using
     // nearest neighbor interpolation.
@@ -45,7 +46,7 @@ Image scaleNN(const Image &im, float factor){
     return out;
 }
 
-float interpolateLin(const Image &im, float x, float y, int z, bool clamp){
+float interpolateLin(const ImageView &im, float x, float y, int z, bool clamp){
      // --------- HANDOUT  PS05 ------------------------------
      // bilinear interpolation samples the value of a non-integral
      // position (x,y) from its four "on-grid" neighboring pixels.
@@ -73,11 +74,20 @@ float interpolateLin(const Image &im, float x, float y, int z, bool clamp){
     float yalpha = y - yf;
     float xalpha = x - xf;
 
-    // obtain the values at those points
-    float tl = im.smartAccessor(xf, yf, z, clamp); // top-left
-    float tr = im.smartAccessor(xc, yf, z, clamp); // ...
-    float bl = im.smartAccessor(xf, yc, z, clamp);
-    float br = im.smartAccessor(xc, yc, z, clamp);
+    // obtain the values at those points, unchecked when all four are
+    // inside the image
+    float tl, tr, bl, br;
+    if (xf >= 0 && yf >= 0 && xc < im.width() && yc < im.height()) {
+        tl = im.at(xf, yf, z);
+        tr = im.at(xc, yf, z);
+        bl = im.at(xf, yc, z);
+        br = im.at(xc, yc, z);
+    } else {
+        tl = im.smartAccessor(xf, yf, z, clamp); // top-left
+        tr = im.smartAccessor(xc, yf, z, clamp); // ...
+        bl = im.smartAccessor(xf, yc, z, clamp);
+        br = im.smartAccessor(xc, yc, z, clamp);
+    }
 
     // compute the interpolations on the top and bottom
     float topL = tr*xalpha + tl*(1.0f - xalpha);
@@ -90,7 +100,7 @@ float interpolateLin(const Image &im, float x, float y, int z, bool clamp){
     return retv;
 }
 
-Image scaleLin(const Image &im, float factor){
+Image scaleLin(const ImageView &im, float factor){
     // --------- HANDOUT  PS05 ------------------------------
     // create a new image that is factor times bigger than the input by using
     // bilinear interpolation
@@ -119,7 +129,7 @@ Image scaleLin(const Image &im, float factor){
     return im2;
 }
 
-Image scaleBicubic(const Image &im, float factor, float B, float C) {
+Image scaleBicubic(const ImageView &im, float factor, float B, float C) {
     // --------- HANDOUT  PS05 ------------------------------
     // create a new image that is factor times bigger than the input by using
     // a bicubic filter kernel with Mitchell and Netravali's parametrization
@@ -178,7 +188,7 @@ Image scaleBicubic(const Image &im, float factor, float B, float C) {
 
 }
 
-Image scaleLanczos(const Image &im, float factor, float a) {
+Image scaleLanczos(const ImageView &im, float factor, float a) {
     // --------- HANDOUT  PS05 ------------------------------
     // create a new image that is factor times bigger than the input by using
     // a Lanczos filter kernel
@@ -221,7 +231,7 @@ Image scaleLanczos(const Image &im, float factor, float a) {
     return out;
 }
 
-Image rotate(const Image &im, float theta) {
+Image rotate(const ImageView &im, float theta) {
     // --------- HANDOUT  PS05 ------------------------------
     // rotate an image around its center by theta
 
@@ -242,17 +252,18 @@ Image rotate(const Image &im, float theta) {
 
     // For each pixel in the output
     float yR, xR; // rotated coordinates
-    for (int x=0; x<im.width(); x++)
+    float cosT = cos(theta), sinT = sin(theta);
     for (int y=0; y<im.height(); y++)
-    for (int z=0; z<im.channels(); z++)
+    for (int x=0; x<im.width(); x++)
     {
 
         // compute the x and y values from the original image
-        xR = (static_cast<float>(x) - centerX)*cos(theta) + (centerY - static_cast<float>(y))*sin(theta) + centerX;
-        yR = centerY - ( -(static_cast<float>(x) - centerX)*sin(theta) + (centerY - static_cast<float>(y))*cos(theta) );
+        xR = (static_cast<float>(x) - centerX)*cosT + (centerY - static_cast<float>(y))*sinT + centerX;
+        yR = centerY - ( -(static_cast<float>(x) - centerX)*sinT + (centerY - static_cast<float>(y))*cosT );
 
         // interpolate the point
-        imR(x,y,z) = interpolateLin(im, xR, yR, z);
+        for (int z=0; z<im.channels(); z++)
+            imR.at(x,y,z) = interpolateLin(im, xR, yR, z);
     }
 
     return imR;
@@ -269,7 +280,7 @@ Image rotate(const Image &im, float theta) {
 // const Image & means a reference to im will get passed to the function,
 // but the compiler won't let you modify it within the function.
 // So you will return a new image
-Image brightness(const Image &im, float factor) {
+Image brightness(const ImageView &im, float factor) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Image output(im.width(), im.height(), im.channels());
     // // Modify image brightness
@@ -280,7 +291,7 @@ Image brightness(const Image &im, float factor) {
     return im * factor;
 }
 
-Image contrast(const Image &im, float factor, float midpoint) {
+Image contrast(const ImageView &im, float factor, float midpoint) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Image output(im.width(), im.height(), im.channels());
     // // Modify image contrast
@@ -291,17 +302,22 @@ Image contrast(const Image &im, float factor, float midpoint) {
     return (im - midpoint) * factor + midpoint;
 }
 
-Image color2gray(const Image &im, const std::vector<float> &weights) {
+Image color2gray(const ImageView &im, const std::vector<float> &weights) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Image output(im.width(), im.height(), 1);
     // // Convert to grayscale
     // return Image(1,1,1); //Change this
 
     // --------- SOLUTION PS01 ------------------------------
+    if (im.channels() < 3)
+        throw OutOfBoundsException();
     Image output(im.width(), im.height(), 1);
-    for (int i = 0 ; i < im.width(); i++ ) {
-        for (int j = 0 ; j < im.height(); j++ ) {
-            output(i,j,0) = im(i,j,0) * weights[0] + im(i,j,1) * weights[1] + im(i,j,2) *weights[2];
+    int s = im.stride(2);
+    for (int j = 0 ; j < im.height(); j++ ) {
+        float *out = output.row(j);
+        for (int i = 0 ; i < im.width(); i++ ) {
+            const float *in = im.pixel(i, j);
+            out[i] = in[0] * weights[0] + in[s] * weights[1] + in[2 * s] *weights[2];
         }
     }
     return output;
@@ -309,7 +325,7 @@ Image color2gray(const Image &im, const std::vector<float> &weights) {
 
 // For this function, we want two outputs, a single channel luminance image
 // and a three channel chrominance image. Return them in a vector with luminance first
-std::vector<Image> lumiChromi(const Image &im) {
+std::vector<Image> lumiChromi(const ImageView &im) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Create the luminance image
     // // Create the chrominance image
@@ -321,13 +337,13 @@ std::vector<Image> lumiChromi(const Image &im) {
     // Create the luminance
     Image im_luminance = color2gray(im);
 
-    // Create chrominance images
-    // We copy the input as starting point for the chrominance
-    Image im_chrominance = im;
+    // Create chrominance images, the input divided by the luminance
+    Image im_chrominance(im.width(), im.height(), im.channels(), im.layout());
     for (int c = 0 ; c < im.channels(); c++ ) {
         for (int y = 0 ; y < im.height(); y++) {
+            const float *lumi = im_luminance.row(y);
             for (int x = 0 ; x < im.width(); x++) {
-                im_chrominance(x,y,c) = im_chrominance(x,y,c) / im_luminance(x,y);
+                im_chrominance.at(x, y, c) = im.at(x, y, c) / lumi[x];
             }
         }
     }
@@ -383,39 +399,50 @@ Image brightnessContrastLumi(const Image &im, float brightF, float contrastF, fl
 }
 
 
-Image rgb2yuv(const Image &im) {
+Image rgb2yuv(const ImageView &im) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Create output image of appropriate size
     // // Change colorspace
     // return Image(1,1,1); // Change this
 
     // --------- SOLUTION PS01 ------------------------------
-    Image output(im.width(), im.height(), im.channels());
+    // per pixel, in the layout of im: channels are stride(2) apart
+    if (im.channels() < 3)
+        throw OutOfBoundsException();
+    Image output(im.width(), im.height(), im.channels(), im.layout());
+    int s = im.stride(2);
     for (int j = 0 ; j < im.height(); j++) {
         for (int i = 0 ; i < im.width(); i++) {
-            output(i,j,0) =   0.299 * im(i,j,0) + 0.587 * im(i,j,1) + 0.114 * im(i,j,2);
-            output(i,j,1) = - 0.147 * im(i,j,0) - 0.289 * im(i,j,1) + 0.436 * im(i,j,2);
-            output(i,j,2) =   0.615 * im(i,j,0) - 0.515 * im(i,j,1) - 0.100 * im(i,j,2);
+            const float *in = im.pixel(i, j);
+            float *out = output.pixel(i, j);
+            out[0]     =   0.299 * in[0] + 0.587 * in[s] + 0.114 * in[2 * s];
+            out[s]     = - 0.147 * in[0] - 0.289 * in[s] + 0.436 * in[2 * s];
+            out[2 * s] =   0.615 * in[0] - 0.515 * in[s] - 0.100 * in[2 * s];
         }
     }
     return output;
 }
 
 
-Image yuv2rgb(const Image &im) {
+Image yuv2rgb(const ImageView &im) {
     // // --------- HANDOUT  PS01 ------------------------------
     // // Create output image of appropriate size
     // // Change colorspace
     // return Image(1,1,1); // Change this
 
     // --------- SOLUTION PS01 ------------------------------
-    Image output(im.width(), im.height(), im.channels());
+    if (im.channels() < 3)
+        throw OutOfBoundsException();
+    Image output(im.width(), im.height(), im.channels(), im.layout());
+    int s = im.stride(2);
     for (int j = 0 ; j < im.height(); j++) {
         for (int i = 0; i < im.width(); i++)
         {
-            output(i,j,0) =  im(i,j,0) + 0     * im(i,j,1) + 1.14  * im(i,j,2);
-            output(i,j,1) =  im(i,j,0) - 0.395 * im(i,j,1) - 0.581 * im(i,j,2);
-            output(i,j,2) =  im(i,j,0) + 2.032 * im(i,j,1) + 0     * im(i,j,2);
+            const float *in = im.pixel(i, j);
+            float *out = output.pixel(i, j);
+            out[0]     =  in[0] + 0     * in[s] + 1.14  * in[2 * s];
+            out[s]     =  in[0] - 0.395 * in[s] - 0.581 * in[2 * s];
+            out[2 * s] =  in[0] + 2.032 * in[s] + 0     * in[2 * s];
         }
     }
     return output;
@@ -536,3 +563,8 @@ Image gamma_code(const Image &im, float gamma) {
 
 // -----------------------------------------------------
 // --------- END --- PS01 ------------------------------
+
+
+Image crop(const ImageView &im, int x0, int y0, int w, int h) {
+    return Image(im.crop(x0, y0, w, h));
+}
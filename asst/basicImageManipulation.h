@@ -17,19 +17,22 @@
 
 using namespace std;
 
+// Functions taking a const ImageView & also run on crops and single
+// channels of an image without copying them (see Image.h)
+
 // --------- HANDOUT PS01 ------------------------------
-Image brightness(const Image &im, float factor);
-Image contrast(const Image &im, float factor, float midpoint = 0.5);
+Image brightness(const ImageView &im, float factor);
+Image contrast(const ImageView &im, float factor, float midpoint = 0.5);
 
-Image color2gray(const Image &im,
+Image color2gray(const ImageView &im,
                  const std::vector<float> &weights = std::vector<float>{0.299, 0.587, 0.114});
 
-std::vector<Image> lumiChromi(const Image &im);
+std::vector<Image> lumiChromi(const ImageView &im);
 Image lumiChromi2rgb(const vector<Image> & lc);
 Image brightnessContrastLumi(const Image &im,
         float brightF, float contrastF, float midpoint = 0.3);
-Image rgb2yuv(const Image &im);
-Image yuv2rgb(const Image &im);
+Image rgb2yuv(const ImageView &im);
+Image yuv2rgb(const ImageView &im);
 Image saturate(const Image &im, float k);
 std::vector<Image> spanish(const Image &im);
 Image grayworld(const Image & in);
@@ -37,12 +40,16 @@ Image gamma_code(const Image &im, float gamma);
 // ------------------------------------------------------
 
 // --------- HANDOUT PS05 ------------------------------
-Image scaleNN(const Image &im, float factor);
-float interpolateLin(const Image &im, float x, float y, int z, bool clamp=false);
-Image scaleLin(const Image &im, float factor);
-Image scaleBicubic(const Image &im, float factor, float B, float C);
-Image scaleLanczos(const Image &im, float factor, float a);
-Image rotate(const Image &im, float theta);
+Image scaleNN(const ImageView &im, float factor);
+float interpolateLin(const ImageView &im, float x, float y, int z, bool clamp=false);
+Image scaleLin(const ImageView &im, float factor);
+Image scaleBicubic(const ImageView &im, float factor, float B, float C);
+Image scaleLanczos(const ImageView &im, float factor, float a);
+Image rotate(const ImageView &im, float theta);
 // ------------------------------------------------------
 
+// Copy of the w x h rectangle of im whose top left corner is (x0, y0);
+// im.crop(x0, y0, w, h) is the same rectangle without the copy
+Image crop(const ImageView &im, int x0, int y0, int w, int h);
+
 #endif
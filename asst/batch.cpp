@@ -0,0 +1,220 @@
+/* --------------------------------------------------------------------------
+ * File:    batch.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Batch rendering of a manifest of paint jobs on a pool of workers
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "batch.h"
+#include "a10.h"
+#include "parallel.h"
+#include "strokeRasterizer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+const char * const styles[] = {"painterly", "oriented", "lightToDark", "darkToLight", "multiScale"};
+
+bool knownStyle(const string &style) {
+    for (size_t i = 0; i < sizeof(styles) / sizeof(styles[0]); ++i)
+        if (style == styles[i])
+            return true;
+    return false;
+}
+
+// value if it was given in the manifest, the default otherwise
+int pick(int value, int fallback) { return value >= 0 ? value : fallback; }
+float pick(float value, float fallback) { return value >= 0.0f ? value : fallback; }
+
+StrokePlan jobPlan(const BatchJob &job, const PaintAnalysis &analysis) {
+    int size = pick(job.size, 50);
+    float noise = pick(job.noise, 0.3f);
+    if (job.coverage >= 0.0f && job.style == "painterly")
+        return painterlyPlan(analysis, CoverageTarget(job.coverage), size, noise, job.seed);
+    if (job.coverage >= 0.0f && job.style == "oriented")
+        return orientedPaintPlan(analysis, CoverageTarget(job.coverage), size, noise, job.seed);
+    if (job.style == "painterly")
+        return painterlyPlan(analysis, pick(job.strokes, 10000), size, noise, job.seed);
+    if (job.style == "oriented")
+        return orientedPaintPlan(analysis, pick(job.strokes, 7000), size, noise, job.seed);
+    if (job.style == "lightToDark")
+        return lightToDarkPlan(analysis, pick(job.strokes, 1000), size, noise, job.seed);
+    if (job.style == "darkToLight")
+        return darkToLightPlan(analysis, pick(job.strokes, 10000), size, noise, job.seed);
+    if (job.style == "multiScale")
+        return multiScaleOrientedPlan(analysis, pick(job.strokes, 7000), size, noise,
+                                      pick(job.numScales, 2), job.seed);
+    throw InvalidArgument();
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// The decode and PaintAnalysis of one input, made by the first of its jobs
+// to run (the others wait for it) and dropped once the last one is done
+struct BatchInput {
+    once_flag decoded;
+    shared_ptr<const Image> im;
+    shared_ptr<const PaintAnalysis> analysis;
+    atomic<int> pending;
+};
+
+}
+
+BatchJob::BatchJob()
+  : brush("./Input/brush.png"), strokes(-1), size(-1), noise(-1.0f), seed(0), numScales(-1),
+    coverage(-1.0f)
+{}
+
+vector<BatchJob> readManifest(const string &filename) {
+    ifstream in(filename.c_str());
+    if (!in)
+        throw FileNotFoundException();
+
+    vector<BatchJob> jobs;
+    string line;
+    for (int number = 1; getline(in, line); ++number) {
+        istringstream tokens(line);
+        BatchJob job;
+        if (!(tokens >> job.input) || job.input[0] == '#')
+            continue;
+
+        ostringstream where;
+        where << filename << ":" << number << ": ";
+        if (!(tokens >> job.style >> job.output))
+            throw runtime_error(where.str() + "expected <input> <style> <output>");
+        if (!knownStyle(job.style))
+            throw runtime_error(where.str() + "unknown style " + job.style);
+
+        string option;
+        while (tokens >> option) {
+            size_t eq = option.find('=');
+            string key = option.substr(0, eq);
+            string value = eq == string::npos ? "" : option.substr(eq + 1);
+            const char *begin = value.c_str();
+            char *end = nullptr;
+            bool valid = !value.empty();
+            if (key == "brush") {
+                job.brush = value;
+            } else if (key == "noise") {
+                job.noise = strtof(begin, &end);
+                valid = valid && *end == '\0' && job.noise >= 0.0f;
+            } else if (key == "coverage") {
+                job.coverage = strtof(begin, &end);
+                valid = valid && *end == '\0' && job.coverage > 0.0f && job.coverage < 1.0f;
+                if (valid && job.style != "painterly" && job.style != "oriented")
+                    throw runtime_error(where.str() + "coverage needs the painterly or oriented style");
+            } else if (key == "strokes" || key == "size" || key == "seed" || key == "scales") {
+                long n = strtol(begin, &end, 10);
+                valid = valid && *end == '\0' && n >= 0;
+                if (key == "strokes")    job.strokes = static_cast<int>(n);
+                else if (key == "size")  job.size = static_cast<int>(n);
+                else if (key == "seed")  job.seed = static_cast<unsigned int>(n);
+                else                     job.numScales = static_cast<int>(n);
+            } else {
+                throw runtime_error(where.str() + "unknown option " + key);
+            }
+            if (!valid)
+                throw runtime_error(where.str() + "bad value for " + key);
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+const Image & BrushLibrary::get(const string &filename) {
+    lock_guard<mutex> lock(brushes_mutex);
+    unique_ptr<Image> &brush = brushes[filename];
+    if (!brush)
+        brush.reset(new Image(filename));
+    return *brush;
+}
+
+BatchReport runBatch(const vector<BatchJob> &jobs, int numWorkers, ostream *log) {
+    auto start = chrono::steady_clock::now();
+
+    // jobs grouped by input, in manifest order
+    vector<vector<int>> groups;
+    map<string, int> group_of;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        auto found = group_of.insert(make_pair(jobs[j].input, static_cast<int>(groups.size())));
+        if (found.second)
+            groups.push_back(vector<int>());
+        groups[found.first->second].push_back(static_cast<int>(j));
+    }
+
+    // Jobs are handed to the workers one at a time, the first job of every
+    // input before the second of any, so that the workers start on distinct
+    // inputs rather than wait for the same decode
+    vector<shared_ptr<BatchInput>> inputs(groups.size());
+    vector<int> order, input_of(jobs.size());
+    for (size_t g = 0; g < groups.size(); ++g) {
+        inputs[g] = make_shared<BatchInput>();
+        inputs[g]->pending = static_cast<int>(groups[g].size());
+        for (size_t k = 0; k < groups[g].size(); ++k)
+            input_of[groups[g][k]] = static_cast<int>(g);
+    }
+    for (size_t k = 0; order.size() < jobs.size(); ++k)
+        for (size_t g = 0; g < groups.size(); ++g)
+            if (k < groups[g].size())
+                order.push_back(groups[g][k]);
+
+    BrushLibrary brushes;
+    atomic<int> images(0), failures(0);
+    mutex log_mutex;
+    auto report = [&](const BatchJob &job, int strokes, double seconds, const char *error) {
+        if (!log)
+            return;
+        lock_guard<mutex> lock(log_mutex);
+        int done = images + failures;
+        *log << "[" << done << "/" << jobs.size() << "] " << job.output;
+        if (error)
+            *log << " FAILED: " << error << endl;
+        else
+            *log << " (" << job.style << ") " << strokes << " strokes, " << seconds << "s" << endl;
+    };
+
+    parallelFor(0, static_cast<int>(order.size()), [&](int k) {
+        const BatchJob &job = jobs[order[k]];
+        shared_ptr<BatchInput> input = inputs[input_of[order[k]]];
+        auto job_start = chrono::steady_clock::now();
+        try {
+            // a failed decode leaves the flag unset: the next job tries again
+            call_once(input->decoded, [&]() {
+                shared_ptr<const Image> im = make_shared<Image>(job.input);
+                input->analysis = make_shared<PaintAnalysis>(*im);
+                input->im = im;
+            });
+            StrokePlan plan = jobPlan(job, *input->analysis);
+            Image out = renderStrokePlan(plan, brushes.get(job.brush));
+            out.write(job.output);
+            ++images;
+            report(job, plan.count(), secondsSince(job_start), nullptr);
+        } catch (const exception &e) {
+            ++failures;
+            report(job, 0, 0.0, e.what());
+        }
+        if (--input->pending == 0) {
+            input->analysis.reset();
+            input->im.reset();
+        }
+    }, numWorkers);
+
+    BatchReport result;
+    result.images = images;
+    result.failures = failures;
+    result.seconds = secondsSince(start);
+    return result;
+}
@@ -0,0 +1,80 @@
+/* --------------------------------------------------------------------------
+ * File:    batch.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Batch rendering of a manifest of paint jobs on a pool of workers
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __batch__h
+#define __batch__h
+
+#include "Image.h"
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One image to paint. strokes, size, noise and numScales left at -1 take the
+// default of the style's paint function in a10.h (those of orientedPaint for
+// multiScale, which has none).
+struct BatchJob {
+    BatchJob();
+
+    std::string input;
+    std::string style;     // painterly, oriented, lightToDark, darkToLight or multiScale
+    std::string output;
+    std::string brush;     // brush texture, ./Input/brush.png by default
+    int strokes;
+    int size;
+    float noise;
+    unsigned int seed;
+    int numScales;         // multiScale only
+    float coverage;        // painterly and oriented: draw until covered instead of strokes
+};
+
+// Reads a manifest: one job per line,
+//
+//   <input> <style> <output> [brush=<png>] [strokes=<n>] [size=<n>]
+//                            [noise=<x>] [seed=<n>] [scales=<n>]
+//                            [coverage=<x>]
+//
+// Blank lines and lines starting with # are skipped. Throws
+// FileNotFoundException if the file cannot be opened and runtime_error, with
+// the line number, on a malformed line.
+std::vector<BatchJob> readManifest(const std::string &filename);
+
+// The brush textures of a batch, each decoded once the first time a job asks
+// for it. Safe to share between threads.
+class BrushLibrary {
+public:
+    const Image & get(const std::string &filename);
+
+private:
+    std::mutex brushes_mutex;
+    std::map<std::string, std::unique_ptr<Image>> brushes;
+};
+
+struct BatchReport {
+    int images;      // written successfully
+    int failures;
+    double seconds;
+
+    double imagesPerMinute() const { return seconds > 0.0 ? 60.0 * images / seconds : 0.0; }
+};
+
+// Paints every job and writes it to its output. The jobs are spread over
+// numWorkers workers (0 means one per core), each job on one worker. Jobs
+// that share an input share a single decode and PaintAnalysis of it, made
+// by the first of them to run. Each job is logged with the number of
+// strokes drawn. A job that fails is reported on log and counted, and does
+// not stop the others. Pass a null log for silence.
+BatchReport runBatch(const std::vector<BatchJob> &jobs,
+                     int numWorkers = 0,
+                     std::ostream *log = &std::cout);
+
+#endif
@@ -0,0 +1,29 @@
+#include <iostream>
+#include <cstdlib>
+#include "batch.h"
+
+using namespace std;
+
+// Usage: ./batch <manifest> [workers]
+// Paints every job of the manifest (see readManifest in batch.h) and prints
+// the throughput. Exits with 1 if any job failed.
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 3) {
+    cerr << "usage: " << argv[0] << " <manifest> [workers]" << endl;
+    return 2;
+  }
+  int workers = argc == 3 ? atoi(argv[2]) : 0;
+
+  try {
+    vector<BatchJob> jobs = readManifest(argv[1]);
+    BatchReport report = runBatch(jobs, workers);
+    cout << report.images << " images in " << report.seconds << "s ("
+         << report.imagesPerMinute() << " images/minute), "
+         << report.failures << " failed" << endl;
+    return report.failures > 0 ? 1 : 0;
+  } catch (const exception &e) {
+    cerr << argv[1] << ": " << e.what() << endl;
+    return 2;
+  }
+}
@@ -0,0 +1,498 @@
+/* --------------------------------------------------------------------------
+ * File:    blendKernel.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Vectorized row kernel for compositing brush opacity onto a planar canvas
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "blendKernel.h"
+#include "Image.h"
+#include "ImageException.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BLEND_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void blendRowScalar(float * const planes[], int channels, const float *opacity,
+                    const float color[], int begin, int n)
+{
+    for (int c = 0; c < channels; ++c) {
+        float *dst = planes[c];
+        float col = color[c];
+        for (int i = begin; i < n; ++i)
+            dst[i] = opacity[i] * col + (1.0f - opacity[i]) * dst[i];
+    }
+}
+
+// The 16 bit blend is written as
+//     out = (out * (one - a) + color * a + half) >> shift
+// which only has unsigned products; with Q15 opacities and 16 bit values
+// they need 32 bits. The 8 bit blend works on values scaled by 128, whose
+// differences fit 16 bits signed:
+//     out += ((color - out) * a + 2^14) >> 15
+// with a at most 2^15 - 1, so a full opacity moves out by all but a
+// 1/32768th of the difference, which rounds to the whole of it.
+void blendRowFixed8Scalar(int16_t * const planes[3], const uint16_t *opacity,
+                          const int16_t color[3], int begin, int n)
+{
+    for (int c = 0; c < 3; ++c) {
+        int16_t *dst = planes[c];
+        for (int i = begin; i < n; ++i) {
+            int a = opacity[i] - (opacity[i] >> 15);
+            dst[i] = static_cast<int16_t>(dst[i] + (((color[c] - dst[i]) * a + (1 << 14)) >> 15));
+        }
+    }
+}
+
+void blendRowFixed16Scalar(uint16_t * const planes[3], const uint16_t *opacity,
+                           const uint16_t color[3], int begin, int n)
+{
+    for (int c = 0; c < 3; ++c) {
+        uint16_t *dst = planes[c];
+        for (int i = begin; i < n; ++i) {
+            uint32_t a = opacity[i];
+            dst[i] = static_cast<uint16_t>((dst[i] * ((1u << 15) - a) + color[c] * a + (1u << 14)) >> 15);
+        }
+    }
+}
+
+#ifdef BLEND_HAVE_X86
+__attribute__((target("sse2")))
+void blendRowSSE(float * const planes[], int channels, const float *opacity,
+                 const float color[], int n)
+{
+    int m = n & ~3;
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (int c = 0; c < channels; ++c) {
+        float *dst = planes[c];
+        __m128 col = _mm_set1_ps(color[c]);
+        for (int i = 0; i < m; i += 4) {
+            __m128 o = _mm_loadu_ps(opacity + i);
+            __m128 d = _mm_loadu_ps(dst + i);
+            d = _mm_add_ps(_mm_mul_ps(o, col), _mm_mul_ps(_mm_sub_ps(one, o), d));
+            _mm_storeu_ps(dst + i, d);
+        }
+    }
+    blendRowScalar(planes, channels, opacity, color, m, n);
+}
+
+__attribute__((target("avx2")))
+void blendRowAVX2(float * const planes[], int channels, const float *opacity,
+                  const float color[], int n)
+{
+    int m = n & ~7;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (int c = 0; c < channels; ++c) {
+        float *dst = planes[c];
+        __m256 col = _mm256_set1_ps(color[c]);
+        for (int i = 0; i < m; i += 8) {
+            __m256 o = _mm256_loadu_ps(opacity + i);
+            __m256 d = _mm256_loadu_ps(dst + i);
+            d = _mm256_add_ps(_mm256_mul_ps(o, col), _mm256_mul_ps(_mm256_sub_ps(one, o), d));
+            _mm256_storeu_ps(dst + i, d);
+        }
+    }
+    blendRowScalar(planes, channels, opacity, color, m, n);
+}
+#endif
+
+#ifdef BLEND_HAVE_X86
+// 8 texels of Q15 opacity, full opacity lowered to 2^15 - 1
+__attribute__((target("sse2")))
+inline __m128i opacityBelowOne(const uint16_t *opacity) {
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i *>(opacity));
+    return _mm_sub_epi16(o, _mm_srli_epi16(o, 15));
+}
+
+// d + ((col - d) * a + 2^14) >> 15 on 8 texels of 16 bit lanes, the
+// rounded product of _mm_mulhrs_epi16 (SSSE3) from its SSE2 halves
+__attribute__((target("sse2")))
+inline __m128i blendScaled8(__m128i d, __m128i col, __m128i a) {
+    __m128i diff = _mm_sub_epi16(col, d);
+    __m128i hi = _mm_mulhi_epi16(diff, a), lo = _mm_mullo_epi16(diff, a);
+    __m128i shifted = _mm_add_epi16(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+    __m128i round = _mm_srli_epi16(_mm_slli_epi16(lo, 1), 15);
+    return _mm_add_epi16(d, _mm_add_epi16(shifted, round));
+}
+
+__attribute__((target("sse2")))
+void blendRowFixed8SSE(int16_t * const planes[3], const uint16_t *opacity,
+                       const int16_t color[3], int n)
+{
+    int m = n & ~7;
+    for (int i = 0; i < m; i += 8) {
+        __m128i a = opacityBelowOne(opacity + i);
+        for (int c = 0; c < 3; ++c) {
+            __m128i *p = reinterpret_cast<__m128i *>(planes[c] + i);
+            _mm_storeu_si128(p, blendScaled8(_mm_loadu_si128(p), _mm_set1_epi16(color[c]), a));
+        }
+    }
+    blendRowFixed8Scalar(planes, opacity, color, m, n);
+}
+
+__attribute__((target("avx2")))
+void blendRowFixed8AVX2(int16_t * const planes[3], const uint16_t *opacity,
+                        const int16_t color[3], int n)
+{
+    int m = n & ~15;
+    for (int i = 0; i < m; i += 16) {
+        __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(opacity + i));
+        __m256i a = _mm256_sub_epi16(o, _mm256_srli_epi16(o, 15));
+        for (int c = 0; c < 3; ++c) {
+            __m256i *p = reinterpret_cast<__m256i *>(planes[c] + i);
+            __m256i d = _mm256_loadu_si256(p);
+            __m256i diff = _mm256_sub_epi16(_mm256_set1_epi16(color[c]), d);
+            _mm256_storeu_si256(p, _mm256_add_epi16(d, _mm256_mulhrs_epi16(diff, a)));
+        }
+    }
+    // brush rows are short: finish with 8 texels at a time when we can
+    if (n - m >= 8) {
+        __m128i a = opacityBelowOne(opacity + m);
+        for (int c = 0; c < 3; ++c) {
+            __m128i *p = reinterpret_cast<__m128i *>(planes[c] + m);
+            _mm_storeu_si128(p, blendScaled8(_mm_loadu_si128(p), _mm_set1_epi16(color[c]), a));
+        }
+        m += 8;
+    }
+    blendRowFixed8Scalar(planes, opacity, color, m, n);
+}
+
+// (d * keep + col * a + 2^14) >> 15 on 8 texels of 16 bit lanes, with the
+// products assembled in 32 bits from their low and high halves
+__attribute__((target("sse2")))
+inline __m128i blendQ15(__m128i d, __m128i col, __m128i a, __m128i keep) {
+    __m128i dk_lo = _mm_mullo_epi16(d, keep), dk_hi = _mm_mulhi_epu16(d, keep);
+    __m128i ca_lo = _mm_mullo_epi16(col, a), ca_hi = _mm_mulhi_epu16(col, a);
+    const __m128i half = _mm_set1_epi32(1 << 14);
+    __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(dk_lo, dk_hi),
+                                             _mm_unpacklo_epi16(ca_lo, ca_hi)), half);
+    __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(dk_lo, dk_hi),
+                                             _mm_unpackhi_epi16(ca_lo, ca_hi)), half);
+    lo = _mm_srli_epi32(lo, 15);
+    hi = _mm_srli_epi32(hi, 15);
+    // no unsigned 32 -> 16 bit pack before SSE4.1: shift to signed and back
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32)), bias16);
+}
+
+__attribute__((target("sse2")))
+void blendRowFixed16SSE(uint16_t * const planes[3], const uint16_t *opacity,
+                        const uint16_t color[3], int n)
+{
+    int m = n & ~7;
+    for (int i = 0; i < m; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(opacity + i));
+        __m128i keep = _mm_sub_epi16(_mm_set1_epi16(static_cast<short>(1 << 15)), a);
+        for (int c = 0; c < 3; ++c) {
+            __m128i *p = reinterpret_cast<__m128i *>(planes[c] + i);
+            __m128i d = blendQ15(_mm_loadu_si128(p), _mm_set1_epi16(static_cast<short>(color[c])), a, keep);
+            _mm_storeu_si128(p, d);
+        }
+    }
+    blendRowFixed16Scalar(planes, opacity, color, m, n);
+}
+
+__attribute__((target("avx2")))
+void blendRowFixed16AVX2(uint16_t * const planes[3], const uint16_t *opacity,
+                         const uint16_t color[3], int n)
+{
+    int m = n & ~7;
+    for (int i = 0; i < m; i += 8) {
+        __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(opacity + i)));
+        __m256i keep = _mm256_sub_epi32(_mm256_set1_epi32(1 << 15), a);
+        for (int c = 0; c < 3; ++c) {
+            __m128i *p = reinterpret_cast<__m128i *>(planes[c] + i);
+            __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128(p));
+            __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(d, keep),
+                                           _mm256_mullo_epi32(_mm256_set1_epi32(color[c]), a));
+            d = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << 14)), 15);
+            _mm_storeu_si128(p, _mm_packus_epi32(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1)));
+        }
+    }
+    blendRowFixed16Scalar(planes, opacity, color, m, n);
+}
+#endif
+
+// "under" blend of one brush row, see underRow() in blendKernel.h
+int underRowScalar(float * const planes[3], float *transmittance, const float *opacity,
+                   const float color[3], float saturation, int begin, int n)
+{
+    int crossed = 0;
+    for (int i = begin; i < n; ++i) {
+        float t = transmittance[i];
+        if (!(t > saturation))
+            continue;
+        float o = opacity[i];
+        float to = t * o;
+        planes[0][i] += to * color[0];
+        planes[1][i] += to * color[1];
+        planes[2][i] += to * color[2];
+        float next = t * (1.0f - o);
+        crossed |= next <= saturation;
+        transmittance[i] = next;
+    }
+    return crossed;
+}
+
+#ifdef BLEND_HAVE_X86
+__attribute__((target("sse2")))
+int underRowSSE(float * const planes[3], float *transmittance, const float *opacity,
+                const float color[3], float saturation, int n)
+{
+    int m = n & ~3;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sat = _mm_set1_ps(saturation);
+    __m128 crossed = _mm_setzero_ps();
+    for (int i = 0; i < m; i += 4) {
+        __m128 t = _mm_loadu_ps(transmittance + i);
+        __m128 open = _mm_cmpgt_ps(t, sat);
+        __m128 o = _mm_and_ps(open, _mm_loadu_ps(opacity + i));
+        __m128 to = _mm_mul_ps(t, o);
+        for (int c = 0; c < 3; ++c) {
+            float *dst = planes[c] + i;
+            _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(to, _mm_set1_ps(color[c]))));
+        }
+        __m128 next = _mm_mul_ps(t, _mm_sub_ps(one, o));
+        crossed = _mm_or_ps(crossed, _mm_and_ps(open, _mm_cmple_ps(next, sat)));
+        _mm_storeu_ps(transmittance + i, next);
+    }
+    return _mm_movemask_ps(crossed) | underRowScalar(planes, transmittance, opacity, color, saturation, m, n);
+}
+
+__attribute__((target("avx2")))
+int underRowAVX2(float * const planes[3], float *transmittance, const float *opacity,
+                 const float color[3], float saturation, int n)
+{
+    int m = n & ~7;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sat = _mm256_set1_ps(saturation);
+    __m256 crossed = _mm256_setzero_ps();
+    for (int i = 0; i < m; i += 8) {
+        __m256 t = _mm256_loadu_ps(transmittance + i);
+        __m256 open = _mm256_cmp_ps(t, sat, _CMP_GT_OQ);
+        __m256 o = _mm256_and_ps(open, _mm256_loadu_ps(opacity + i));
+        __m256 to = _mm256_mul_ps(t, o);
+        for (int c = 0; c < 3; ++c) {
+            float *dst = planes[c] + i;
+            _mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), _mm256_mul_ps(to, _mm256_set1_ps(color[c]))));
+        }
+        __m256 next = _mm256_mul_ps(t, _mm256_sub_ps(one, o));
+        crossed = _mm256_or_ps(crossed, _mm256_and_ps(open, _mm256_cmp_ps(next, sat, _CMP_LE_OQ)));
+        _mm256_storeu_ps(transmittance + i, next);
+    }
+    return _mm256_movemask_ps(crossed) | underRowScalar(planes, transmittance, opacity, color, saturation, m, n);
+}
+
+// blendPixels of 3 adjacent channels, 4 pixels (12 values) per step, the
+// opacities spread over the channels by shuffles. Returns the number of
+// pixels done.
+__attribute__((target("sse2")))
+int blendRGBSSE(float *pixels, const float *opacity, const float color[3], int n)
+{
+    int m = n & ~3;
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 c0 = _mm_setr_ps(color[0], color[1], color[2], color[0]);
+    const __m128 c1 = _mm_setr_ps(color[1], color[2], color[0], color[1]);
+    const __m128 c2 = _mm_setr_ps(color[2], color[0], color[1], color[2]);
+    for (int i = 0; i < m; i += 4) {
+        __m128 o = _mm_loadu_ps(opacity + i);
+        __m128 o0 = _mm_shuffle_ps(o, o, _MM_SHUFFLE(1, 0, 0, 0));
+        __m128 o1 = _mm_shuffle_ps(o, o, _MM_SHUFFLE(2, 2, 1, 1));
+        __m128 o2 = _mm_shuffle_ps(o, o, _MM_SHUFFLE(3, 3, 3, 2));
+        float *p = pixels + 3 * i;
+        __m128 d0 = _mm_loadu_ps(p), d1 = _mm_loadu_ps(p + 4), d2 = _mm_loadu_ps(p + 8);
+        d0 = _mm_add_ps(_mm_mul_ps(o0, c0), _mm_mul_ps(_mm_sub_ps(one, o0), d0));
+        d1 = _mm_add_ps(_mm_mul_ps(o1, c1), _mm_mul_ps(_mm_sub_ps(one, o1), d1));
+        d2 = _mm_add_ps(_mm_mul_ps(o2, c2), _mm_mul_ps(_mm_sub_ps(one, o2), d2));
+        _mm_storeu_ps(p, d0);
+        _mm_storeu_ps(p + 4, d1);
+        _mm_storeu_ps(p + 8, d2);
+    }
+    return m;
+}
+#endif
+
+BlendKernel detectBlendKernel() {
+#ifdef BLEND_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return BLEND_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return BLEND_SSE;
+#endif
+    return BLEND_SCALAR;
+}
+
+}
+
+BlendKernel bestBlendKernel() {
+    static const BlendKernel best = detectBlendKernel();
+    return best;
+}
+
+const char * blendKernelName(BlendKernel kernel) {
+    switch (kernel) {
+    case BLEND_SCALAR: return "scalar";
+    case BLEND_SSE:    return "sse";
+    case BLEND_AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+void blendRow(float * const planes[],
+              int channels,
+              const float *opacity,
+              const float color[],
+              int n,
+              BlendKernel kernel)
+{
+    if (kernel > bestBlendKernel())
+        throw InvalidArgument();
+    if (n <= 0)
+        return;
+
+    switch (kernel) {
+#ifdef BLEND_HAVE_X86
+    case BLEND_AVX2:
+        blendRowAVX2(planes, channels, opacity, color, n);
+        return;
+    case BLEND_SSE:
+        blendRowSSE(planes, channels, opacity, color, n);
+        return;
+#endif
+    default:
+        blendRowScalar(planes, channels, opacity, color, 0, n);
+    }
+}
+
+void blendPixels(float *pixels,
+                 int stride,
+                 int channels,
+                 const float *opacity,
+                 const float color[],
+                 int n)
+{
+    if (channels == 3) {
+        float r = color[0], g = color[1], b = color[2];
+        int i = 0;
+#ifdef BLEND_HAVE_X86
+        if (stride == 3)
+            i = blendRGBSSE(pixels, opacity, color, n);
+#endif
+        for (; i < n; ++i) {
+            float *p = pixels + static_cast<size_t>(i) * stride;
+            float a = opacity[i], keep = 1.0f - a;
+            p[0] = a * r + keep * p[0];
+            p[1] = a * g + keep * p[1];
+            p[2] = a * b + keep * p[2];
+        }
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        float *p = pixels + static_cast<size_t>(i) * stride;
+        for (int c = 0; c < channels; ++c)
+            p[c] = opacity[i] * color[c] + (1.0f - opacity[i]) * p[c];
+    }
+}
+
+void blendImageRow(Image &im,
+                   int x,
+                   int y,
+                   const float *opacity,
+                   const float color[],
+                   int n)
+{
+    int channels = std::min(im.channels(), 3);
+    if (n <= 0 || channels <= 0)
+        return;
+    if (im.stride(0) != 1) {
+        blendPixels(im.pixel(x, y), im.stride(0), channels, opacity, color, n);
+        return;
+    }
+    float *planes[3];
+    for (int c = 0; c < channels; ++c)
+        planes[c] = im.row(y, c) + x;
+    blendRow(planes, channels, opacity, color, n);
+}
+
+void blendRowFixed8(int16_t * const planes[3],
+                    const uint16_t *opacity,
+                    const int16_t color[3],
+                    int n,
+                    BlendKernel kernel)
+{
+    if (kernel > bestBlendKernel())
+        throw InvalidArgument();
+    if (n <= 0)
+        return;
+
+    switch (kernel) {
+#ifdef BLEND_HAVE_X86
+    case BLEND_AVX2:
+        blendRowFixed8AVX2(planes, opacity, color, n);
+        return;
+    case BLEND_SSE:
+        blendRowFixed8SSE(planes, opacity, color, n);
+        return;
+#endif
+    default:
+        blendRowFixed8Scalar(planes, opacity, color, 0, n);
+    }
+}
+
+void blendRowFixed16(uint16_t * const planes[3],
+                     const uint16_t *opacity,
+                     const uint16_t color[3],
+                     int n,
+                     BlendKernel kernel)
+{
+    if (kernel > bestBlendKernel())
+        throw InvalidArgument();
+    if (n <= 0)
+        return;
+
+    switch (kernel) {
+#ifdef BLEND_HAVE_X86
+    case BLEND_AVX2:
+        blendRowFixed16AVX2(planes, opacity, color, n);
+        return;
+    case BLEND_SSE:
+        blendRowFixed16SSE(planes, opacity, color, n);
+        return;
+#endif
+    default:
+        blendRowFixed16Scalar(planes, opacity, color, 0, n);
+    }
+}
+
+bool underRow(float * const planes[3],
+              float *transmittance,
+              const float *opacity,
+              const float color[3],
+              float saturation,
+              int n,
+              BlendKernel kernel)
+{
+    if (kernel > bestBlendKernel())
+        throw InvalidArgument();
+    if (n <= 0)
+        return false;
+
+    switch (kernel) {
+#ifdef BLEND_HAVE_X86
+    case BLEND_AVX2:
+        return underRowAVX2(planes, transmittance, opacity, color, saturation, n) != 0;
+    case BLEND_SSE:
+        return underRowSSE(planes, transmittance, opacity, color, saturation, n) != 0;
+#endif
+    default:
+        return underRowScalar(planes, transmittance, opacity, color, saturation, 0, n) != 0;
+    }
+}
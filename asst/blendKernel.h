@@ -0,0 +1,97 @@
+/* --------------------------------------------------------------------------
+ * File:    blendKernel.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Vectorized row kernel for compositing brush opacity onto a planar canvas
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __blendKernel__h
+#define __blendKernel__h
+
+#include <cstdint>
+
+class Image;
+
+// Instruction sets the row kernel can run with, narrowest first
+enum BlendKernel {
+    BLEND_SCALAR,
+    BLEND_SSE,   // 4 texels per step
+    BLEND_AVX2   // 8 texels per step
+};
+
+// Widest kernel supported by the CPU we are running on (checked once)
+BlendKernel bestBlendKernel();
+
+const char * blendKernelName(BlendKernel kernel);
+
+// For every channel c < channels and every i < n:
+//     planes[c][i] = opacity[i] * color[c] + (1 - opacity[i]) * planes[c][i]
+// which is the linear opacity blend of brush(). planes[c] points to the first
+// texel of a row of channel c of a planar image. Every kernel performs the
+// same multiplies and adds in the same order (no fused multiply-add), so the
+// result is identical bit for bit whichever one is used.
+void blendRow(float * const planes[],
+              int channels,
+              const float *opacity,
+              const float color[],
+              int n,
+              BlendKernel kernel = bestBlendKernel());
+
+// The same blend on n pixels of an interleaved image (see ImageLayout),
+// pixel i starting at pixels + i * stride with its channels adjacent:
+//     pixels[i * stride + c] = opacity[i] * color[c] + (1 - opacity[i]) * pixels[i * stride + c]
+// With the multiplies and adds of blendRow, so the result is the same as
+// blending the planar image. 4 pixels per step with SSE2 when the pixels are
+// 3 adjacent channels, scalar otherwise.
+void blendPixels(float *pixels,
+                 int stride,
+                 int channels,
+                 const float *opacity,
+                 const float color[],
+                 int n);
+
+// Blends n pixels of row y of im from pixel x on, through blendRow on a
+// planar image and blendPixels on an interleaved one. Only the first 3
+// channels of im are painted.
+void blendImageRow(Image &im,
+                   int x,
+                   int y,
+                   const float *opacity,
+                   const float color[],
+                   int n);
+
+// Fixed point versions for the rows of the 3 channels of a FixedTile (see
+// fixedCanvas.h): opacity is Q15, color is quantized like the values. The
+// 8 bit kernel blends 8 bit values scaled by 128 (0..32640), the 16 bit one
+// the canvas values. All the kernels give the same result.
+void blendRowFixed8(int16_t * const planes[3],
+                    const uint16_t *opacity,
+                    const int16_t color[3],
+                    int n,
+                    BlendKernel kernel = bestBlendKernel());
+
+void blendRowFixed16(uint16_t * const planes[3],
+                     const uint16_t *opacity,
+                     const uint16_t color[3],
+                     int n,
+                     BlendKernel kernel = bestBlendKernel());
+
+// Front to back ("under") blend of a brush row below the 3 premultiplied
+// color planes and the transmittance of a row of pixels: for every i < n
+// whose transmittance[i] > saturation,
+//     planes[c][i] += transmittance[i] * opacity[i] * color[c]
+//     transmittance[i] *= 1 - opacity[i]
+// Returns whether a transmittance dropped to saturation or below. Every
+// kernel gives the same result.
+bool underRow(float * const planes[3],
+              float *transmittance,
+              const float *opacity,
+              const float color[3],
+              float saturation,
+              int n,
+              BlendKernel kernel = bestBlendKernel());
+
+#endif
@@ -0,0 +1,241 @@
+/* --------------------------------------------------------------------------
+ * File:    brushAtlas.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Pre-scaled, pre-rotated brush opacities for the oriented paint modes
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "brushAtlas.h"
+#include "basicImageManipulation.h"
+#include "fixedCanvas.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+using namespace std;
+
+namespace {
+
+// First fine pixel under coarse pixel c, when n fine pixels are averaged
+// down to m coarse ones (n / m is between 1 and 2)
+int boxTap(int n, int m, int c) {
+    return static_cast<int>(floor(static_cast<double>(c) * n / m));
+}
+
+// Weights of the (up to) three fine pixels from boxTap(n, m, c) on, by the
+// fraction of each that coarse pixel c covers
+vector<float> boxWeights(int n, int m) {
+    vector<float> weights(3 * m, 0.0f);
+    for (int c = 0; c < m; ++c) {
+        double lo = static_cast<double>(c) * n / m, hi = static_cast<double>(c + 1) * n / m;
+        int first = boxTap(n, m, c);
+        for (int i = 0; i < 3; ++i) {
+            double overlap = min(hi, first + i + 1.0) - max(lo, first + i + 0.0);
+            if (overlap > 0.0)
+                weights[3 * c + i] = static_cast<float>(overlap * m / n);
+        }
+    }
+    return weights;
+}
+
+}
+
+BrushMipChain::BrushMipChain(const Image &texture) {
+    Image opacity(texture.width(), texture.height(), 1);
+    for (int y = 0; y < texture.height(); ++y)
+        for (int x = 0; x < texture.width(); ++x)
+            opacity(x, y, 0) = texture(x, y, 0);
+    levels.push_back(opacity);
+
+    while (levels.back().width() > 1 || levels.back().height() > 1) {
+        const Image &fine = levels.back();
+        int w = fine.width(), h = fine.height();
+        int cw = (w + 1) / 2, ch = (h + 1) / 2;
+        // odd sizes round up: each coarse pixel then averages w / cw fine
+        // pixels, so that every level covers the texture's full extent
+        vector<float> wx = boxWeights(w, cw), wy = boxWeights(h, ch);
+        Image coarse(cw, ch, 1);
+        for (int y = 0; y < ch; ++y) {
+            float *out = coarse.row(y);
+            for (int j = 0; j < 3; ++j) {
+                float ky = wy[3 * y + j];
+                if (ky == 0.0f)
+                    continue;
+                const float *in = fine.row(min(boxTap(h, ch, y) + j, h - 1));
+                for (int x = 0; x < cw; ++x) {
+                    int x0 = boxTap(w, cw, x);
+                    float sum = 0.0f;
+                    for (int i = 0; i < 3; ++i)
+                        sum += wx[3 * x + i] * in[min(x0 + i, w - 1)];
+                    out[x] += ky * sum;
+                }
+            }
+        }
+        levels.push_back(coarse);
+    }
+}
+
+Image BrushMipChain::resample(int size) const {
+    const Image &full = levels[0];
+    float factor = static_cast<float>(size) / max(full.width(), full.height());
+    int w = static_cast<int>(floor(factor * full.width()));
+    int h = static_cast<int>(floor(factor * full.height()));
+    if (w <= 0 || h <= 0)
+        throw NegativeDimensionException();
+
+    // smallest level that is still at least as fine as the output
+    int l = 0;
+    while (l + 1 < numLevels() && (1 << (l + 1)) * factor <= 1.0f)
+        ++l;
+    const Image &src = levels[l];
+    // output pixels to level pixels, from the level's actual size: odd
+    // sizes round up at each halving, so it is not exactly 2^l smaller
+    float scale_x = src.width() / static_cast<float>(w);
+    float scale_y = src.height() / static_cast<float>(h);
+
+    // pixel centres map to pixel centres
+    Image out(w, h, 1);
+    for (int y = 0; y < h; ++y) {
+        float *row = out.row(y);
+        for (int x = 0; x < w; ++x)
+            row[x] = interpolateLin(src, (x + 0.5f) * scale_x - 0.5f, (y + 0.5f) * scale_y - 0.5f, 0, true);
+    }
+    return out;
+}
+
+BrushAtlas::BrushAtlas(const Image &texture, int size, int numAngles)
+  : num_angles(numAngles), brush_size(size), brushes_(build(BrushMipChain(texture), size, numAngles))
+{
+    quantize();
+}
+
+BrushAtlas::BrushAtlas(const BrushMipChain &mips, int size, int numAngles)
+  : num_angles(numAngles), brush_size(size), brushes_(build(mips, size, numAngles))
+{
+    quantize();
+}
+
+void BrushAtlas::quantize() {
+    fixed_opacity.resize(static_cast<size_t>(width()) * height() * num_angles);
+    for (int bin = 0; bin < num_angles; ++bin)
+        for (int y = 0; y < height(); ++y)
+            for (int x = 0; x < width(); ++x)
+                fixed_opacity[(static_cast<size_t>(bin) * height() + y) * width() + x] =
+                    quantizeOpacity(brushes_.row(y, bin)[x]);
+}
+
+Image BrushAtlas::build(const BrushMipChain &mips, int size, int numAngles) {
+    if (numAngles <= 0)
+        throw InvalidArgument();
+
+    // brush() only reads the opacity, which the mip chain prefilters
+    Image opacity = mips.resample(size);
+
+    Image atlas(opacity.width(), opacity.height(), numAngles);
+    for (int i = 0; i < numAngles; ++i) {
+        Image r = rotate(opacity, static_cast<float>(i) * 2.0f * M_PI / numAngles);
+        for (int y = 0; y < r.height(); ++y)
+            for (int x = 0; x < r.width(); ++x)
+                atlas(x, y, i) = r(x, y, 0);
+    }
+    return atlas;
+}
+
+int BrushAtlas::angleBin(float angle) const {
+    return angleToBin(angle, num_angles);
+}
+
+float BrushAtlas::binAngle(int bin) const {
+    return static_cast<float>(bin) * 2.0f * M_PI / num_angles;
+}
+
+int angleToBin(float angle, int numAngles) {
+    float turns = angle / (2.0f * M_PI);
+    turns -= floor(turns); // wrap to [0, 1)
+    int bin = static_cast<int>(round(turns * numAngles));
+    return bin % numAngles;
+}
+
+AngleBins::AngleBins(const Image &angles, int numAngles)
+  : w(angles.width()), h(angles.height()), num_angles(numAngles),
+    bins(static_cast<size_t>(angles.width()) * angles.height())
+{
+    if (numAngles <= 0 || numAngles > 256)
+        throw InvalidArgument();
+    for (int y = 0; y < h; ++y) {
+        const float *a = angles.row(y);
+        for (int x = 0; x < w; ++x)
+            bins[static_cast<size_t>(y) * w + x] = static_cast<uint8_t>(angleToBin(a[x], numAngles));
+    }
+}
+
+Image BrushAtlas::brush(int bin) const {
+    Image b(width(), height(), 1);
+    for (int y = 0; y < height(); ++y)
+        for (int x = 0; x < width(); ++x)
+            b(x, y, 0) = brushes_(x, y, bin);
+    return b;
+}
+
+
+// ------------- ATLAS CACHE ------------------------
+namespace {
+
+// FNV-1a hash of the texture opacity, used to recognise a texture that was
+// loaded more than once or passed by value
+unsigned long long textureFingerprint(const Image &texture) {
+    unsigned long long h = 14695981039346656037ULL;
+    for (int y = 0; y < texture.height(); ++y) {
+        for (int x = 0; x < texture.width(); ++x) {
+            float v = texture(x, y, 0);
+            unsigned int bits;
+            memcpy(&bits, &v, sizeof(bits));
+            h = (h ^ bits) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+typedef tuple<unsigned long long, int, int, int, int> AtlasKey;
+typedef tuple<unsigned long long, int, int> TextureKey;
+
+mutex cache_mutex;
+
+// the mip chain of a texture, cache_mutex must be held
+const BrushMipChain & cachedMipChain(const TextureKey &key, const Image &texture) {
+    static map<TextureKey, unique_ptr<BrushMipChain>> chains;
+    unique_ptr<BrushMipChain> &mips = chains[key];
+    if (!mips)
+        mips.reset(new BrushMipChain(texture));
+    return *mips;
+}
+
+}
+
+const BrushAtlas & brushAtlas(const Image &texture, int size, int numAngles) {
+    static map<AtlasKey, unique_ptr<BrushAtlas>> cache;
+
+    unsigned long long fingerprint = textureFingerprint(texture);
+    AtlasKey key(fingerprint, texture.width(), texture.height(), size, numAngles);
+
+    lock_guard<mutex> lock(cache_mutex);
+    unique_ptr<BrushAtlas> &atlas = cache[key];
+    if (!atlas) {
+        TextureKey texture_key(fingerprint, texture.width(), texture.height());
+        atlas.reset(new BrushAtlas(cachedMipChain(texture_key, texture), size, numAngles));
+    }
+    return *atlas;
+}
+
+const BrushMipChain & brushMipChain(const Image &texture) {
+    TextureKey key(textureFingerprint(texture), texture.width(), texture.height());
+    lock_guard<mutex> lock(cache_mutex);
+    return cachedMipChain(key, texture);
+}
+// --------- END ATLAS CACHE -----------------------
@@ -0,0 +1,116 @@
+/* --------------------------------------------------------------------------
+ * File:    brushAtlas.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Pre-scaled, pre-rotated brush opacities for the oriented paint modes
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __brushAtlas__h
+#define __brushAtlas__h
+
+#include "Image.h"
+#include <cstdint>
+#include <vector>
+
+// Opacity (channel 0) of a brush texture and successively halved copies of
+// it, each level the box average of the previous one, down to a single
+// pixel. Odd sizes round up, and the coarse pixels then average a little
+// more than 2x2 so that every level spans the whole texture. A brush of any
+// size is resampled from the smallest level that is still at least that
+// size, so it never skips texels like a direct bilinear downscale of the
+// full texture does.
+class BrushMipChain {
+public:
+    explicit BrushMipChain(const Image &texture);
+
+    int numLevels() const { return static_cast<int>(levels.size()); }
+    const Image & level(int l) const { return levels[l]; }
+
+    // The opacity scaled so that its largest side is size pixels: a
+    // floor(factor * width) x floor(factor * height) single channel image
+    Image resample(int size) const;
+
+private:
+    std::vector<Image> levels;
+};
+
+// A set of numAngles copies of a brush texture, scaled so that its largest
+// side is size pixels and rotated by 2*pi*i/numAngles for i = 0..numAngles-1.
+// Only the opacity (channel 0 of the texture) is kept. The brushes are stored
+// contiguously in a single width x height x numAngles image, one angle per
+// channel plane.
+class BrushAtlas {
+public:
+    BrushAtlas(const Image &texture, int size, int numAngles = 36);
+    BrushAtlas(const BrushMipChain &mips, int size, int numAngles = 36);
+
+    int numAngles() const { return num_angles; }
+    int size()      const { return brush_size; }
+    int width()     const { return brushes_.width(); }
+    int height()    const { return brushes_.height(); }
+
+    // Index of the bin whose rotation is closest to angle (in radians)
+    int angleBin(float angle) const;
+    // Rotation (in radians) of the brush stored in bin
+    float binAngle(int bin) const;
+
+    // Opacity of the brush in bin at pixel (x, y)
+    float opacity(int x, int y, int bin) const { return brushes_(x, y, bin); }
+
+    // All the brushes, one per channel
+    const Image & brushes() const { return brushes_; }
+    // Row y of the brush in bin, as Q15 fixed point opacities (see
+    // fixedCanvas.h)
+    const uint16_t * fixedOpacity(int y, int bin) const {
+        return &fixed_opacity[(static_cast<size_t>(bin) * height() + y) * width()];
+    }
+    // Copy of a single brush as a one channel image
+    Image brush(int bin) const;
+
+private:
+    int num_angles;
+    int brush_size;
+    Image brushes_;
+    std::vector<uint16_t> fixed_opacity;
+
+    void quantize();
+    static Image build(const BrushMipChain &mips, int size, int numAngles);
+};
+
+// Index of the rotation bin closest to angle (in radians) out of numAngles
+// evenly spaced rotations
+int angleToBin(float angle, int numAngles);
+
+// An orientation field (one angle per pixel, channel 0 of angles) quantized
+// to the rotation bins of an atlas of numAngles brushes: a byte per pixel,
+// and strokes read their bin directly instead of converting an angle.
+class AngleBins {
+public:
+    AngleBins(const Image &angles, int numAngles);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int numAngles() const { return num_angles; }
+
+    uint8_t operator()(int x, int y) const { return bins[static_cast<size_t>(y) * w + x]; }
+
+private:
+    int w;
+    int h;
+    int num_angles;
+    std::vector<uint8_t> bins;
+};
+
+// Returns the atlas for (texture, size, numAngles), building it the first time
+// it is requested. Textures are identified by their content, so atlases are
+// shared between calls and between paint modes for the lifetime of the program.
+const BrushAtlas & brushAtlas(const Image &texture, int size, int numAngles = 36);
+
+// Same cache for the mip chains the atlases are built from: each texture is
+// prefiltered once, whatever the number of sizes it is used at.
+const BrushMipChain & brushMipChain(const Image &texture);
+
+#endif
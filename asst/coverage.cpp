@@ -0,0 +1,71 @@
+/* --------------------------------------------------------------------------
+ * File:    coverage.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Coverage of the canvas by the strokes of a layer
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "coverage.h"
+#include <algorithm>
+
+using namespace std;
+
+CoverageTarget::CoverageTarget(float fraction_, int maxStrokes_)
+  : fraction(fraction_), maxStrokes(maxStrokes_)
+{
+    if (!(fraction_ > 0.0f && fraction_ < 1.0f) || maxStrokes_ < 0)
+        throw InvalidArgument();
+}
+
+CoverageMap::CoverageMap(const ImportanceSampler &importance, int size)
+  : radius(max(1, size / 4)), cell(max(1, radius / 4)),
+    cells_w((importance.width() + cell - 1) / cell),
+    cells_h((importance.height() + cell - 1) / cell),
+    weight(cells_w * cells_h, 0.0), covered(cells_w * cells_h, false),
+    total(0.0), covered_weight(0.0), covered_cells(0)
+{
+    if (importance.uniform()) {
+        for (int y = 0; y < importance.height(); ++y)
+            for (int x = 0; x < importance.width(); ++x)
+                weight[x / cell + (y / cell) * cells_w] += 1.0;
+    } else {
+        Image density = importance.density();
+        for (int y = 0; y < density.height(); ++y) {
+            const float *row = density.row(y);
+            for (int x = 0; x < density.width(); ++x)
+                weight[x / cell + (y / cell) * cells_w] += row[x];
+        }
+    }
+    for (size_t i = 0; i < weight.size(); ++i)
+        total += weight[i];
+}
+
+void CoverageMap::coverCell(int i) {
+    if (covered[i])
+        return;
+    covered[i] = true;
+    covered_weight += weight[i];
+    ++covered_cells;
+}
+
+void CoverageMap::cover(int x, int y) {
+    int cx = min(max(x / cell, 0), cells_w - 1);
+    int cy = min(max(y / cell, 0), cells_h - 1);
+
+    // the cells whose centers are inside the disk, and the cell of the
+    // stroke itself however small the disk
+    float r2 = static_cast<float>(radius) * radius;
+    int reach = radius / cell + 1;
+    for (int j = max(cy - reach, 0); j <= min(cy + reach, cells_h - 1); ++j) {
+        float dy = (j + 0.5f) * cell - y;
+        for (int i = max(cx - reach, 0); i <= min(cx + reach, cells_w - 1); ++i) {
+            float dx = (i + 0.5f) * cell - x;
+            if (dx * dx + dy * dy <= r2)
+                coverCell(i + j * cells_w);
+        }
+    }
+    coverCell(cx + cy * cells_w);
+}
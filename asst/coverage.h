@@ -0,0 +1,58 @@
+/* --------------------------------------------------------------------------
+ * File:    coverage.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Coverage of the canvas by the strokes of a layer
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __coverage__h
+#define __coverage__h
+
+#include "importanceSampler.h"
+#include <vector>
+
+// When to stop drawing the strokes of a layer: once fraction of its
+// importance is covered, or after maxStrokes strokes if that never happens.
+struct CoverageTarget {
+    explicit CoverageTarget(float fraction_ = 0.95f, int maxStrokes_ = 1000000);
+
+    float fraction;     // in (0, 1)
+    int maxStrokes;
+};
+
+// Canvas covered by the strokes of one layer so far, weighted by the
+// importance the layer is drawn from. A stroke of size pixels covers the
+// disk of radius size/4 around its position (about the opaque part of the
+// brush), recorded on a grid of cells a quarter of that radius wide; each
+// cell weighs the probability that the importance draws a pixel in it.
+class CoverageMap {
+public:
+    CoverageMap(const ImportanceSampler &importance, int size);
+
+    // Records a stroke at (x, y)
+    void cover(int x, int y);
+
+    // Share of the importance covered
+    double coverage() const { return total > 0.0 ? covered_weight / total : 1.0; }
+
+    // Share of the canvas covered, without weights
+    double areaCoverage() const { return static_cast<double>(covered_cells) / covered.size(); }
+
+private:
+    int radius;
+    int cell;                    // cell size in pixels
+    int cells_w;
+    int cells_h;
+    std::vector<double> weight;
+    std::vector<bool> covered;
+    double total;
+    double covered_weight;
+    int covered_cells;
+
+    void coverCell(int i);
+};
+
+#endif
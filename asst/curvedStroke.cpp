@@ -0,0 +1,243 @@
+/* --------------------------------------------------------------------------
+ * File:    curvedStroke.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Long curved strokes traced through the orientation field
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "curvedStroke.h"
+#include "a10.h"
+#include "brushAtlas.h"
+#include "parallel.h"
+#include "random.h"
+#include "strokePlan.h"
+#include "strokeRasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// mean absolute difference over the channels above which a stroke stops
+const float color_tolerance = 0.1f;
+
+// longest polyline a stroke may have, 2 * 32 steps
+const int max_segments = 64;
+
+// rotations of the brush the dabs are turned to, as in the paint modes
+const int dab_angles = 36;
+
+// Follows the angles field from (x, y) for up to maxSteps steps of length
+// step, starting along (dx, dy), and appends the points reached
+void traceHalf(const Image &im, const Image &angles, const float color[3],
+               float x, float y, float dx, float dy, float step, int maxSteps,
+               vector<float> &xs, vector<float> &ys)
+{
+    for (int k = 0; k < maxSteps; ++k) {
+        float nx = x + step * dx;
+        float ny = y + step * dy;
+        int ix = static_cast<int>(floor(nx + 0.5f));
+        int iy = static_cast<int>(floor(ny + 0.5f));
+        if (ix < 0 || iy < 0 || ix >= im.width() || iy >= im.height())
+            return;
+        float diff = 0.0f;
+        for (int c = 0; c < 3; ++c)
+            diff += fabs(im(ix, iy, c) - color[c]);
+        if (diff > 3.0f * color_tolerance)
+            return;
+        xs.push_back(nx);
+        ys.push_back(ny);
+
+        // the field is an orientation: keep going the same way
+        float angle = angles(ix, iy);
+        float ndx = cos(angle), ndy = sin(angle);
+        if (ndx * dx + ndy * dy < 0.0f) {
+            ndx = -ndx;
+            ndy = -ndy;
+        }
+        x = nx;
+        y = ny;
+        dx = ndx;
+        dy = ndy;
+    }
+}
+
+// The dabs of the strokes, in stroke order: the brush stamped every
+// size / 2 pixels of arc length along each polyline (the step the strokes
+// are traced with, so at each traced point) and from its start to its end,
+// turned to the direction of the polyline there, that of both segments
+// where it bends
+StrokePlan marchDabs(const CurvedStrokes &strokes, int numAngles) {
+    StrokePlan dabs(strokes.width, strokes.height, numAngles);
+    dabs.reserve(static_cast<int>(strokes.px.size()));
+    for (int s = 0; s < strokes.count(); ++s) {
+        const float *x = &strokes.px[strokes.first[s]], *y = &strokes.py[strokes.first[s]];
+        int n = strokes.numPoints(s);
+        float color[3] = {strokes.r[s], strokes.g[s], strokes.b[s]};
+        float spacing = max(1.0f, strokes.size[s] / 2.0f);
+
+        // arc length at each point
+        float along[max_segments + 1];
+        along[0] = 0.0f;
+        for (int i = 1; i < n; ++i)
+            along[i] = along[i - 1] + hypot(x[i] - x[i - 1], y[i] - y[i - 1]);
+        float length = along[n - 1];
+
+        int i = 0;  // segment of the current dab
+        for (int k = 0; k * spacing <= length + spacing / 2.0f; ++k) {
+            float a = min(k * spacing, length);
+            while (i + 2 < n && along[i + 1] <= a)
+                ++i;
+            float d = along[i + 1] - along[i];
+            float t = d > 0.0f ? (a - along[i]) / d : 0.0f;
+            float dx = (x[i + 1] - x[i]) / max(d, 1e-6f), dy = (y[i + 1] - y[i]) / max(d, 1e-6f);
+            // a joint: the next or previous segment turns the dab too
+            int j = t < 1e-3f ? i - 1 : t > 1.0f - 1e-3f ? i + 1 : -1;
+            if (j >= 0 && j + 1 < n) {
+                float dj = max(along[j + 1] - along[j], 1e-6f);
+                dx += (x[j + 1] - x[j]) / dj;
+                dy += (y[j + 1] - y[j]) / dj;
+            }
+            int px = static_cast<int>(floor(x[i] + t * (x[i + 1] - x[i]) + 0.5f));
+            int py = static_cast<int>(floor(y[i] + t * (y[i + 1] - y[i]) + 0.5f));
+            dabs.append(px, py, color, angleToBin(atan2(dy, dx), numAngles), strokes.size[s], strokes.layer[s]);
+        }
+    }
+    return dabs;
+}
+}
+
+CurvedStrokes::CurvedStrokes(int width_, int height_)
+  : width(width_), height(height_), first(1, 0)
+{
+    if (width_ < 0 || height_ < 0)
+        throw NegativeDimensionException();
+}
+
+void CurvedStrokes::append(const float *x, const float *y, int n, const float color[3], int size_, int layer_) {
+    if (n < 2 || n > max_segments + 1)
+        throw InvalidArgument();
+    px.insert(px.end(), x, x + n);
+    py.insert(py.end(), y, y + n);
+    first.push_back(static_cast<int>(px.size()));
+    r.push_back(color[0]);
+    g.push_back(color[1]);
+    b.push_back(color[2]);
+    size.push_back(size_);
+    layer.push_back(static_cast<uint8_t>(layer_));
+}
+
+void sampleCurvedStrokes(CurvedStrokes &strokes,
+                         const Image &im,
+                         const Image &angles,
+                         const ImportanceSampler &importance,
+                         int size,
+                         int count,
+                         float noise,
+                         int maxSteps,
+                         unsigned int seed,
+                         int layer)
+{
+    if (maxSteps < 0 || 2 * maxSteps > max_segments)
+        throw InvalidArgument();
+    if (importance.empty() || count <= 0)
+        return;
+
+    // chunks of strokes are traced in parallel and appended in order, as in
+    // sampleStrokes()
+    StrokeRandom rng(seed, layer);
+    float step = max(1.0f, size / 2.0f);
+    const int chunk_size = 1024;
+    int num_chunks = (count + chunk_size - 1) / chunk_size;
+    vector<CurvedStrokes> chunks(num_chunks, CurvedStrokes(strokes.width, strokes.height));
+
+    parallelFor(0, num_chunks, [&](int k) {
+        vector<float> back_x, back_y, xs, ys;
+        int end = min(count, (k + 1) * chunk_size);
+        for (int i = k * chunk_size; i < end; ++i) {
+            uint32_t w[4];
+            rng.words(i, 0, w);
+            int x, y;
+            importance.sample(w, x, y);
+
+            uint32_t n[4];
+            rng.words(i, 1, n);
+            float seed_color[3], color[3];
+            for (int c = 0; c < 3; ++c) {
+                seed_color[c] = im(x, y, c);
+                color[c] = StrokeRandom::modulate(seed_color[c], noise, n[c]);
+            }
+
+            float angle = angles(x, y);
+            float dx = cos(angle), dy = sin(angle);
+            back_x.clear();
+            back_y.clear();
+            xs.clear();
+            ys.clear();
+            traceHalf(im, angles, seed_color, x, y, -dx, -dy, step, maxSteps, back_x, back_y);
+            xs.assign(back_x.rbegin(), back_x.rend());
+            ys.assign(back_y.rbegin(), back_y.rend());
+            xs.push_back(static_cast<float>(x));
+            ys.push_back(static_cast<float>(y));
+            traceHalf(im, angles, seed_color, x, y, dx, dy, step, maxSteps, xs, ys);
+            if (xs.size() < 2) {
+                // could not move at all: a straight brush along the field
+                xs.push_back(x + 0.5f * dx);
+                ys.push_back(y + 0.5f * dy);
+            }
+            chunks[k].append(xs.data(), ys.data(), static_cast<int>(xs.size()), color, size, layer);
+        }
+    });
+
+    for (int k = 0; k < num_chunks; ++k) {
+        const CurvedStrokes &chunk = chunks[k];
+        for (int s = 0; s < chunk.count(); ++s) {
+            float color[3] = {chunk.r[s], chunk.g[s], chunk.b[s]};
+            strokes.append(&chunk.px[chunk.first[s]], &chunk.py[chunk.first[s]], chunk.numPoints(s),
+                           color, chunk.size[s], chunk.layer[s]);
+        }
+    }
+}
+
+void rasterizeCurved(Image &im,
+                     const CurvedStrokes &strokes,
+                     const Image &texture,
+                     int tileSize,
+                     int numThreads)
+{
+    rasterizeTiled(im, marchDabs(strokes, dab_angles), texture, tileSize, numThreads);
+}
+
+CurvedStrokes curvedPaintPlan(const PaintAnalysis &analysis,
+                              int strokes,
+                              int size,
+                              float noise,
+                              int maxSteps,
+                              unsigned int seed)
+{
+    const Image &im = analysis.image();
+    CurvedStrokes plan(im.width(), im.height());
+    sampleCurvedStrokes(plan, im, analysis.angles(), ImportanceSampler(im.width(), im.height()),
+                        size, strokes, noise, maxSteps, seed, 0);
+    sampleCurvedStrokes(plan, im, analysis.angles(), analysis.sharpness(),
+                        size / 4, strokes, noise, maxSteps, seed, 1);
+    return plan;
+}
+
+Image curvedPaint(const Image &im,
+                  const Image &texture,
+                  int strokes,
+                  int size,
+                  float noise,
+                  int maxSteps,
+                  unsigned int seed)
+{
+    CurvedStrokes plan = curvedPaintPlan(PaintAnalysis(im), strokes, size, noise, maxSteps, seed);
+    Image out(im.width(), im.height(), 3);
+    rasterizeCurved(out, plan, texture);
+    return out;
+}
@@ -0,0 +1,91 @@
+/* --------------------------------------------------------------------------
+ * File:    curvedStroke.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Long curved strokes traced through the orientation field
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __curvedStroke__h
+#define __curvedStroke__h
+
+#include "Image.h"
+#include "importanceSampler.h"
+#include <cstdint>
+#include <vector>
+
+class PaintAnalysis;
+
+// Strokes that follow a polyline instead of stamping one rotated brush.
+// The brush texture, scaled to size pixels, is marched along the polyline
+// (see rasterizeCurved), so that a stroke is one mark the width of the
+// brush that bends with it. The points of every stroke are stored one
+// after the other.
+struct CurvedStrokes {
+    CurvedStrokes(int width_ = 0, int height_ = 0);
+
+    int width;      // size of the canvas the strokes were sampled for
+    int height;
+
+    std::vector<int> first;        // first point of each stroke, count() + 1 entries
+    std::vector<float> px, py;     // the points
+    std::vector<float> r, g, b;
+    std::vector<int> size;
+    std::vector<uint8_t> layer;
+
+    int count() const { return static_cast<int>(first.size()) - 1; }
+    int numPoints(int s) const { return first[s + 1] - first[s]; }
+
+    // Appends a stroke through the n >= 2 points (x[i], y[i])
+    void append(const float *x, const float *y, int n, const float color[3], int size, int layer);
+};
+
+// Samples strokes like sampleSingleScaleOriented (same positions and colors
+// for the same seed and layer), then traces each one from its position up to
+// maxSteps steps of size/2 pixels in both directions along the angles field
+// (angles as returned by computeAngles). A stroke stops early where the image
+// color differs from its own by more than a tolerance, or at the border.
+void sampleCurvedStrokes(CurvedStrokes &strokes,
+                         const Image &im,
+                         const Image &angles,
+                         const ImportanceSampler &importance,
+                         int size,
+                         int count,
+                         float noise,
+                         int maxSteps = 4,
+                         unsigned int seed = 0,
+                         int layer = 0);
+
+// Composites the strokes into im in order, each as the brush marched along
+// its polyline: a dab of the atlas brush every size/2 pixels of arc length
+// (at every traced point) from its start to its end, turned to the
+// direction of the polyline there. A stroke costs a few stamps, fewer than
+// the stamps that cover the same canvas, and the dabs are composited by
+// rasterizeTiled.
+void rasterizeCurved(Image &im,
+                     const CurvedStrokes &strokes,
+                     const Image &texture,
+                     int tileSize = 64,
+                     int numThreads = 0);
+
+// The two layers of orientedPaint (a uniform coarse layer, then size/4
+// strokes drawn from the sharpness) with curved strokes. Each stroke covers
+// several brushes' worth of canvas, so a few times fewer strokes are needed.
+CurvedStrokes curvedPaintPlan(const PaintAnalysis &analysis,
+                              int strokes = 1000,
+                              int size = 50,
+                              float noise = 0.3f,
+                              int maxSteps = 4,
+                              unsigned int seed = 0);
+
+Image curvedPaint(const Image &im,
+                  const Image &texture,
+                  int strokes = 1000,
+                  int size = 50,
+                  float noise = 0.3f,
+                  int maxSteps = 4,
+                  unsigned int seed = 0);
+
+#endif
@@ -0,0 +1,210 @@
+/* --------------------------------------------------------------------------
+ * File:    errorDriven.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Stroke placement driven by the error between canvas and source
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "errorDriven.h"
+#include "a10.h"
+#include "brushAtlas.h"
+#include "filtering.h"
+#include "random.h"
+#include "strokeRasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ErrorMap::ErrorMap(const Image &canvas_, const Image &reference_, int cellSize, int tileSize)
+  : canvas(canvas_), reference(reference_), cell(cellSize),
+    tile(cellSize * max(1, tileSize / cellSize)),
+    error(canvas_.width(), canvas_.height(), 1)
+{
+    if (cellSize <= 0 || tileSize <= 0)
+        throw InvalidArgument();
+    if (canvas.width() != reference.width() || canvas.height() != reference.height() ||
+        canvas.channels() != reference.channels())
+        throw MismatchedDimensionsException();
+
+    cells_w = (canvas.width() + cell - 1) / cell;
+    cells_h = (canvas.height() + cell - 1) / cell;
+    tiles_w = (canvas.width() + tile - 1) / tile;
+    int tiles_h = (canvas.height() + tile - 1) / tile;
+    tables.assign(tiles_w * tiles_h, vector<double>((tile + 1) * (tile + 1), 0.0));
+
+    computeError(0, 0, canvas.width(), canvas.height());
+    for (int ty = 0; ty < tiles_h; ++ty)
+        for (int tx = 0; tx < tiles_w; ++tx)
+            buildTable(tx, ty, 0);
+}
+
+void ErrorMap::computeError(int x0, int y0, int x1, int y1) {
+    int channels = canvas.channels();
+    float scale = 1.0f / channels;
+    int step_a = canvas.stride(0), step_b = reference.stride(0);
+    for (int y = y0; y < y1; ++y) {
+        float *e = error.row(y);
+        fill(e + x0, e + x1, 0.0f);
+        if (x0 >= x1)
+            continue;
+        // the values of a row of a channel are stride(0) apart in either layout
+        for (int c = 0; c < channels; ++c) {
+            const float *a = &canvas.at(0, y, c);
+            const float *b = &reference.at(0, y, c);
+            for (int x = x0; x < x1; ++x)
+                e[x] += fabs(a[x * step_a] - b[x * step_b]);
+        }
+        for (int x = x0; x < x1; ++x)
+            e[x] *= scale;
+    }
+}
+
+// Entry (i, j) of a table is the sum of the error over the first j rows and
+// i columns of the tile; rows above fromRow are still up to date.
+void ErrorMap::buildTable(int tx, int ty, int fromRow) {
+    vector<double> &table = tables[tx + ty * tiles_w];
+    int x0 = tx * tile, y0 = ty * tile;
+    int w = min(tile, error.width() - x0), h = min(tile, error.height() - y0);
+    for (int j = fromRow; j < h; ++j) {
+        const float *e = error.row(y0 + j) + x0;
+        const double *above = &table[j * (tile + 1)];
+        double *row = &table[(j + 1) * (tile + 1)];
+        double sum = 0.0;
+        for (int i = 0; i < w; ++i) {
+            sum += e[i];
+            row[i + 1] = above[i + 1] + sum;
+        }
+    }
+}
+
+float ErrorMap::cellError(int cx, int cy) const {
+    if (cx < 0 || cy < 0 || cx >= cells_w || cy >= cells_h)
+        throw OutOfBoundsException();
+    int x0 = cx * cell, y0 = cy * cell;
+    int x1 = min(x0 + cell, error.width()), y1 = min(y0 + cell, error.height());
+    int tx = x0 / tile, ty = y0 / tile;
+    const vector<double> &table = tables[tx + ty * tiles_w];
+
+    // corners relative to the tile
+    int i0 = x0 - tx * tile, j0 = y0 - ty * tile;
+    int i1 = x1 - tx * tile, j1 = y1 - ty * tile;
+    double sum = table[j1 * (tile + 1) + i1] - table[j0 * (tile + 1) + i1]
+               - table[j1 * (tile + 1) + i0] + table[j0 * (tile + 1) + i0];
+    return static_cast<float>(sum / ((x1 - x0) * (y1 - y0)));
+}
+
+void ErrorMap::worstPixel(int cx, int cy, int &x, int &y) const {
+    if (cx < 0 || cy < 0 || cx >= cells_w || cy >= cells_h)
+        throw OutOfBoundsException();
+    int x0 = cx * cell, y0 = cy * cell;
+    int x1 = min(x0 + cell, error.width()), y1 = min(y0 + cell, error.height());
+    float worst = -1.0f;
+    for (int j = y0; j < y1; ++j) {
+        const float *e = error.row(j);
+        for (int i = x0; i < x1; ++i)
+            if (e[i] > worst) {
+                worst = e[i];
+                x = i;
+                y = j;
+            }
+    }
+}
+
+void ErrorMap::update(int x0, int y0, int x1, int y1) {
+    x0 = max(x0, 0);
+    y0 = max(y0, 0);
+    x1 = min(x1, error.width());
+    y1 = min(y1, error.height());
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    computeError(x0, y0, x1, y1);
+    for (int ty = y0 / tile; ty <= (y1 - 1) / tile; ++ty) {
+        int from = max(y0 - ty * tile, 0);
+        for (int tx = x0 / tile; tx <= (x1 - 1) / tile; ++tx)
+            buildTable(tx, ty, from);
+    }
+}
+
+StrokePlan errorDrivenPlan(const PaintAnalysis &analysis,
+                           const Image &texture,
+                           int size,
+                           int numLayers,
+                           float threshold,
+                           float noise,
+                           unsigned int seed,
+                           int numAngles,
+                           vector<int> *strokesPerLayer)
+{
+    if (size <= 0 || numLayers <= 0 || threshold < 0.0f)
+        throw InvalidArgument();
+
+    const Image &im = analysis.image();
+    const AngleBins &bins = analysis.angleBins(numAngles);
+    StrokePlan plan(im.width(), im.height(), numAngles);
+    Image canvas(im.width(), im.height(), im.channels());
+    if (strokesPerLayer)
+        strokesPerLayer->clear();
+
+    int layer_size = size;
+    for (int layer = 0; layer < numLayers && layer_size >= 1; ++layer, layer_size /= 4) {
+        Image reference = gaussianBlur_separable(im, max(layer_size / 4.0f, 0.5f));
+        ErrorMap error(canvas, reference, max(1, layer_size / 4));
+        const BrushAtlas &atlas = brushAtlas(texture, layer_size, numAngles);
+        float layer_threshold = layer == 0 ? -1.0f : threshold;
+
+        // the cells in a random order
+        StrokeRandom rng(seed, layer);
+        int num_cells = error.cellsX() * error.cellsY();
+        vector<int> order(num_cells);
+        for (int i = 0; i < num_cells; ++i)
+            order[i] = i;
+        for (int i = num_cells - 1; i > 0; --i) {
+            uint32_t w[4];
+            rng.words(i, 2, w);
+            swap(order[i], order[StrokeRandom::toRange(w[0], i + 1)]);
+        }
+
+        int drawn = 0;
+        for (int k = 0; k < num_cells; ++k) {
+            int cx = order[k] % error.cellsX(), cy = order[k] / error.cellsX();
+            if (error.cellError(cx, cy) <= layer_threshold)
+                continue;
+
+            int x, y;
+            error.worstPixel(cx, cy, x, y);
+            uint32_t n[4];
+            rng.words(drawn, 1, n);
+            float color[3];
+            for (int c = 0; c < 3; ++c) {
+                color[c] = StrokeRandom::modulate(reference(x, y, c), noise, n[c]);
+            }
+            int bin = bins(x, y);
+            plan.append(x, y, color, bin, layer_size, layer);
+            ++drawn;
+
+            brush(canvas, x, y, color, atlas, bin);
+            error.update(x - atlas.width() / 2, y - atlas.height() / 2,
+                         x + atlas.width() / 2, y + atlas.height() / 2);
+        }
+        if (strokesPerLayer)
+            strokesPerLayer->push_back(drawn);
+    }
+    return plan;
+}
+
+Image errorDrivenPaint(const Image &im,
+                       const Image &texture,
+                       int size,
+                       int numLayers,
+                       float threshold,
+                       float noise,
+                       unsigned int seed)
+{
+    return renderStrokePlan(errorDrivenPlan(PaintAnalysis(im), texture, size, numLayers, threshold, noise, seed),
+                            texture);
+}
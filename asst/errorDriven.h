@@ -0,0 +1,87 @@
+/* --------------------------------------------------------------------------
+ * File:    errorDriven.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Stroke placement driven by the error between canvas and source
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __errorDriven__h
+#define __errorDriven__h
+
+#include "Image.h"
+#include "strokePlan.h"
+#include <vector>
+
+class PaintAnalysis;
+
+// Per pixel error between a canvas and a reference (the mean absolute
+// difference of their channels), with the error of any cell read in O(1)
+// from a summed-area table per tile. Tiles are a whole number of cells
+// wide, so a cell never straddles two of them. After painting a rectangle
+// of the canvas, update() recomputes the error inside it and the tables of
+// the tiles it overlaps, from its first row down.
+class ErrorMap {
+public:
+    ErrorMap(const Image &canvas, const Image &reference, int cellSize, int tileSize = 64);
+
+    int cellSize() const { return cell; }
+    int cellsX() const { return cells_w; }
+    int cellsY() const { return cells_h; }
+
+    // Mean error over cell (cx, cy)
+    float cellError(int cx, int cy) const;
+
+    // Pixel of cell (cx, cy) where the error is largest
+    void worstPixel(int cx, int cy, int &x, int &y) const;
+
+    // The canvas changed inside [x0, x1) x [y0, y1)
+    void update(int x0, int y0, int x1, int y1);
+
+private:
+    const Image &canvas;
+    const Image &reference;
+    int cell;
+    int tile;
+    int cells_w, cells_h;
+    int tiles_w;
+    Image error;
+    std::vector<std::vector<double>> tables;   // (tile + 1)^2 per tile
+
+    void computeError(int x0, int y0, int x1, int y1);
+    void buildTable(int tx, int ty, int fromRow);
+};
+
+// Hertzmann style painting on the layers of orientedPaint, from size down by
+// a factor of 4 per layer. Each layer is compared to the source blurred by a
+// quarter of its brush size: its cells, size/2 pixels wide and visited in a
+// random order, get a stroke at their worst pixel when their mean error is
+// above threshold. The stroke takes the color of the blurred source there
+// (modulated by noise) and the orientation of computeAngles, and is painted
+// right away, so that it lowers the error of the cells it overlaps before
+// they are visited. The first layer is always painted everywhere.
+//
+// texture is the brush used to measure the canvas:
+// renderStrokePlan(plan, texture) gives the canvas that placed the strokes.
+// strokesPerLayer, if given, receives the number of strokes of each layer.
+StrokePlan errorDrivenPlan(const PaintAnalysis &analysis,
+                           const Image &texture,
+                           int size = 50,
+                           int numLayers = 2,
+                           float threshold = 0.1f,
+                           float noise = 0.3f,
+                           unsigned int seed = 0,
+                           int numAngles = 36,
+                           std::vector<int> *strokesPerLayer = nullptr);
+
+Image errorDrivenPaint(const Image &im,
+                       const Image &texture,
+                       int size = 50,
+                       int numLayers = 2,
+                       float threshold = 0.1f,
+                       float noise = 0.3f,
+                       unsigned int seed = 0);
+
+#endif
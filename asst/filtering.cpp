@@ -9,12 +9,13 @@
 
 
 #include "filtering.h"
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 
 using namespace std;
 
-Image boxBlur(const Image &im, int k, bool clamp) {
+Image boxBlur(const ImageView &im, int k, bool clamp) {
     // --------- HANDOUT  PS02 ------------------------------
     // Convolve an image with a box filter of size k by k
     // It is safe to asssume k is odd.
@@ -47,41 +48,75 @@ Image boxBlur(const Image &im, int k, bool clamp) {
     return filtered;
 }
 
-Image Filter::convolve(const Image &im, bool clamp){
+Image Filter::convolve(const ImageView &im, bool clamp){
     // --------- HANDOUT  PS02 ------------------------------
     // Write a convolution function for the filter class
     // return im; // change this
 
     // --------- SOLUTION PS02 ------------------------------
-    Image imFilter(im.width(), im.height(), im.channels());
+    // The row fast path below needs contiguous rows: filter interleaved
+    // images as a planar copy, and give the result back their layout
+    if (im.stride(0) != 1) {
+        Image planar(im.width(), im.height(), im.channels());
+        copyValues(im, planar);
+        return convolve(planar, clamp).toLayout(im.layout());
+    }
+
+    Image imFilter(im.width(), im.height(), im.channels(), im.layout());
 
     int sideW = int((width-1.0)/2.0);
     int sideH = int((height-1.0)/2.0);
     float accum;
 
+    // Pixels whose whole footprint is inside the image: columns [xIn0, xIn1)
+    // of rows [yIn0, yIn1). Those are accumulated a row at a time from
+    // unchecked row pointers, in the same order as the per pixel loop
+    // below, so the result does not depend on which path a pixel takes.
+    int xIn0 = width - 1 - sideW, xIn1 = im.width() - sideW;
+    int yIn0 = height - 1 - sideH, yIn1 = im.height() - sideH;
+    vector<float> rowAccum(max(im.width(), 0));
+
     // For every pixel in the image
     for (int z = 0; z < imFilter.channels(); z++) {
         for (int y = 0; y < imFilter.height(); y++) {
+            int x0 = 0, x1 = 0; // the span done with row pointers
+            if (y >= yIn0 && y < yIn1 && xIn0 < xIn1) {
+                x0 = max(xIn0, 0);
+                x1 = xIn1;
+                fill(rowAccum.begin() + x0, rowAccum.begin() + x1, 0.0f);
+                for (int yFilter=0; yFilter<height; yFilter++) {
+                    for (int xFilter=0; xFilter<width; xFilter++) {
+                        float k = kernel[xFilter + yFilter*width];
+                        const float *src = im.row(y-yFilter+sideH, z) + (x0 + sideW - xFilter);
+                        float *acc = rowAccum.data() + x0;
+                        for (int x = 0; x < x1 - x0; x++)
+                            acc[x] += k * src[x];
+                    }
+                }
+                copy(rowAccum.begin() + x0, rowAccum.begin() + x1, imFilter.row(y, z) + x0);
+            }
             for (int x = 0; x < imFilter.width(); x++) {
+                if (x >= x0 && x < x1)
+                    continue;
                 accum = 0.0;
                 for (int yFilter=0; yFilter<height; yFilter++) {
                     for (int xFilter=0; xFilter<width; xFilter++) {
                         // Sum the image pixel values weighted by the filter
                         // flipped kernel, xFilter, yFilter have different signs in filter
                         // and im
-                        accum += operator()(xFilter, yFilter) *
+                        accum += kernel[xFilter + yFilter*width] *
                             im.smartAccessor(x-xFilter+sideW,y-yFilter+sideH,z,clamp);
                     }
                 }
                 // Assign the pixel the value from convolution
-                imFilter(x,y,z) = accum;
+                imFilter.at(x,y,z) = accum;
            }
         }
     }
     return imFilter;
 }
 
-Image boxBlur_filterClass(const Image &im, int k, bool clamp) {
+Image boxBlur_filterClass(const ImageView &im, int k, bool clamp) {
     // --------- HANDOUT  PS02 ------------------------------
     // Reimplement the box filter using the filter class.
     // check that your results match those in the previous function "boxBlur"
@@ -95,7 +130,7 @@ Image boxBlur_filterClass(const Image &im, int k, bool clamp) {
 }
 
 
-Image gradientMagnitude(const Image &im, bool clamp){
+Image gradientMagnitude(const ImageView &im, bool clamp){
     // --------- HANDOUT  PS02 ------------------------------
     // Uses a Sobel kernel to compute the horizontal and vertical
     // components of the gradient of an image and returns the gradient magnitude.
@@ -154,7 +189,7 @@ vector<float> gauss1DFilterValues(float sigma, float truncate){
     return fData;
 }
 
-Image gaussianBlur_horizontal(const Image &im, float sigma, float truncate, bool clamp) {
+Image gaussianBlur_horizontal(const ImageView &im, float sigma, float truncate, bool clamp) {
     // --------- HANDOUT  PS02 ------------------------------
     // Gaussian blur across the rows of an image
     // return im;
@@ -202,7 +237,7 @@ vector<float> gauss2DFilterValues(float sigma, float truncate) {
 }
 
 
-Image gaussianBlur_2D(const Image &im, float sigma, float truncate, bool clamp) {
+Image gaussianBlur_2D(const ImageView &im, float sigma, float truncate, bool clamp) {
     // --------- HANDOUT  PS02 ------------------------------
     //  Blur an image with a full  full 2D rotationally symmetric Gaussian kernel
     // return im;
@@ -217,7 +252,7 @@ Image gaussianBlur_2D(const Image &im, float sigma, float truncate, bool clamp)
     return imFilter;
 }
 
-Image gaussianBlur_separable(const Image &im, float sigma, float truncate, bool clamp) {
+Image gaussianBlur_separable(const ImageView &im, float sigma, float truncate, bool clamp) {
     // --------- HANDOUT  PS02 ------------------------------
     // Use principles of seperabiltity to blur an image using 2 1D Gaussian Filters
     // return im;
@@ -234,7 +269,7 @@ Image gaussianBlur_separable(const Image &im, float sigma, float truncate, bool
 }
 
 
-Image unsharpMask(const Image &im,
+Image unsharpMask(const ImageView &im,
                   float sigma,
                   float truncate,
                   float strength,
@@ -255,7 +290,7 @@ Image unsharpMask(const Image &im,
 }
 
 
-Image bilateral(const Image &im,
+Image bilateral(const ImageView &im,
                 float sigmaRange,
                 float sigmaDomain,
                 float truncateDomain,
@@ -265,57 +300,84 @@ Image bilateral(const Image &im,
     // return im;
 
     // --------- SOLUTION PS02 ------------------------------
-    Image imFilter(im.width(), im.height(), im.channels());
+    Image imFilter(im.width(), im.height(), im.channels(), im.layout());
 
     // calculate the filter size
     int offset   = int(ceil(truncateDomain * sigmaDomain));
     int sizeFilt = 2*offset + 1;
-    float accum,
-          tmp,
+    int channels = imFilter.channels();
+    int s        = im.stride(2);
+    float tmp,
           range_dist,
           normalizer,
-          factorDomain,
           factorRange;
 
-    // for every pixel in the image
-    for (int z=0; z<imFilter.channels(); z++)
+    // the domain weights only depend on the offset
+    vector<float> factorDomain(sizeFilt*sizeFilt);
+    for (int yFilter=0; yFilter<sizeFilt; yFilter++)
+    for (int xFilter=0; xFilter<sizeFilt; xFilter++)
+        factorDomain[xFilter + yFilter*sizeFilt] = exp( - ((xFilter-offset)*(xFilter-offset) +  (yFilter-offset)*(yFilter-offset) )/ (2.0 * sigmaDomain*sigmaDomain ) );
+
+    // for every pixel in the image. The range distance and the weight of a
+    // neighbor are shared by all the channels, so they are computed once
+    // per pixel and every channel accumulated together. Neighbors are read
+    // through pixel pointers (stride(2) apart, adjacent when interleaved)
+    // when the whole support is inside the image.
+    vector<float> accum(channels), center(channels), neighbor(channels);
     for (int y=0; y<imFilter.height(); y++)
     for (int x=0; x<imFilter.width(); x++)
     {
+        bool inside = x - offset >= 0 && y - offset >= 0 &&
+                      x + offset < im.width() && y + offset < im.height();
+        for (int z=0; z<channels; z++)
+            center[z] = im.smartAccessor(x,y,z,clamp);
+
         // initilize normalizer and sum value to 0 for every pixel location
         normalizer = 0.0f;
-        accum      = 0.0f;
+        fill(accum.begin(), accum.end(), 0.0f);
 
         // sum over the filter's support
         for (int yFilter=0; yFilter<sizeFilt; yFilter++)
         for (int xFilter=0; xFilter<sizeFilt; xFilter++)
         {
+            int xn = x+xFilter-offset, yn = y+yFilter-offset;
+            if (inside) {
+                const float *p = im.pixel(xn, yn);
+                for (int z=0; z<channels; z++)
+                    neighbor[z] = p[z*s];
+            } else {
+                for (int z=0; z<channels; z++)
+                    neighbor[z] = im.smartAccessor(xn,yn,z,clamp);
+            }
+
             // calculate the distance between the 2 pixels (in range)
             range_dist = 0.0f; // |R-R1|^2 + |G-G1|^2 + |B-B1|^2
-            for (int z1 = 0; z1 < imFilter.channels(); z1++) {
-                tmp  = im.smartAccessor(x,y,z1,clamp); // center pixel
-                tmp -= im.smartAccessor(x+xFilter-offset,y+yFilter-offset,z1,clamp); // neighbor
+            for (int z1 = 0; z1 < channels; z1++) {
+                tmp  = center[z1]; // center pixel
+                tmp -= neighbor[z1]; // neighbor
                 tmp *= tmp; // square
                 range_dist += tmp;
             }
 
             // calculate the exponential weight from the domain and range
-            factorDomain = exp( - ((xFilter-offset)*(xFilter-offset) +  (yFilter-offset)*(yFilter-offset) )/ (2.0 * sigmaDomain*sigmaDomain ) );
             factorRange  = exp( - range_dist / (2.0 * sigmaRange*sigmaRange) );
+            float weight = factorDomain[xFilter + yFilter*sizeFilt] * factorRange;
 
-            normalizer += factorDomain * factorRange;
-            accum += factorDomain * factorRange * im.smartAccessor(x+xFilter-offset,y+yFilter-offset,z,clamp);
+            normalizer += weight;
+            for (int z=0; z<channels; z++)
+                accum[z] += weight * neighbor[z];
         }
 
         // set pixel in filtered image to weighted sum of values in the filter region
-        imFilter(x,y,z) = accum/normalizer;
+        for (int z=0; z<channels; z++)
+            imFilter.at(x,y,z) = accum[z]/normalizer;
     }
 
     return imFilter;
 }
 
 
-Image bilaYUV(const Image &im, float sigmaRange, float sigmaY, float sigmaUV, float truncateDomain, bool clamp){
+Image bilaYUV(const ImageView &im, float sigmaRange, float sigmaY, float sigmaUV, float truncateDomain, bool clamp){
     // --------- HANDOUT  PS02 ------------------------------
     // 6.865 only
     // Bilaterial Filter an image seperatly for
@@ -331,17 +393,11 @@ Image bilaYUV(const Image &im, float sigmaRange, float sigmaY, float sigmaUV, fl
     Image bilY  = bilateral(imYUV, sigmaRange, sigmaY, truncateDomain, clamp);
     Image bilUV = bilateral(imYUV, sigmaRange, sigmaUV, truncateDomain, clamp);
 
-    // put the Y and UV parts of the image back into one image
-    for(int i=0; i<im.width(); i++) {
-        for(int j=0; j<im.height(); j++) {
-            imYUV(i,j,0) = bilY(i,j,0);
-            imYUV(i,j,1) = bilUV(i,j,1);
-            imYUV(i,j,2) = bilUV(i,j,2);
-        }
-    }
+    // take the Y channel of bilY, the UV ones of bilUV
+    copyValues(ImageView(bilY).channel(0), MutableImageView(bilUV).channel(0));
 
     // convert from YUV back to RGB
-    Image bilRGB = yuv2rgb(imYUV);
+    Image bilRGB = yuv2rgb(bilUV);
     return bilRGB;
 }
 
@@ -402,7 +458,7 @@ float & Filter::operator()(int x, int y) {
 // --------- END FILTER CLASS -----------------------
 
 // --------- HANDOUT  PS07 ------------------------------
-Image gradientX(const Image &im, bool clamp){
+Image gradientX(const ImageView &im, bool clamp){
     Filter sobelX(3, 3);
     sobelX(0,0) = -1.0; sobelX(1,0) = 0.0; sobelX(2,0) = 1.0;
     sobelX(0,1) = -2.0; sobelX(1,1) = 0.0; sobelX(2,1) = 2.0;
@@ -413,7 +469,7 @@ Image gradientX(const Image &im, bool clamp){
 }
 
 
-Image gradientY(const Image &im, bool clamp) {
+Image gradientY(const ImageView &im, bool clamp) {
 
     // sobel filtering in y direction
     Filter sobelY(3, 3);
@@ -426,7 +482,7 @@ Image gradientY(const Image &im, bool clamp) {
     return imSobelY;
 }
 
-Image maximum_filter(const Image &im, float maxiDiam) {
+Image maximum_filter(const ImageView &im, float maxiDiam) {
     float mi = floor((maxiDiam) / 2);
     float ma = maxiDiam - mi - 1;
 
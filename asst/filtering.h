@@ -19,6 +19,10 @@
 
 using namespace std;
 
+// The filters read their input through an ImageView (see Image.h), so they
+// also run on crops and single channels of an image without copying them.
+// Pixels outside the view are handled like those outside an image.
+
 // --------- HANDOUT  PS02 ------------------------------
 class Filter {
 public:
@@ -30,7 +34,7 @@ public:
     ~Filter();
 
     // function to convolve your filter with an image
-    Image convolve(const Image &im, bool clamp = true);
+    Image convolve(const ImageView &im, bool clamp = true);
 
     // Accessors of the filter values
     const float & operator()(int x, int y) const;
@@ -44,42 +48,42 @@ private:
 };
 
 // Box Blurring
-Image boxBlur(const Image &im, int k, bool clamp = true);
-Image boxBlur_filterClass(const Image &im, int k, bool clamp = true);
+Image boxBlur(const ImageView &im, int k, bool clamp = true);
+Image boxBlur_filterClass(const ImageView &im, int k, bool clamp = true);
 
 // Gradient Filter
-Image gradientMagnitude(const Image &im, bool clamp = true);
+Image gradientMagnitude(const ImageView &im, bool clamp = true);
 
 // Gaussian Blurring
 vector<float> gauss1DFilterValues(float sigma, float truncate);
 vector<float> gauss2DFilterValues(float sigma, float truncate);
-Image gaussianBlur_horizontal(const Image &im,
+Image gaussianBlur_horizontal(const ImageView &im,
                               float sigma,
                               float truncate = 3.0,
                               bool clamp = true);
-Image gaussianBlur_separable(const Image &im,
+Image gaussianBlur_separable(const ImageView &im,
                              float sigma,
                              float truncate = 3.0,
                              bool clamp = true);
-Image gaussianBlur_2D(const Image &im,
+Image gaussianBlur_2D(const ImageView &im,
                       float sigma,
                       float truncate = 3.0,
                       bool clamp = true);
 
 // Sharpen an Image
-Image unsharpMask(const Image &im,
+Image unsharpMask(const ImageView &im,
                   float sigma,
                   float truncate = 3.0,
                   float strength = 1.0,
                   bool clamp = true);
 
 // Bilaterial Filtering
-Image bilateral(const Image &im,
+Image bilateral(const ImageView &im,
                 float sigmaRange = 0.1,
                 float sigmaDomain = 1.0,
                 float truncateDomain = 3.0,
                 bool clamp = true);
-Image bilaYUV(const Image &im,
+Image bilaYUV(const ImageView &im,
               float sigmaRange = 0.1,
               float sigmaY = 1.0,
               float sigmaUV = 4.0,
@@ -93,9 +97,9 @@ Image impulseImg(int k);
 
 
 // --------- HANDOUT PS07 ------------------------------
-Image maximum_filter(const Image &im, float maxiDiam);
-Image gradientX(const Image &im, bool clamp = true);
-Image gradientY(const Image &im, bool clamp = true);
+Image maximum_filter(const ImageView &im, float maxiDiam);
+Image gradientX(const ImageView &im, bool clamp = true);
+Image gradientY(const ImageView &im, bool clamp = true);
 // ------------------------------------------------------
 
 #endif
@@ -0,0 +1,140 @@
+/* --------------------------------------------------------------------------
+ * File:    fixedCanvas.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Reduced precision (8 or 16 bit fixed point) canvases for compositing
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "fixedCanvas.h"
+#include "blendKernel.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// color scaled so that 1 is one, clamped to 0..maximum
+uint16_t quantizeColor(float color, int one, int maximum) {
+    float q = color * one + 0.5f;
+    return static_cast<uint16_t>(q <= 0.0f ? 0 : q >= maximum ? maximum : q);
+}
+
+}
+
+const char * canvasPrecisionName(CanvasPrecision precision) {
+    switch (precision) {
+    case CANVAS_UINT16: return "uint16";
+    case CANVAS_UINT8:  return "uint8";
+    default:            return "float32";
+    }
+}
+
+FixedCanvas::FixedCanvas(int width, int height, CanvasPrecision precision)
+  : width_(width), height_(height), precision_(precision)
+{
+    if (width < 0 || height < 0)
+        throw NegativeDimensionException();
+    size_t size = static_cast<size_t>(width) * height * 3;
+    if (precision == CANVAS_UINT8)
+        data8.assign(size, 0);
+    else if (precision == CANVAS_UINT16)
+        data16.assign(size, 0);
+    else
+        throw InvalidArgument();
+}
+
+void FixedCanvas::quantize(const float color[3], uint16_t stored[3]) const {
+    // [0, 1] on the 8 bit canvas, with the 7 bits of a FixedTile below its
+    // values; [0, 2) on the 16 bit one
+    int scale = precision_ == CANVAS_UINT8 ? one() << 7 : one();
+    int maximum = precision_ == CANVAS_UINT8 ? one() << 7 : 65535;
+    for (int c = 0; c < 3; ++c)
+        stored[c] = quantizeColor(color[c], scale, maximum);
+}
+
+void FixedCanvas::blendRow(int x, int y, const uint16_t *opacity, const float color[3], int n) {
+    uint16_t stored[3];
+    quantize(color, stored);
+    blendRow(x, y, opacity, stored, n);
+}
+
+void FixedCanvas::blendRow(int x, int y, const uint16_t *opacity, const uint16_t stored[3], int n) {
+    if (n <= 0)
+        return;
+    FixedTile tile(*this, x, y, x + n, y + 1);
+    tile.blendRow(x, y, opacity, stored, n);
+    tile.store();
+}
+
+Image FixedCanvas::toImage() const {
+    Image out(width_, height_, 3);
+    float scale = 1.0f / one();
+    for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < height_; ++y) {
+            float *row = out.row(y, c);
+            size_t start = static_cast<size_t>(y) * width_ + static_cast<size_t>(c) * width_ * height_;
+            if (precision_ == CANVAS_UINT8)
+                for (int x = 0; x < width_; ++x)
+                    row[x] = data8[start + x] * scale;
+            else
+                for (int x = 0; x < width_; ++x)
+                    row[x] = data16[start + x] * scale;
+        }
+    }
+    return out;
+}
+
+FixedTile::FixedTile(FixedCanvas &canvas, int x0, int y0, int x1, int y1)
+  : canvas(canvas), x0(x0), y0(y0), w(x1 - x0), h(y1 - y0)
+{
+    if (x0 < 0 || y0 < 0 || x1 > canvas.width() || y1 > canvas.height() || w < 0 || h < 0)
+        throw OutOfBoundsException();
+    if (canvas.precision() != CANVAS_UINT8)
+        return;
+    scaled.resize(static_cast<size_t>(w) * h * 3);
+    if (scaled.empty())
+        return;
+    size_t plane = static_cast<size_t>(canvas.width()) * canvas.height();
+    for (int c = 0; c < 3; ++c)
+        for (int y = 0; y < h; ++y) {
+            const uint8_t *in = &canvas.data8[c * plane + static_cast<size_t>(y0 + y) * canvas.width() + x0];
+            int16_t *out = &scaled[(static_cast<size_t>(c) * h + y) * w];
+            for (int x = 0; x < w; ++x)
+                out[x] = static_cast<int16_t>(in[x] << 7);
+        }
+}
+
+void FixedTile::blendRow(int x, int y, const uint16_t *opacity, const uint16_t stored[3], int n) {
+    if (n <= 0)
+        return;
+    if (canvas.precision() == CANVAS_UINT8) {
+        size_t start = static_cast<size_t>(y - y0) * w + (x - x0);
+        size_t plane = static_cast<size_t>(w) * h;
+        int16_t *planes[3] = {&scaled[start], &scaled[start + plane], &scaled[start + 2 * plane]};
+        int16_t color[3] = {static_cast<int16_t>(stored[0]), static_cast<int16_t>(stored[1]),
+                            static_cast<int16_t>(stored[2])};
+        blendRowFixed8(planes, opacity, color, n);
+    } else {
+        size_t plane = static_cast<size_t>(canvas.width()) * canvas.height();
+        size_t start = x + static_cast<size_t>(y) * canvas.width();
+        uint16_t *data = canvas.data16.data();
+        uint16_t *planes[3] = {data + start, data + start + plane, data + start + 2 * plane};
+        blendRowFixed16(planes, opacity, stored, n);
+    }
+}
+
+void FixedTile::store() {
+    if (scaled.empty())
+        return;
+    size_t plane = static_cast<size_t>(canvas.width()) * canvas.height();
+    for (int c = 0; c < 3; ++c)
+        for (int y = 0; y < h; ++y) {
+            const int16_t *in = &scaled[(static_cast<size_t>(c) * h + y) * w];
+            uint8_t *out = &canvas.data8[c * plane + static_cast<size_t>(y0 + y) * canvas.width() + x0];
+            for (int x = 0; x < w; ++x)
+                out[x] = static_cast<uint8_t>((in[x] + 64) >> 7);
+        }
+}
@@ -0,0 +1,104 @@
+/* --------------------------------------------------------------------------
+ * File:    fixedCanvas.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Reduced precision (8 or 16 bit fixed point) canvases for compositing
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __fixedCanvas__h
+#define __fixedCanvas__h
+
+#include "Image.h"
+#include <cstdint>
+#include <vector>
+
+// Storage of the canvas strokes are composited into
+enum CanvasPrecision {
+    CANVAS_FLOAT32,   // an Image, the reference
+    CANVAS_UINT16,    // 2 bytes per channel, 1.0 is 32767: colors up to 2 fit
+    CANVAS_UINT8      // 1 byte per channel, 1.0 is 255: colors are clamped to [0, 1]
+};
+
+const char * canvasPrecisionName(CanvasPrecision precision);
+
+// Brush opacities are stored in Q15: 0..1 maps to 0..opacity_one
+const int opacity_one = 1 << 15;
+
+// Quantizes an opacity in [0, 1] (clamped) to Q15
+inline uint16_t quantizeOpacity(float opacity) {
+    float q = opacity * opacity_one + 0.5f;
+    return static_cast<uint16_t>(q <= 0.0f ? 0 : q >= opacity_one ? opacity_one : q);
+}
+
+// A planar 3 channel canvas holding each channel value as an unsigned
+// integer of 8 or 16 bits. Like the float canvas it stores straight colors,
+// not premultiplied ones: a stroke moves each channel toward its color by
+// the brush opacity, the same rule as brush(), in integer arithmetic with
+// rounding:
+//     out += ((color - out) * opacity + half) >> shift
+// The paint modes sample colors in [0, 1] (see StrokeRandom::modulate).
+// The 16 bit canvas keeps one bit of headroom for plans made elsewhere and
+// clamps colors to [0, 2); the 8 bit canvas spends all its bits on [0, 1]
+// and clamps colors there, as the PNG output does anyway. The canvas takes
+// 1 or 2 bytes per channel and the opacities 2 instead of 4 and 4.
+class FixedCanvas {
+public:
+    // precision must be CANVAS_UINT16 or CANVAS_UINT8. Starts black.
+    FixedCanvas(int width, int height, CanvasPrecision precision);
+
+    int width()  const { return width_; }
+    int height() const { return height_; }
+    CanvasPrecision precision() const { return precision_; }
+    // Stored value of 1.0
+    int one() const { return precision_ == CANVAS_UINT8 ? 255 : 32767; }
+
+    // color as blendRow takes it, clamped to what the canvas holds: stored
+    // values, with the 7 more bits of a FixedTile on the 8 bit canvas
+    void quantize(const float color[3], uint16_t stored[3]) const;
+
+    // For every channel and every i < n, blends color over pixel (x + i, y)
+    // with the Q15 opacity[i]. The row must lie inside the canvas. On the
+    // 8 bit canvas every call rounds the row to 8 bits: strokes that blend
+    // many rows should go through a FixedTile.
+    void blendRow(int x, int y, const uint16_t *opacity, const float color[3], int n);
+    // Same with a color already quantized
+    void blendRow(int x, int y, const uint16_t *opacity, const uint16_t stored[3], int n);
+
+    // The canvas as a float image
+    Image toImage() const;
+
+private:
+    friend class FixedTile;
+
+    int width_;
+    int height_;
+    CanvasPrecision precision_;
+    std::vector<uint8_t> data8;     // CANVAS_UINT8
+    std::vector<uint16_t> data16;   // CANVAS_UINT16
+};
+
+// The rectangle [x0, x1) x [y0, y1) of a FixedCanvas, for blending many
+// strokes into it. The 8 bit canvas is blended on a copy that keeps 7 bits
+// below each value and is rounded back to 8 bits by store(), once for all
+// the strokes: rounding after each one leaves the pixels that brush edges
+// move by less than half a step where they are, and they drift up to 2/255
+// from the float canvas. The 16 bit canvas is blended in place.
+class FixedTile {
+public:
+    FixedTile(FixedCanvas &canvas, int x0, int y0, int x1, int y1);
+
+    // FixedCanvas::blendRow, for a row inside the rectangle
+    void blendRow(int x, int y, const uint16_t *opacity, const uint16_t stored[3], int n);
+    // Writes the blended values back to the canvas
+    void store();
+
+private:
+    FixedCanvas &canvas;
+    int x0, y0, w, h;
+    std::vector<int16_t> scaled;    // CANVAS_UINT8: 3 planes of w x h values times 128
+};
+
+#endif
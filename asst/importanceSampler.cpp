@@ -0,0 +1,116 @@
+/* --------------------------------------------------------------------------
+ * File:    importanceSampler.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Alias-table importance sampling of stroke positions
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "importanceSampler.h"
+#include "random.h"
+
+using namespace std;
+
+ImportanceSampler::ImportanceSampler(int width, int height)
+  : w(width), h(height), map_w(width), map_h(height), is_uniform(true),
+    total(static_cast<double>(width) * height)
+{}
+
+ImportanceSampler::ImportanceSampler(const ImageView &importance)
+  : ImportanceSampler(importance, importance.width(), importance.height())
+{}
+
+ImportanceSampler::ImportanceSampler(const ImageView &importance, int width, int height)
+  : w(width), h(height), map_w(importance.width()), map_h(importance.height()),
+    is_uniform(false), total(0.0)
+{
+    if (map_w > w || map_h > h)
+        throw MismatchedDimensionsException();
+
+    // a cell weighs its importance times the number of pixels it covers
+    int n = map_w * map_h;
+    vector<float> weight(n);
+    for (int y = 0; y < map_h; ++y) {
+        for (int x = 0; x < map_w; ++x) {
+            float area = static_cast<float>((cellX(x + 1) - cellX(x)) * (cellY(y + 1) - cellY(y)));
+            weight[x + y * map_w] = max(importance(x, y), 0.0f) * area;
+            total += weight[x + y * map_w];
+        }
+    }
+    if (total <= 0.0)
+        return;
+
+    // Vose's alias method: scale the weights so that they average to 1, then
+    // repeatedly pair an under-full cell with an over-full one.
+    vector<double> scaled(n);
+    vector<int> small, large;
+    for (int i = 0; i < n; ++i) {
+        scaled[i] = weight[i] * n / total;
+        if (scaled[i] < 1.0)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    prob.assign(n, 1.0f);
+    alias.resize(n);
+    for (int i = 0; i < n; ++i)
+        alias[i] = i;
+
+    while (!small.empty() && !large.empty()) {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+        prob[s] = static_cast<float>(scaled[s]);
+        alias[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // whatever is left is full up to rounding error: prob stays at 1
+}
+
+void ImportanceSampler::sample(const uint32_t u[4], int &x, int &y) const {
+    int i = StrokeRandom::toRange(u[0], map_w * map_h);
+    if (!is_uniform && StrokeRandom::toUniform(u[1]) >= prob[i])
+        i = alias[i];
+    x = i % map_w;
+    y = i / map_w;
+    if (map_w != w || map_h != h) {
+        x = cellX(x) + StrokeRandom::toRange(u[2], cellX(x + 1) - cellX(x));
+        y = cellY(y) + StrokeRandom::toRange(u[3], cellY(y + 1) - cellY(y));
+    }
+}
+
+Image ImportanceSampler::density() const {
+    Image d(w, h, 1);
+    if (empty())
+        return d;
+
+    // a cell is drawn when it is picked and kept, or when a cell it is the
+    // alias of is picked and not kept
+    int n = map_w * map_h;
+    vector<double> p(n, is_uniform ? 1.0 / n : 0.0);
+    if (!is_uniform) {
+        for (int i = 0; i < n; ++i) {
+            p[i] += prob[i] / static_cast<double>(n);
+            p[alias[i]] += (1.0 - prob[i]) / n;
+        }
+    }
+
+    // spread evenly over the pixels of the cell
+    for (int my = 0; my < map_h; ++my) {
+        for (int mx = 0; mx < map_w; ++mx) {
+            int area = (cellX(mx + 1) - cellX(mx)) * (cellY(my + 1) - cellY(my));
+            float value = static_cast<float>(p[mx + my * map_w] / area);
+            for (int y = cellY(my); y < cellY(my + 1); ++y)
+                for (int x = cellX(mx); x < cellX(mx + 1); ++x)
+                    d(x, y) = value;
+        }
+    }
+    return d;
+}
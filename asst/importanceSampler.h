@@ -0,0 +1,66 @@
+/* --------------------------------------------------------------------------
+ * File:    importanceSampler.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Alias-table importance sampling of stroke positions
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __importanceSampler__h
+#define __importanceSampler__h
+
+#include "Image.h"
+#include <cstdint>
+
+// Draws pixel positions with probability proportional to an importance map
+// (channel 0 of an image). The map is turned into a Walker/Vose alias table
+// once, in O(width*height); each draw then costs O(1) and never rejects.
+// The map may be coarser than the canvas it is drawn on: each map cell then
+// stands for a block of canvas pixels, and a draw picks a cell from the table
+// and a pixel uniformly inside its block.
+class ImportanceSampler {
+public:
+    // Uniform importance over a width x height image. No table is built.
+    ImportanceSampler(int width, int height);
+
+    // Importance proportional to channel 0 of importance. Negative values
+    // are treated as zero.
+    explicit ImportanceSampler(const ImageView &importance);
+
+    // Same, with importance stretched over a width x height canvas (for
+    // instance a pyramid level of the image being painted)
+    ImportanceSampler(const ImageView &importance, int width, int height);
+
+    int width()  const { return w; }
+    int height() const { return h; }
+    bool uniform() const { return is_uniform; }
+
+    // True when the importance is zero everywhere (nothing can be drawn)
+    bool empty() const { return total <= 0.0; }
+
+    // Maps four random 32-bit words to a pixel (x, y) of the canvas. u[0]
+    // and u[1] pick the map cell, u[2] and u[3] the pixel inside the cell.
+    void sample(const uint32_t u[4], int &x, int &y) const;
+
+    // Probability that sample() draws each pixel of the canvas, as a single
+    // channel width x height image (zero everywhere if empty())
+    Image density() const;
+
+private:
+    int w;                     // canvas size
+    int h;
+    int map_w;                 // importance map size
+    int map_h;
+    bool is_uniform;
+    double total;              // sum of the importance
+    std::vector<float> prob;   // probability of keeping cell i
+    std::vector<int> alias;    // cell drawn instead of i otherwise
+
+    // first canvas column (row) covered by map column (row) i
+    int cellX(int i) const { return static_cast<int>(static_cast<long long>(i) * w / map_w); }
+    int cellY(int i) const { return static_cast<int>(static_cast<long long>(i) * h / map_h); }
+};
+
+#endif
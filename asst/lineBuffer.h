@@ -0,0 +1,81 @@
+/* --------------------------------------------------------------------------
+ * File:    lineBuffer.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Row buffers and row kernels shared by the streaming analysis stages
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __lineBuffer__h
+#define __lineBuffer__h
+
+#include "Image.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Row y of an image of the given height with its border repeated
+inline int clampRow(int y, int height) {
+    return std::min(std::max(y, 0), height - 1);
+}
+
+// The last rows of one stage of a pipeline, row k in slot k % rows. A
+// stage that produces its rows in order and whose reader needs at most
+// rows of them at a time never overwrites one still in use.
+class RowRing {
+public:
+    RowRing(int rows, int width)
+      : n(rows), w(width), data(static_cast<size_t>(rows) * width) {}
+    float * row(int k) { return &data[static_cast<size_t>(k % n) * w]; }
+private:
+    int n;
+    int w;
+    std::vector<float> data;
+};
+
+// out[x] = sum_j kernel[j] in[x + j - r] over an odd kernel of radius r,
+// reading in clamped to [0, w) if clamp and as 0 outside it otherwise,
+// like Filter::convolve. padded is scratch space for w + 2r floats.
+inline void blurRow(const float *in, float *out, int w, const std::vector<float> &kernel,
+                    float *padded, bool clamp = true) {
+    int r = static_cast<int>(kernel.size()) / 2;
+    for (int x = 0; x < w + 2 * r; ++x) {
+        int i = x - r;
+        padded[x] = i >= 0 && i < w ? in[i] : clamp ? in[std::min(std::max(i, 0), w - 1)] : 0.0f;
+    }
+    std::fill(out, out + w, 0.0f);
+    for (size_t j = 0; j < kernel.size(); ++j) {
+        float k = kernel[j];
+        const float *p = padded + j;
+        for (int x = 0; x < w; ++x)
+            out[x] += k * p[x];
+    }
+}
+
+// out[x] = 0.299 r + 0.587 g + 0.114 b along row y of an RGB image in
+// either layout
+inline void luminanceRow(const Image &im, int y, float *out) {
+    int w = im.width();
+    if (w <= 0)
+        return;
+    if (im.stride(0) == 1) {
+        const float *r = im.row(y, 0), *g = im.row(y, 1), *b = im.row(y, 2);
+        for (int x = 0; x < w; ++x)
+            out[x] = r[x] * 0.299f + g[x] * 0.587f + b[x] * 0.114f;
+    } else {
+        const float *p = im.pixel(0, y);
+        int step = im.stride(0), s = im.stride(2);
+        for (int x = 0; x < w; ++x, p += step)
+            out[x] = p[0] * 0.299f + p[s] * 0.587f + p[2 * s] * 0.114f;
+    }
+}
+
+// out[x] += weight * in[x]
+inline void accumulateRow(const float *in, float weight, float *out, int w) {
+    for (int x = 0; x < w; ++x)
+        out[x] += weight * in[x];
+}
+
+#endif
@@ -0,0 +1,95 @@
+/* --------------------------------------------------------------------------
+ * File:    parallel.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Minimal thread helpers shared by the rasterizer and the analysis stages
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __parallel__h
+#define __parallel__h
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// When positive, the number of threads defaultThreadCount() returns instead
+// of one per core, e.g. to check that a result does not depend on it
+inline int & threadCountOverride() {
+    static int n = 0;
+    return n;
+}
+
+// Number of worker threads used when a caller asks for 0 threads
+inline int defaultThreadCount() {
+    if (threadCountOverride() > 0)
+        return threadCountOverride();
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+// True on threads that are running the body of a multithreaded parallelFor
+inline bool & insideParallelFor() {
+    static thread_local bool inside = false;
+    return inside;
+}
+
+// Calls f(i) for every i in [begin, end) on up to numThreads threads
+// (0 means one per core). Indices are handed out one at a time, so the
+// work per index may vary. The first exception thrown by f is rethrown on
+// the calling thread once every worker has stopped. A parallelFor called
+// from the body of a multithreaded one runs on the calling thread only, so
+// that running jobs side by side does not multiply the number of threads.
+template <typename F>
+void parallelFor(int begin, int end, F f, int numThreads = 0) {
+    if (end <= begin)
+        return;
+    if (insideParallelFor())
+        numThreads = 1;
+    if (numThreads <= 0)
+        numThreads = defaultThreadCount();
+    numThreads = std::min(numThreads, end - begin);
+
+    if (numThreads == 1) {
+        for (int i = begin; i < end; ++i)
+            f(i);
+        return;
+    }
+
+    std::atomic<int> next(begin);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        bool &inside = insideParallelFor();
+        bool was_inside = inside;
+        inside = true;
+        try {
+            for (int i = next++; i < end; i = next++)
+                f(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next = end; // stop handing out work
+        }
+        inside = was_inside;
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; ++t)
+        threads.push_back(std::thread(worker));
+    worker();
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+#endif
@@ -0,0 +1,105 @@
+/* --------------------------------------------------------------------------
+ * File:    progressive.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Time-budgeted rendering that reports intermediate frames
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "progressive.h"
+#include "strokeRasterizer.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// Without strokesPerFrame, the budget is still checked this often
+const int budget_chunk = 2048;
+
+}
+
+ProgressiveRenderer::ProgressiveRenderer(int width, int height, const Image &texture_,
+                                         const RenderControl &control_)
+  : out(width, height, 3), texture(texture_), control(control_),
+    start(chrono::steady_clock::now()), num_strokes(0), last_layer(0),
+    is_stopped(false), is_finished(false)
+{
+    if (control.timeBudget < 0.0 || control.strokesPerFrame < 0)
+        throw InvalidArgument();
+}
+
+double ProgressiveRenderer::seconds() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+bool ProgressiveRenderer::outOfTime() const {
+    return control.timeBudget > 0.0 && seconds() >= control.timeBudget;
+}
+
+bool ProgressiveRenderer::frame(bool layerDone, bool complete) {
+    if (!control.onFrame)
+        return true;
+    RenderProgress progress = {num_strokes, last_layer, seconds(), layerDone, complete};
+    return control.onFrame(out, progress);
+}
+
+bool ProgressiveRenderer::render(const StrokePlan &plan) {
+    if (is_stopped)
+        return false;
+    if (is_finished)
+        throw runtime_error("ProgressiveRenderer: render() called after finish()");
+    if (plan.width != out.width() || plan.height != out.height())
+        throw MismatchedDimensionsException();
+
+    int chunk = control.strokesPerFrame > 0 ? control.strokesPerFrame : budget_chunk;
+    int begin = 0;
+    while (begin < plan.count()) {
+        if (outOfTime()) {
+            // show whatever was painted, then give up
+            is_stopped = true;
+            frame(false, false);
+            return false;
+        }
+
+        // never let a chunk cross a layer boundary, so that layer ends are
+        // reported as soon as they are painted
+        int end = min(begin + chunk, plan.count());
+        int layer = plan.layer[begin];
+        int layer_end = begin;
+        while (layer_end < end && plan.layer[layer_end] == layer)
+            ++layer_end;
+        end = layer_end;
+
+        rasterizeRange(out, plan, texture, begin, end);
+        num_strokes += end - begin;
+        last_layer = layer;
+        begin = end;
+
+        bool layer_done = begin == plan.count() || plan.layer[begin] != layer;
+        if ((layer_done || control.strokesPerFrame > 0) && !frame(layer_done, false)) {
+            is_stopped = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ProgressiveRenderer::finish() {
+    if (is_stopped || is_finished)
+        return;
+    is_finished = true;
+    frame(true, true);
+}
+
+Image renderProgressive(const StrokePlan &plan,
+                        const Image &texture,
+                        const RenderControl &control)
+{
+    ProgressiveRenderer renderer(plan.width, plan.height, texture, control);
+    renderer.render(plan);
+    renderer.finish();
+    return renderer.canvas();
+}
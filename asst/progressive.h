@@ -0,0 +1,83 @@
+/* --------------------------------------------------------------------------
+ * File:    progressive.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Time-budgeted rendering that reports intermediate frames
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __progressive__h
+#define __progressive__h
+
+#include "Image.h"
+#include "strokePlan.h"
+#include <chrono>
+#include <functional>
+
+// State of a progressive render when a frame is reported
+struct RenderProgress {
+    int strokes;       // strokes painted so far
+    int layer;         // layer of the last painted stroke
+    double seconds;    // time since the render started
+    bool layerDone;    // the frame ends a layer
+    bool complete;     // every stroke was painted (last frame)
+};
+
+// Called with the canvas after each layer, every strokesPerFrame strokes,
+// when the time budget runs out and once more, marked complete, by finish().
+// Returning false stops the render.
+typedef std::function<bool(const Image &canvas, const RenderProgress &progress)> FrameCallback;
+
+struct RenderControl {
+    RenderControl() : timeBudget(0.0), strokesPerFrame(0) {}
+
+    double timeBudget;       // seconds, 0 for no limit
+    int strokesPerFrame;     // 0 only reports a frame at the end of each layer
+    FrameCallback onFrame;   // may be empty
+};
+
+// Paints stroke plans one after the other on a black canvas, in chunks, and
+// stops as soon as the time budget runs out or the callback returns false.
+// The clock starts when the renderer is created, so the time spent sampling
+// the plans of later layers counts against the budget. Strokes are always
+// painted whole and in plan order: a render that is not stopped gives the
+// same image as renderStrokePlan.
+class ProgressiveRenderer {
+public:
+    ProgressiveRenderer(int width, int height, const Image &texture,
+                        const RenderControl &control = RenderControl());
+
+    // Paints plan (which may hold several layers). Returns false if the
+    // render stopped before the end of plan; later calls then do nothing.
+    bool render(const StrokePlan &plan);
+
+    // Reports the last frame as complete. Call it after the last plan.
+    void finish();
+
+    bool stopped() const { return is_stopped; }
+    int strokes() const { return num_strokes; }
+    double seconds() const;
+    const Image & canvas() const { return out; }
+
+private:
+    Image out;
+    const Image &texture;
+    RenderControl control;
+    std::chrono::steady_clock::time_point start;
+    int num_strokes;
+    int last_layer;
+    bool is_stopped;
+    bool is_finished;
+
+    bool outOfTime() const;
+    bool frame(bool layerDone, bool complete);
+};
+
+// Renders plan with a ProgressiveRenderer and returns the final canvas
+Image renderProgressive(const StrokePlan &plan,
+                        const Image &texture,
+                        const RenderControl &control);
+
+#endif
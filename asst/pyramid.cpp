@@ -0,0 +1,90 @@
+/* --------------------------------------------------------------------------
+ * File:    pyramid.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Gaussian pyramid of the luminance, shared by the multi-scale analysis
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "pyramid.h"
+#include "basicImageManipulation.h"
+#include "sharpness.h"
+#include <algorithm>
+
+using namespace std;
+
+LuminancePyramid::LuminancePyramid(const Image &im, int numLevels)
+{
+    if (numLevels < 1)
+        throw InvalidArgument();
+
+    levels.push_back(color2gray(im));
+    while (static_cast<int>(levels.size()) < numLevels &&
+           levels.back().width() >= 16 && levels.back().height() >= 16)
+    {
+        levels.push_back(reduce(levels.back()));
+    }
+}
+
+const Image & LuminancePyramid::level(int l) const {
+    if (l < 0 || l >= numLevels())
+        throw OutOfBoundsException();
+    return levels[l];
+}
+
+int LuminancePyramid::levelFor(int brushSize, float sigma, int minCells) const {
+    int l = 0;
+    while (l + 1 < numLevels() &&
+           (brushSize >> (l + 1)) >= minCells &&
+           sigma / (1 << (l + 1)) >= 0.5f)
+    {
+        ++l;
+    }
+    return l;
+}
+
+Image LuminancePyramid::reduce(const Image &im) {
+    static const float k[5] = {1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16};
+    int w = im.width(), h = im.height();
+    int ow = (w + 1) / 2, oh = (h + 1) / 2;
+
+    // horizontal filter, keeping every other column
+    Image tmp(ow, h, 1);
+    for (int y = 0; y < h; ++y) {
+        const float *in = im.row(y);
+        float *out = tmp.row(y);
+        for (int x = 0; x < ow; ++x) {
+            float sum = 0.0f;
+            for (int i = 0; i < 5; ++i)
+                sum += k[i] * in[min(max(2 * x + i - 2, 0), w - 1)];
+            out[x] = sum;
+        }
+    }
+
+    // vertical filter, keeping every other row
+    Image reduced(ow, oh, 1);
+    for (int y = 0; y < oh; ++y) {
+        const float *in[5];
+        for (int i = 0; i < 5; ++i)
+            in[i] = tmp.row(min(max(2 * y + i - 2, 0), h - 1));
+        float *out = reduced.row(y);
+        for (int x = 0; x < ow; ++x) {
+            float sum = 0.0f;
+            for (int i = 0; i < 5; ++i)
+                sum += k[i] * in[i][x];
+            out[x] = sum;
+        }
+    }
+    return reduced;
+}
+
+Image LuminancePyramid::sharpness(int l, float sigma, float truncate, bool clamp) const {
+    // same steps as sharpnessMap(), on a smaller image with a smaller sigma
+    return highPassEnergy(level(l), sigma / (1 << l), truncate, clamp, true);
+}
+
+Image LuminancePyramid::energy(int l, float sigma, float truncate, bool clamp) const {
+    return highPassEnergy(level(l), sigma / (1 << l), truncate, clamp, false);
+}
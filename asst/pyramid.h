@@ -0,0 +1,53 @@
+/* --------------------------------------------------------------------------
+ * File:    pyramid.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Gaussian pyramid of the luminance, shared by the multi-scale analysis
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __pyramid__h
+#define __pyramid__h
+
+#include "Image.h"
+
+// Level 0 is the luminance of the image (color2gray with its default
+// weights). Each further level is the previous one filtered with the 5-tap
+// binomial kernel [1 4 6 4 1]/16 (clamped at the borders) and decimated by
+// two, so level l has about 1/4^l of the pixels and a pixel spacing of 2^l
+// in level 0 pixels.
+class LuminancePyramid {
+public:
+    // Builds up to numLevels levels, stopping early once a side would drop
+    // below 8 pixels
+    LuminancePyramid(const Image &im, int numLevels = 4);
+
+    int numLevels() const { return static_cast<int>(levels.size()); }
+    const Image & level(int l) const;
+
+    // Width and height of the image the pyramid was built from
+    int width()  const { return levels[0].width(); }
+    int height() const { return levels[0].height(); }
+
+    // Coarsest level at which a brush of brushSize pixels still spans
+    // minCells pixels, and at which a blur of sigma (in level 0 pixels) is
+    // still at least half a pixel wide
+    int levelFor(int brushSize, float sigma, int minCells = 4) const;
+
+    // The sharpness map of sharpnessMap(im, sigma, truncate, clamp),
+    // computed on level l with every length divided by 2^l. The result is a
+    // single channel image at the resolution of level l, normalized to a
+    // maximum of 1. For l = 0 it is equal to sharpnessMap.
+    Image sharpness(int l, float sigma = 1.0f, float truncate = 4.0f, bool clamp = true) const;
+    // Same without the normalization, as sharpnessEnergy is to sharpnessMap
+    Image energy(int l, float sigma = 1.0f, float truncate = 4.0f, bool clamp = true) const;
+
+private:
+    std::vector<Image> levels;
+
+    static Image reduce(const Image &im);
+};
+
+#endif
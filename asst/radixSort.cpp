@@ -0,0 +1,74 @@
+/* --------------------------------------------------------------------------
+ * File:    radixSort.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Parallel LSD radix sort for ordering strokes by small integer keys
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "radixSort.h"
+#include "parallel.h"
+
+using namespace std;
+
+namespace {
+
+const int radix_bits = 8;
+const int radix_size = 1 << radix_bits;
+
+// Below this many keys per chunk, the thread start-up costs more than the pass
+const int min_chunk = 1 << 14;
+
+}
+
+vector<int> radixSortOrder(const vector<uint16_t> &keys, int numThreads)
+{
+    int n = static_cast<int>(keys.size());
+    if (numThreads <= 0)
+        numThreads = defaultThreadCount();
+    int chunks = max(1, min(numThreads, n / min_chunk));
+    int chunk_size = (n + chunks - 1) / chunks;
+
+    vector<int> order(n), scratch(n);
+    for (int i = 0; i < n; ++i)
+        order[i] = i;
+
+    // count[chunk][digit]: occurrences of digit in the chunk, then the output
+    // position of the first such key of the chunk
+    vector<vector<int>> count(chunks, vector<int>(radix_size));
+    for (int shift = 0; shift < 16; shift += radix_bits)
+    {
+        parallelFor(0, chunks, [&](int k) {
+            vector<int> &c = count[k];
+            fill(c.begin(), c.end(), 0);
+            int end = min(n, (k + 1) * chunk_size);
+            for (int i = k * chunk_size; i < end; ++i)
+                ++c[(keys[order[i]] >> shift) & (radix_size - 1)];
+        }, numThreads);
+
+        // digits in increasing order, and chunks in order within a digit,
+        // which is what keeps every pass stable
+        int offset = 0;
+        for (int d = 0; d < radix_size; ++d)
+        {
+            for (int k = 0; k < chunks; ++k)
+            {
+                int c = count[k][d];
+                count[k][d] = offset;
+                offset += c;
+            }
+        }
+
+        parallelFor(0, chunks, [&](int k) {
+            vector<int> &c = count[k];
+            int end = min(n, (k + 1) * chunk_size);
+            for (int i = k * chunk_size; i < end; ++i)
+                scratch[c[(keys[order[i]] >> shift) & (radix_size - 1)]++] = order[i];
+        }, numThreads);
+
+        order.swap(scratch);
+    }
+    return order;
+}
@@ -0,0 +1,24 @@
+/* --------------------------------------------------------------------------
+ * File:    radixSort.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Parallel LSD radix sort for ordering strokes by small integer keys
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __radixSort__h
+#define __radixSort__h
+
+#include <cstdint>
+#include <vector>
+
+// Returns the permutation that sorts keys in increasing order: keys[order[0]]
+// is the smallest key. The sort is stable, so equal keys keep their relative
+// order and the result does not depend on numThreads (0 means one thread per
+// core). It runs two 8-bit least significant digit passes, each split into
+// contiguous chunks that are counted and scattered in parallel.
+std::vector<int> radixSortOrder(const std::vector<uint16_t> &keys, int numThreads = 0);
+
+#endif
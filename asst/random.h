@@ -0,0 +1,72 @@
+/* --------------------------------------------------------------------------
+ * File:    random.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Stateless counter-based random numbers for stroke sampling
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __random__h
+#define __random__h
+
+#include <cstdint>
+
+// Philox4x32-10 from Salmon et al., "Parallel Random Numbers: As Easy as
+// 1, 2, 3" (SC 2011). Each call maps a 128-bit counter and a 64-bit key to
+// four independent 32-bit words without any hidden state, so the numbers
+// for a stroke depend only on (seed, layer, stroke index) and can be drawn
+// in any order, on any thread.
+class StrokeRandom {
+public:
+    StrokeRandom(uint32_t seed, uint32_t layer) {
+        key[0] = seed;
+        key[1] = layer;
+    }
+
+    // Four random words for the given stroke index. block selects another
+    // independent set of four words for the same stroke.
+    void words(uint64_t index, uint32_t block, uint32_t out[4]) const {
+        uint32_t ctr[4] = {static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), block, 0};
+        uint32_t k[2] = {key[0], key[1]};
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * ctr[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * ctr[2];
+            uint32_t next[4] = {
+                static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k[0],
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k[1],
+                static_cast<uint32_t>(p0)};
+            for (int i = 0; i < 4; ++i)
+                ctr[i] = next[i];
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        for (int i = 0; i < 4; ++i)
+            out[i] = ctr[i];
+    }
+
+    // Maps a random word to a float in [0, 1)
+    static float toUniform(uint32_t w) {
+        return static_cast<float>(w >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // A stroke color channel: value times a random factor in
+    // [1 - noise / 2, 1 + noise / 2), clamped to the [0, 1] the output
+    // images hold, so that no canvas has to keep colors above 1
+    static float modulate(float value, float noise, uint32_t w) {
+        float v = value * ((1.0f - (noise / 2.0f)) + (noise * toUniform(w)));
+        return v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+    }
+
+    // Maps a random word to an integer in [0, n)
+    static int toRange(uint32_t w, int n) {
+        return static_cast<int>((static_cast<uint64_t>(w) * static_cast<uint64_t>(n)) >> 32);
+    }
+
+private:
+    uint32_t key[2];
+};
+
+#endif
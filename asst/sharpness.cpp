@@ -0,0 +1,112 @@
+/* --------------------------------------------------------------------------
+ * File:    sharpness.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * High frequency energy of the luminance in one streaming pass
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "sharpness.h"
+#include "filtering.h"
+#include "lineBuffer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Output rows [y0, y1) of highPassEnergy, returning their maximum. The
+// stages, each pulling the rows it needs from the previous one in order:
+//   lumi: luminance rows, and their blur by sigma across the row
+//   energy: squared difference between a luminance row and its blur,
+//           blurred across the row by 4 sigma
+//   out: energy rows blurred down the columns
+float energyStrip(const Image &im, Image &out, int y0, int y1, bool clamp,
+                  const vector<float> &inner, const vector<float> &outer) {
+    int w = im.width(), h = im.height();
+    int r1 = static_cast<int>(inner.size()) / 2, r2 = static_cast<int>(outer.size()) / 2;
+
+    int first_energy = max(0, y0 - r2);
+    int first_lumi = max(0, first_energy - r1);
+
+    RowRing lumi(2 * r1 + 1, w), across(2 * r1 + 1, w), energy(2 * r2 + 1, w);
+    vector<float> padded(w + 2 * max(r1, r2)), blurred(w);
+    int next_lumi = first_lumi, next_energy = first_energy;
+
+    auto needLumi = [&](int k) {
+        for (; next_lumi <= k; ++next_lumi) {
+            float *l = lumi.row(next_lumi);
+            if (im.channels() >= 3) {
+                luminanceRow(im, next_lumi, l);
+            } else {
+                copy(im.row(next_lumi), im.row(next_lumi) + w, l);
+            }
+            blurRow(l, across.row(next_lumi), w, inner, padded.data(), clamp);
+        }
+    };
+    auto needEnergy = [&](int k) {
+        for (; next_energy <= k; ++next_energy) {
+            int y = next_energy;
+            needLumi(min(y + r1, h - 1));
+            fill(blurred.begin(), blurred.end(), 0.0f);
+            for (int j = -r1; j <= r1; ++j)
+                if (clamp || (y + j >= 0 && y + j < h))
+                    accumulateRow(across.row(clampRow(y + j, h)), inner[j + r1], blurred.data(), w);
+            const float *l = lumi.row(y);
+            for (int x = 0; x < w; ++x) {
+                float high = l[x] - blurred[x];
+                blurred[x] = high * high;
+            }
+            blurRow(blurred.data(), energy.row(y), w, outer, padded.data());
+        }
+    };
+
+    float peak = 0.0f;
+    for (int y = y0; y < y1; ++y) {
+        needEnergy(min(y + r2, h - 1));
+        float *o = out.row(y);
+        fill(o, o + w, 0.0f);
+        for (int j = -r2; j <= r2; ++j)
+            accumulateRow(energy.row(clampRow(y + j, h)), outer[j + r2], o, w);
+        for (int x = 0; x < w; ++x)
+            peak = max(peak, o[x]);
+    }
+    return peak;
+}
+
+}
+
+Image highPassEnergy(const Image &im, float sigma, float truncate, bool clamp, bool normalize,
+                     int numThreads) {
+    if (im.channels() != 1 && im.channels() < 3)
+        throw InvalidArgument();
+    vector<float> inner = gauss1DFilterValues(sigma, truncate);
+    vector<float> outer = gauss1DFilterValues(4.0f * sigma, 3.0f);
+    Image out(im.width(), im.height(), 1);
+
+    // as in structureTensor, strips are a few times taller than the halo
+    // of rows they recompute
+    int halo = static_cast<int>(inner.size() / 2 + outer.size() / 2);
+    if (numThreads <= 0)
+        numThreads = defaultThreadCount();
+    int strips = max(1, min(numThreads, im.height() / (4 * max(halo, 1))));
+    vector<float> peaks(strips);
+    parallelFor(0, strips, [&](int s) {
+        peaks[s] = energyStrip(im, out, im.height() * s / strips, im.height() * (s + 1) / strips,
+                               clamp, inner, outer);
+    }, numThreads);
+
+    float peak = *max_element(peaks.begin(), peaks.end());
+    if (normalize && peak > 0.0f) {
+        parallelFor(0, out.height(), [&](int y) {
+            float *o = out.row(y);
+            for (int x = 0; x < out.width(); ++x)
+                o[x] /= peak;
+        }, numThreads);
+    }
+    return out;
+}
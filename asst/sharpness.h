@@ -0,0 +1,32 @@
+/* --------------------------------------------------------------------------
+ * File:    sharpness.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * High frequency energy of the luminance in one streaming pass
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __sharpness__h
+#define __sharpness__h
+
+#include "Image.h"
+
+// Local energy of the luminance above the frequency cut by sigma: the
+// luminance minus its blur by sigma (truncated at truncate * sigma, borders
+// clamped or black as in Filter::convolve), squared, then blurred by
+// 4 * sigma. im is either RGB, reduced to luminance with the weights of
+// color2gray, or already a single channel luminance, such as a level of a
+// LuminancePyramid for a reduced resolution map. If normalize, the result
+// is divided by its maximum, which the final blur pass tracks as it goes.
+// Rows stream through line buffers in parallel strips, and the single
+// channel result is the only full image allocated.
+Image highPassEnergy(const Image &im,
+                     float sigma,
+                     float truncate,
+                     bool clamp,
+                     bool normalize,
+                     int numThreads = 0);
+
+#endif
@@ -0,0 +1,197 @@
+/* --------------------------------------------------------------------------
+ * File:    strokePlan.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Sampled brush strokes, independent of the brush texture and rasterizer
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "strokePlan.h"
+#include "ImageException.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+StrokePlan::StrokePlan(int width_, int height_, int numAngles_)
+  : width(width_), height(height_), numAngles(numAngles_)
+{
+    if (width_ < 0 || height_ < 0)
+        throw NegativeDimensionException();
+    // bins are stored on 8 bits
+    if (numAngles_ < 1 || numAngles_ > 256)
+        throw InvalidArgument();
+}
+
+void StrokePlan::reserve(int n) {
+    x.reserve(n);
+    y.reserve(n);
+    r.reserve(n);
+    g.reserve(n);
+    b.reserve(n);
+    bin.reserve(n);
+    size.reserve(n);
+    layer.reserve(n);
+}
+
+void StrokePlan::append(int x_, int y_, const float color[3], int bin_, int size_, int layer_) {
+    // bin, size and layer are stored on 8, 16 and 8 bits
+    if (bin_ < 0 || bin_ >= numAngles || size_ < 0 || size_ > 65535 || layer_ < 0 || layer_ > 255)
+        throw InvalidArgument();
+    x.push_back(x_);
+    y.push_back(y_);
+    r.push_back(color[0]);
+    g.push_back(color[1]);
+    b.push_back(color[2]);
+    bin.push_back(static_cast<uint8_t>(bin_));
+    size.push_back(static_cast<uint16_t>(size_));
+    layer.push_back(static_cast<uint8_t>(layer_));
+}
+
+void StrokePlan::append(const StrokePlan &other) {
+    if (other.width != width || other.height != height || other.numAngles != numAngles)
+        throw MismatchedDimensionsException();
+    x.insert(x.end(), other.x.begin(), other.x.end());
+    y.insert(y.end(), other.y.begin(), other.y.end());
+    r.insert(r.end(), other.r.begin(), other.r.end());
+    g.insert(g.end(), other.g.begin(), other.g.end());
+    b.insert(b.end(), other.b.begin(), other.b.end());
+    bin.insert(bin.end(), other.bin.begin(), other.bin.end());
+    size.insert(size.end(), other.size.begin(), other.size.end());
+    layer.insert(layer.end(), other.layer.begin(), other.layer.end());
+}
+
+namespace {
+
+template <typename T>
+void permuteArray(vector<T> &v, const vector<int> &order) {
+    vector<T> permuted(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        permuted[i] = v[order[i]];
+    v.swap(permuted);
+}
+
+}
+
+void StrokePlan::permute(const vector<int> &order) {
+    if (static_cast<int>(order.size()) != count())
+        throw MismatchedDimensionsException();
+    permuteArray(x, order);
+    permuteArray(y, order);
+    permuteArray(r, order);
+    permuteArray(g, order);
+    permuteArray(b, order);
+    permuteArray(bin, order);
+    permuteArray(size, order);
+    permuteArray(layer, order);
+}
+
+
+// ------------- SERIALIZATION ----------------------
+// Layout (native byte order, which is little endian on every platform we
+// render on):
+//   char[4]  "SPLN"
+//   uint32   version (1)
+//   int32    width, height, numAngles
+//   uint32   number of strokes n
+//   then each array in turn: x[n], y[n] (int32), r[n], g[n], b[n] (float),
+//   bin[n] (uint8), size[n] (uint16), layer[n] (uint8)
+// for 24 bytes per stroke.
+namespace {
+
+const char plan_magic[4] = {'S', 'P', 'L', 'N'};
+const uint32_t plan_version = 1;
+const long plan_header_bytes = 24;
+const long plan_stroke_bytes = 24;
+
+template <typename T>
+void writeArray(FILE *f, const vector<T> &v) {
+    if (!v.empty() && fwrite(v.data(), sizeof(T), v.size(), f) != v.size())
+        throw runtime_error("Could not write stroke plan");
+}
+
+template <typename T>
+void readArray(FILE *f, vector<T> &v, uint32_t n) {
+    v.resize(n);
+    if (n > 0 && fread(v.data(), sizeof(T), n, f) != n)
+        throw FileFormatException();
+}
+
+}
+
+void StrokePlan::write(const string &filename) const {
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+        throw runtime_error("Could not open " + filename + " for writing");
+
+    try {
+        int32_t header[3] = {width, height, numAngles};
+        uint32_t n = count();
+        if (fwrite(plan_magic, 1, 4, f) != 4 ||
+            fwrite(&plan_version, sizeof(plan_version), 1, f) != 1 ||
+            fwrite(header, sizeof(int32_t), 3, f) != 3 ||
+            fwrite(&n, sizeof(n), 1, f) != 1)
+            throw runtime_error("Could not write stroke plan");
+
+        writeArray(f, x);
+        writeArray(f, y);
+        writeArray(f, r);
+        writeArray(f, g);
+        writeArray(f, b);
+        writeArray(f, bin);
+        writeArray(f, size);
+        writeArray(f, layer);
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
+    fclose(f);
+}
+
+StrokePlan StrokePlan::read(const string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        throw FileNotFoundException();
+
+    try {
+        char magic[4];
+        uint32_t version, n;
+        int32_t header[3];
+        if (fread(magic, 1, 4, f) != 4 || memcmp(magic, plan_magic, 4) != 0 ||
+            fread(&version, sizeof(version), 1, f) != 1 || version != plan_version ||
+            fread(header, sizeof(int32_t), 3, f) != 3 ||
+            fread(&n, sizeof(n), 1, f) != 1)
+            throw FileFormatException();
+
+        // check the header and the file size before allocating anything
+        if (header[0] < 0 || header[1] < 0 || header[2] < 1 || header[2] > 256)
+            throw FileFormatException();
+        if (fseek(f, 0, SEEK_END) != 0)
+            throw FileFormatException();
+        long length = ftell(f);
+        if (length < plan_header_bytes || (length - plan_header_bytes) / plan_stroke_bytes < static_cast<long>(n) ||
+            fseek(f, plan_header_bytes, SEEK_SET) != 0)
+            throw FileFormatException();
+
+        StrokePlan plan(header[0], header[1], header[2]);
+        readArray(f, plan.x, n);
+        readArray(f, plan.y, n);
+        readArray(f, plan.r, n);
+        readArray(f, plan.g, n);
+        readArray(f, plan.b, n);
+        readArray(f, plan.bin, n);
+        readArray(f, plan.size, n);
+        readArray(f, plan.layer, n);
+        for (uint32_t i = 0; i < n; ++i)
+            if (plan.bin[i] >= plan.numAngles)
+                throw FileFormatException();
+        fclose(f);
+        return plan;
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
+}
+// --------- END SERIALIZATION ----------------------
@@ -0,0 +1,59 @@
+/* --------------------------------------------------------------------------
+ * File:    strokePlan.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Sampled brush strokes, independent of the brush texture and rasterizer
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __strokePlan__h
+#define __strokePlan__h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The output of the sampling phase of a paint mode: every stroke to paint,
+// in painting order, stored as a structure of arrays. A stroke is the brush
+// texture scaled to size pixels and rotated to angle bin `bin` out of
+// numAngles, centered at (x, y) and painted with color (r, g, b). The plan
+// does not depend on the brush texture, so the same plan can be rendered
+// with different brushes or rasterizer backends.
+struct StrokePlan {
+    StrokePlan(int width_ = 0, int height_ = 0, int numAngles_ = 1);
+
+    int width;      // size of the canvas the plan was sampled for
+    int height;
+    int numAngles;  // number of brush rotations the bins refer to
+
+    std::vector<int32_t> x;
+    std::vector<int32_t> y;
+    std::vector<float> r;
+    std::vector<float> g;
+    std::vector<float> b;
+    std::vector<uint8_t> bin;
+    std::vector<uint16_t> size;
+    std::vector<uint8_t> layer;
+
+    // Number of strokes
+    int count() const { return static_cast<int>(x.size()); }
+
+    void reserve(int n);
+    // Throws InvalidArgument unless 0 <= bin_ < numAngles, 0 <= size_ < 65536
+    // and 0 <= layer_ < 256
+    void append(int x_, int y_, const float color[3], int bin_, int size_, int layer_);
+    // Appends all the strokes of other (which must have the same canvas)
+    void append(const StrokePlan &other);
+    // Reorders the strokes: stroke i becomes the stroke that was at order[i]
+    void permute(const std::vector<int> &order);
+
+    // Compact binary serialization (see strokePlan.cpp for the layout). read
+    // throws FileFormatException on a bad header, a file shorter than its
+    // stroke count or a bin out of range.
+    void write(const std::string &filename) const;
+    static StrokePlan read(const std::string &filename);
+};
+
+#endif
@@ -0,0 +1,376 @@
+/* --------------------------------------------------------------------------
+ * File:    strokeRasterizer.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Rasterizer backends turning a StrokePlan into an image
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "strokeRasterizer.h"
+#include "a10.h"
+#include "parallel.h"
+#include "blendKernel.h"
+#include <limits>
+#include <map>
+
+using namespace std;
+
+namespace {
+
+// The atlas used by each stroke in begin..end-1, looked up once per brush size
+vector<const BrushAtlas *> strokeAtlases(const StrokePlan &plan, const Image &texture,
+                                         int begin, int end) {
+    map<int, const BrushAtlas *> by_size;
+    vector<const BrushAtlas *> atlases(plan.count());
+    for (int s = begin; s < end; ++s) {
+        // the compositing loops index the atlas without bounds checks
+        if (plan.bin[s] >= plan.numAngles)
+            throw OutOfBoundsException();
+        const BrushAtlas *&atlas = by_size[plan.size[s]];
+        if (!atlas)
+            atlas = &brushAtlas(texture, plan.size[s], plan.numAngles);
+        atlases[s] = atlas;
+    }
+    return atlases;
+}
+
+// Same rejection rule as brush(): strokes too close to the border of the
+// canvasWidth x canvasHeight canvas are skipped
+bool strokeInside(const StrokePlan &plan, int s, const BrushAtlas &atlas,
+                  int canvasWidth, int canvasHeight)
+{
+    int half_width = atlas.width() / 2;
+    int half_height = atlas.height() / 2;
+    return !((plan.x[s] + half_width >= canvasWidth) || (plan.y[s] + half_height >= canvasHeight) ||
+             (plan.x[s] - half_width < 0) || (plan.y[s] - half_height < 0));
+}
+
+// Sort phase of the tiled backends: the list of the strokes in begin..end-1
+// that cover each tileSize x tileSize tile of the canvas. A stroke lands in
+// every tile its brush overlaps; walking the strokes in order keeps plan
+// order per tile.
+vector<vector<int>> tileBins(const StrokePlan &plan, const vector<const BrushAtlas *> &atlases,
+                             int begin, int end, int canvasWidth, int canvasHeight, int tileSize)
+{
+    int tilesX = (canvasWidth + tileSize - 1) / tileSize;
+    int tilesY = (canvasHeight + tileSize - 1) / tileSize;
+    vector<vector<int>> bins(tilesX * tilesY);
+    for (int s = begin; s < end; ++s)
+    {
+        if (!strokeInside(plan, s, *atlases[s], canvasWidth, canvasHeight))
+            continue;
+
+        int x = plan.x[s];
+        int y = plan.y[s];
+        int half_width = atlases[s]->width() / 2;
+        int half_height = atlases[s]->height() / 2;
+
+        int tx0 = (x - half_width) / tileSize;
+        int tx1 = (x + half_width - 1) / tileSize;
+        int ty0 = (y - half_height) / tileSize;
+        int ty1 = (y + half_height - 1) / tileSize;
+        for (int ty = ty0; ty <= ty1; ++ty)
+            for (int tx = tx0; tx <= tx1; ++tx)
+                bins[tx + ty * tilesX].push_back(s);
+    }
+    return bins;
+}
+
+// Blends the part of stroke s inside [xmin, xmax) x [ymin, ymax) into im.
+// Coordinates are canvas coordinates, and pixel (0, 0) of im is canvas
+// pixel (originX, originY).
+void compositeStroke(Image &im, int originX, int originY,
+                     int xmin, int ymin, int xmax, int ymax,
+                     const StrokePlan &plan, int s, const BrushAtlas &atlas)
+{
+    int half_width = atlas.width() / 2;
+    int half_height = atlas.height() / 2;
+    float color[3] = {plan.r[s], plan.g[s], plan.b[s]};
+
+    int x0 = max(plan.x[s] - half_width, xmin);
+    int x1 = min(plan.x[s] + half_width, xmax);
+    int y0 = max(plan.y[s] - half_height, ymin);
+    int y1 = min(plan.y[s] + half_height, ymax);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // blend the part of each brush row that falls inside the rectangle
+    for (int py = y0; py < y1; ++py)
+    {
+        const float *opacity = atlas.brushes().row(py - plan.y[s] + half_height, plan.bin[s])
+                               + x0 - plan.x[s] + half_width;
+        blendImageRow(im, x0 - originX, py - originY, opacity, color, x1 - x0);
+    }
+}
+
+// Same as compositeStroke, on a fixed point canvas
+void compositeStrokeFixed(const FixedCanvas &canvas, FixedTile &tile, int xmin, int ymin, int xmax, int ymax,
+                          const StrokePlan &plan, int s, const BrushAtlas &atlas)
+{
+    int half_width = atlas.width() / 2;
+    int half_height = atlas.height() / 2;
+
+    int x0 = max(plan.x[s] - half_width, xmin);
+    int x1 = min(plan.x[s] + half_width, xmax);
+    int y0 = max(plan.y[s] - half_height, ymin);
+    int y1 = min(plan.y[s] + half_height, ymax);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    float color[3] = {plan.r[s], plan.g[s], plan.b[s]};
+    uint16_t stored[3];
+    canvas.quantize(color, stored);
+    for (int py = y0; py < y1; ++py)
+    {
+        const uint16_t *opacity = atlas.fixedOpacity(py - plan.y[s] + half_height, plan.bin[s])
+                                  + x0 - plan.x[s] + half_width;
+        tile.blendRow(x0, py, opacity, stored, x1 - x0);
+    }
+}
+
+}
+
+void rasterizeSerial(Image &im,
+                     const StrokePlan &plan,
+                     const Image &texture)
+{
+    vector<const BrushAtlas *> atlases = strokeAtlases(plan, texture, 0, plan.count());
+    for (int s = 0; s < plan.count(); ++s)
+    {
+        float color[3] = {plan.r[s], plan.g[s], plan.b[s]};
+        brush(im, plan.x[s], plan.y[s], color, *atlases[s], plan.bin[s]);
+    }
+}
+
+void rasterizeTiled(Image &im,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int tileSize,
+                    int numThreads)
+{
+    rasterizeRange(im, plan, texture, 0, plan.count(), tileSize, numThreads);
+}
+
+void rasterizeRange(Image &im,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int begin,
+                    int end,
+                    int tileSize,
+                    int numThreads)
+{
+    if (tileSize <= 0)
+        throw InvalidArgument();
+    if (begin < 0 || end > plan.count() || begin > end)
+        throw OutOfBoundsException();
+
+    vector<const BrushAtlas *> atlases = strokeAtlases(plan, texture, begin, end);
+    int tilesX = (im.width() + tileSize - 1) / tileSize;
+    int tilesY = (im.height() + tileSize - 1) / tileSize;
+    vector<vector<int>> bins = tileBins(plan, atlases, begin, end, im.width(), im.height(), tileSize);
+
+    // Composite phase: tiles are disjoint, so each can be painted on its own
+    // thread without synchronisation.
+    parallelFor(0, tilesX * tilesY, [&](int t) {
+        int xmin = (t % tilesX) * tileSize;
+        int ymin = (t / tilesX) * tileSize;
+        int xmax = min(xmin + tileSize, im.width());
+        int ymax = min(ymin + tileSize, im.height());
+
+        const vector<int> &bin = bins[t];
+        for (size_t k = 0; k < bin.size(); ++k)
+            compositeStroke(im, 0, 0, xmin, ymin, xmax, ymax, plan, bin[k], *atlases[bin[k]]);
+    }, numThreads);
+}
+
+void rasterizeWindow(Image &window,
+                     int originX,
+                     int originY,
+                     const StrokePlan &plan,
+                     const Image &texture,
+                     int begin,
+                     int end)
+{
+    if (begin < 0 || end > plan.count() || begin > end)
+        throw OutOfBoundsException();
+
+    vector<const BrushAtlas *> atlases = strokeAtlases(plan, texture, begin, end);
+    int xmax = originX + window.width();
+    int ymax = originY + window.height();
+    for (int s = begin; s < end; ++s)
+    {
+        if (strokeInside(plan, s, *atlases[s], plan.width, plan.height))
+            compositeStroke(window, originX, originY, originX, originY, xmax, ymax, plan, s, *atlases[s]);
+    }
+}
+
+FrontToBackStats rasterizeFrontToBack(Image &im,
+                                      const StrokePlan &plan,
+                                      const Image &texture,
+                                      float saturation,
+                                      int tileSize,
+                                      int numThreads)
+{
+    if (tileSize <= 0 || saturation < 0.0f)
+        throw InvalidArgument();
+    // Below 2^-24, what the strokes underneath could add to a color in [0, 1]
+    // is within its float rounding; going on would only end in denormals,
+    // which are very slow to compute with.
+    saturation = max(saturation, numeric_limits<float>::epsilon() / 2);
+
+    vector<const BrushAtlas *> atlases = strokeAtlases(plan, texture, 0, plan.count());
+    int tilesX = (im.width() + tileSize - 1) / tileSize;
+    int tilesY = (im.height() + tileSize - 1) / tileSize;
+    vector<vector<int>> bins = tileBins(plan, atlases, 0, plan.count(), im.width(), im.height(), tileSize);
+    int channels = min(im.channels(), 3);
+    vector<FrontToBackStats> tile_stats(tilesX * tilesY, FrontToBackStats());
+
+    parallelFor(0, tilesX * tilesY, [&](int t) {
+        int xmin = (t % tilesX) * tileSize;
+        int ymin = (t / tilesX) * tileSize;
+        int w = min(xmin + tileSize, im.width()) - xmin;
+        int h = min(ymin + tileSize, im.height()) - ymin;
+        FrontToBackStats &stats = tile_stats[t];
+
+        vector<float> color(3 * w * h, 0.0f);     // premultiplied, planar
+        vector<float> transmittance(w * h, 1.0f);
+
+        // saturated pixels of each 8x8 block, bit i + 8 * j for pixel (i, j)
+        int blocksX = (w + 7) / 8;
+        int blocksY = (h + 7) / 8;
+        vector<uint64_t> saturated(blocksX * blocksY, 0), full(blocksX * blocksY, 0);
+        for (int by = 0; by < blocksY; ++by)
+            for (int bx = 0; bx < blocksX; ++bx)
+                for (int j = 0; j < min(8, h - 8 * by); ++j)
+                    for (int i = 0; i < min(8, w - 8 * bx); ++i)
+                        full[bx + by * blocksX] |= uint64_t(1) << (i + 8 * j);
+        int open_blocks = blocksX * blocksY;
+        bool crossed = false;           // pixels saturated since the last refresh
+        int since_refresh = 0;
+        const int mask_refresh = 32;    // strokes
+
+        const vector<int> &bin = bins[t];
+        int k = static_cast<int>(bin.size()) - 1;
+        for (; k >= 0 && open_blocks > 0; --k) {
+            int s = bin[k];
+            const BrushAtlas &atlas = *atlases[s];
+            int half_width = atlas.width() / 2;
+            int half_height = atlas.height() / 2;
+            int x0 = max(plan.x[s] - half_width, xmin) - xmin;
+            int x1 = min(plan.x[s] + half_width, xmin + w) - xmin;
+            int y0 = max(plan.y[s] - half_height, ymin) - ymin;
+            int y1 = min(plan.y[s] + half_height, ymin + h) - ymin;
+            if (x0 >= x1 || y0 >= y1)
+                continue;
+            ++stats.strokes;
+
+            bool covered = true;
+            for (int by = y0 / 8; by <= (y1 - 1) / 8 && covered; ++by)
+                for (int bx = x0 / 8; bx <= (x1 - 1) / 8 && covered; ++bx)
+                    covered = saturated[bx + by * blocksX] == full[bx + by * blocksX];
+            if (covered) {
+                ++stats.skippedStrokes;
+                continue;
+            }
+
+            float stroke_color[3] = {plan.r[s], plan.g[s], plan.b[s]};
+            for (int py = y0; py < y1; ++py) {
+                const float *opacity = atlas.brushes().row(py + ymin - plan.y[s] + half_height, plan.bin[s])
+                                       + xmin - plan.x[s] + half_width;
+                int row = py * w;
+                float *planes[3] = {&color[row + x0], &color[row + x0 + w * h], &color[row + x0 + 2 * w * h]};
+                crossed |= underRow(planes, &transmittance[row + x0], opacity + x0, stroke_color, saturation, x1 - x0);
+            }
+
+            // The masks only decide which strokes and tiles to skip (the
+            // row kernel already leaves saturated pixels alone), so they are
+            // brought up to date every few strokes rather than per texel.
+            if (crossed && ++since_refresh >= mask_refresh) {
+                for (int b = 0; b < blocksX * blocksY; ++b) {
+                    if (saturated[b] == full[b])
+                        continue;
+                    int bx = b % blocksX, by = b / blocksX;
+                    for (int j = 0; j < min(8, h - 8 * by); ++j)
+                        for (int i = 0; i < min(8, w - 8 * bx); ++i)
+                            if (transmittance[8 * bx + i + (8 * by + j) * w] <= saturation)
+                                saturated[b] |= uint64_t(1) << (i + 8 * j);
+                    open_blocks -= saturated[b] == full[b];
+                }
+                crossed = false;
+                since_refresh = 0;
+            }
+        }
+        // the whole tile saturated before the first strokes
+        stats.strokes += k + 1;
+        stats.skippedStrokes += k + 1;
+        stats.saturatedTiles += open_blocks == 0;
+
+        // the canvas goes under everything, in either layout
+        int step = im.stride(0);
+        for (int c = 0; c < channels; ++c) {
+            for (int py = 0; py < h && w > 0; ++py) {
+                float *out = &im.at(xmin, ymin + py, c);
+                for (int px = 0; px < w; ++px) {
+                    int p = px + py * w;
+                    out[px * step] = color[p + c * w * h] + transmittance[p] * out[px * step];
+                }
+            }
+        }
+    }, numThreads);
+
+    FrontToBackStats total = FrontToBackStats();
+    for (size_t t = 0; t < tile_stats.size(); ++t) {
+        total.strokes += tile_stats[t].strokes;
+        total.skippedStrokes += tile_stats[t].skippedStrokes;
+        total.saturatedTiles += tile_stats[t].saturatedTiles;
+    }
+    return total;
+}
+
+void rasterizeFixed(FixedCanvas &canvas,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int tileSize,
+                    int numThreads)
+{
+    if (tileSize <= 0)
+        throw InvalidArgument();
+
+    vector<const BrushAtlas *> atlases = strokeAtlases(plan, texture, 0, plan.count());
+    int tilesX = (canvas.width() + tileSize - 1) / tileSize;
+    int tilesY = (canvas.height() + tileSize - 1) / tileSize;
+    vector<vector<int>> bins = tileBins(plan, atlases, 0, plan.count(), canvas.width(), canvas.height(), tileSize);
+
+    parallelFor(0, tilesX * tilesY, [&](int t) {
+        int xmin = (t % tilesX) * tileSize;
+        int ymin = (t / tilesX) * tileSize;
+        int xmax = min(xmin + tileSize, canvas.width());
+        int ymax = min(ymin + tileSize, canvas.height());
+
+        const vector<int> &bin = bins[t];
+        if (bin.empty())
+            return;
+        FixedTile tile(canvas, xmin, ymin, xmax, ymax);
+        for (size_t k = 0; k < bin.size(); ++k)
+            compositeStrokeFixed(canvas, tile, xmin, ymin, xmax, ymax, plan, bin[k], *atlases[bin[k]]);
+        tile.store();
+    }, numThreads);
+}
+
+Image renderStrokePlan(const StrokePlan &plan, const Image &texture)
+{
+    Image out(plan.width, plan.height, 3);
+    rasterizeTiled(out, plan, texture);
+    return out;
+}
+
+Image renderStrokePlan(const StrokePlan &plan, const Image &texture, CanvasPrecision precision)
+{
+    if (precision == CANVAS_FLOAT32)
+        return renderStrokePlan(plan, texture);
+    FixedCanvas canvas(plan.width, plan.height, precision);
+    rasterizeFixed(canvas, plan, texture);
+    return canvas.toImage();
+}
@@ -0,0 +1,108 @@
+/* --------------------------------------------------------------------------
+ * File:    strokeRasterizer.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Rasterizer backends turning a StrokePlan into an image
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __strokeRasterizer__h
+#define __strokeRasterizer__h
+
+#include "Image.h"
+#include "brushAtlas.h"
+#include "fixedCanvas.h"
+#include "strokePlan.h"
+
+// Every backend composites the strokes of plan into im in plan order, with
+// brushes taken from the atlases of texture (one per stroke size, with
+// plan.numAngles rotations). They all produce the same image as calling
+// brush(im, x, y, color, atlas, bin) for each stroke in turn.
+
+// Reference backend: one brush() call per stroke on the calling thread
+void rasterizeSerial(Image &im,
+                     const StrokePlan &plan,
+                     const Image &texture);
+
+// The strokes are first sorted into tileSize x tileSize screen tiles (a
+// stroke lands in every tile its brush overlaps, in plan order), then each
+// tile is composited on its own worker thread. Since every pixel sees the
+// same blends in the same order as the serial loop, the output is identical
+// bit for bit. numThreads = 0 uses one thread per core.
+void rasterizeTiled(Image &im,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int tileSize = 64,
+                    int numThreads = 0);
+
+// Same as rasterizeTiled, for the strokes begin..end-1 of plan only. Drawing
+// a plan in consecutive ranges gives the same image as drawing it at once.
+void rasterizeRange(Image &im,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int begin,
+                    int end,
+                    int tileSize = 64,
+                    int numThreads = 0);
+
+// Composites strokes begin..end-1 of plan into window, a rectangle of the
+// plan canvas whose top left corner is (originX, originY), on the calling
+// thread. Strokes are rejected at the border of the plan canvas (not of
+// window), so rendering every window of a canvas this way gives the same
+// image as rendering the whole canvas.
+void rasterizeWindow(Image &window,
+                     int originX,
+                     int originY,
+                     const StrokePlan &plan,
+                     const Image &texture,
+                     int begin,
+                     int end);
+
+// What rasterizeFrontToBack skipped
+struct FrontToBackStats {
+    long long strokes;          // stroke tiles (a stroke once per tile it covers)
+    long long skippedStrokes;   // ... whose pixels were all saturated already
+    long long saturatedTiles;   // tiles that stopped before their first stroke
+};
+
+// Composites the strokes last to first with the "under" operator: every
+// pixel keeps the color accumulated so far and the transmittance T of the
+// strokes above it,
+//     color += T * opacity * stroke color,    T *= 1 - opacity
+// and the canvas is only blended in under them at the end. A pixel whose
+// T is <= saturation takes nothing from the strokes below it. Each tile
+// keeps a bitmask of its saturated pixels per 8x8 block, skips the strokes
+// that only cover saturated blocks and stops as soon as all its pixels are.
+// The result is not bit for bit that of rasterizeTiled: the under operator
+// sums the same terms in the opposite order, so even with saturation = 0
+// pixels differ by float rounding, within 1e-5 (5e-7 on archie with 40000
+// strokes). A saturation below 2^-24, including 0, is raised to 2^-24, where
+// what the strokes underneath could add is below that rounding. A larger
+// saturation changes pixels by at most saturation times the brightest
+// stroke color on top of it, e.g. less than half an 8 bit step for 1/1024.
+FrontToBackStats rasterizeFrontToBack(Image &im,
+                                      const StrokePlan &plan,
+                                      const Image &texture,
+                                      float saturation = 0.0f,
+                                      int tileSize = 64,
+                                      int numThreads = 0);
+
+// Tiled backend on a fixed point canvas (the size of the plan canvas). Each
+// pixel sees the same strokes in the same order as the float backends, with
+// values quantized to the canvas precision and opacities to Q15. Each tile
+// is blended as a FixedTile.
+void rasterizeFixed(FixedCanvas &canvas,
+                    const StrokePlan &plan,
+                    const Image &texture,
+                    int tileSize = 64,
+                    int numThreads = 0);
+
+// Renders plan on a black canvas of the plan size with the tiled backend
+Image renderStrokePlan(const StrokePlan &plan, const Image &texture);
+
+// Same, on a canvas of the given precision, converted to an Image at the end
+Image renderStrokePlan(const StrokePlan &plan, const Image &texture, CanvasPrecision precision);
+
+#endif
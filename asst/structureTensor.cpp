@@ -0,0 +1,192 @@
+/* --------------------------------------------------------------------------
+ * File:    structureTensor.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Orientation of the structure tensor in closed form
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "structureTensor.h"
+#include "filtering.h"
+#include "lineBuffer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const float half_pi = 1.57079632679f;
+const float pi = 3.14159265359f;
+
+// minimax polynomial for atan(t), t in [0, 1], in powers of t^2
+const float atan_c0 = 0.99997726f, atan_c1 = -0.33262347f, atan_c2 = 0.19354346f;
+const float atan_c3 = -0.11643287f, atan_c4 = 0.05265332f, atan_c5 = -0.01172120f;
+
+// The angle of one tensor, same operations as the SSE2 path
+inline float minorEigenAngle(float xx, float xy, float yy) {
+    float y = 2.0f * xy, x = xx - yy;
+    float ax = fabs(x), ay = fabs(y);
+    float hi = max(ax, ay), lo = min(ax, ay);
+    if (hi == 0.0f)
+        return 0.0f;
+    float t = lo / hi, s = t * t;
+    float r = t * (atan_c0 + s * (atan_c1 + s * (atan_c2 + s * (atan_c3 + s * (atan_c4 + s * atan_c5)))));
+    if (ay > ax) r = half_pi - r;
+    if (x < 0.0f) r = pi - r;
+    if (y < 0.0f) r = -r;
+    // r is in [-pi, pi], so the minor axis 0.5 r + pi/2 is in [0, pi]
+    float angle = 0.5f * r + half_pi;
+    return angle >= pi ? angle - pi : angle;
+}
+
+// Output rows [y0, y1) of structureTensor. The stages, each pulling the rows
+// it needs from the previous one in order:
+//   blurred: luminance blurred horizontally then vertically by sigmaG
+//   smoothed: Sobel products of three blurred rows, blurred horizontally
+//   tensor: smoothed rows blurred vertically, written to the output
+void tensorStrip(const Image &im, Image &tensor, int y0, int y1,
+                 const vector<float> &inner, const vector<float> &outer) {
+    int w = im.width(), h = im.height();
+    int r1 = static_cast<int>(inner.size()) / 2, r2 = static_cast<int>(outer.size()) / 2;
+
+    // first row each stage has to produce
+    int first_smoothed = max(0, y0 - r2);
+    int first_blurred = max(0, first_smoothed - 1);
+    int first_lumi = max(0, first_blurred - r1);
+
+    RowRing lumi(2 * r1 + 1, w), blurred(3, w);
+    RowRing smoothed[3] = {RowRing(2 * r2 + 1, w), RowRing(2 * r2 + 1, w), RowRing(2 * r2 + 1, w)};
+    vector<float> padded(w + 2 * max(r1, r2) + 2), gx(w), gy(w), product(w), luminance(w);
+    int next_lumi = first_lumi, next_blurred = first_blurred, next_smoothed = first_smoothed;
+
+    auto needLumi = [&](int k) {
+        for (; next_lumi <= k; ++next_lumi) {
+            luminanceRow(im, next_lumi, luminance.data());
+            blurRow(luminance.data(), lumi.row(next_lumi), w, inner, padded.data());
+        }
+    };
+    auto needBlurred = [&](int k) {
+        for (; next_blurred <= k; ++next_blurred) {
+            needLumi(min(next_blurred + r1, h - 1));
+            float *out = blurred.row(next_blurred);
+            fill(out, out + w, 0.0f);
+            for (int j = -r1; j <= r1; ++j)
+                accumulateRow(lumi.row(clampRow(next_blurred + j, h)), inner[j + r1], out, w);
+        }
+    };
+    auto needSmoothed = [&](int k) {
+        for (; next_smoothed <= k; ++next_smoothed) {
+            int y = next_smoothed;
+            needBlurred(min(y + 1, h - 1));
+            const float *up = blurred.row(clampRow(y - 1, h));
+            const float *mid = blurred.row(y);
+            const float *down = blurred.row(clampRow(y + 1, h));
+            // Filter::convolve flips the Sobel kernels, so both gradients
+            // are negated, which leaves the products unchanged
+            for (int x = 0; x < w; ++x) {
+                int l = max(x - 1, 0), r = min(x + 1, w - 1);
+                gx[x] = (up[l] - up[r]) + 2.0f * (mid[l] - mid[r]) + (down[l] - down[r]);
+                gy[x] = (up[l] - down[l]) + 2.0f * (up[x] - down[x]) + (up[r] - down[r]);
+            }
+            for (int x = 0; x < w; ++x)
+                product[x] = gx[x] * gx[x];
+            blurRow(product.data(), smoothed[0].row(y), w, outer, padded.data());
+            for (int x = 0; x < w; ++x)
+                product[x] = gx[x] * gy[x];
+            blurRow(product.data(), smoothed[1].row(y), w, outer, padded.data());
+            for (int x = 0; x < w; ++x)
+                product[x] = gy[x] * gy[x];
+            blurRow(product.data(), smoothed[2].row(y), w, outer, padded.data());
+        }
+    };
+
+    for (int y = y0; y < y1; ++y) {
+        needSmoothed(min(y + r2, h - 1));
+        for (int c = 0; c < 3; ++c) {
+            float *out = tensor.row(y, c);
+            fill(out, out + w, 0.0f);
+            for (int j = -r2; j <= r2; ++j)
+                accumulateRow(smoothed[c].row(clampRow(y + j, h)), outer[j + r2], out, w);
+        }
+    }
+}
+
+}
+
+void minorEigenAngles(const float *xx, const float *xy, const float *yy, float *angle, int n) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 sign = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps();
+    const __m128 vhalf_pi = _mm_set1_ps(half_pi), vpi = _mm_set1_ps(pi), two = _mm_set1_ps(2.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(xx + i), b = _mm_loadu_ps(xy + i), c = _mm_loadu_ps(yy + i);
+        __m128 y = _mm_mul_ps(two, b), x = _mm_sub_ps(a, c);
+        __m128 ax = _mm_andnot_ps(sign, x), ay = _mm_andnot_ps(sign, y);
+        __m128 hi = _mm_max_ps(ax, ay), lo = _mm_min_ps(ax, ay);
+        __m128 flat = _mm_cmpeq_ps(hi, zero);
+        // 0 / 0 where flat, masked out below
+        __m128 t = _mm_div_ps(lo, _mm_or_ps(hi, _mm_and_ps(flat, _mm_set1_ps(1.0f))));
+        __m128 s = _mm_mul_ps(t, t);
+        __m128 p = _mm_add_ps(_mm_set1_ps(atan_c4), _mm_mul_ps(s, _mm_set1_ps(atan_c5)));
+        p = _mm_add_ps(_mm_set1_ps(atan_c3), _mm_mul_ps(s, p));
+        p = _mm_add_ps(_mm_set1_ps(atan_c2), _mm_mul_ps(s, p));
+        p = _mm_add_ps(_mm_set1_ps(atan_c1), _mm_mul_ps(s, p));
+        p = _mm_add_ps(_mm_set1_ps(atan_c0), _mm_mul_ps(s, p));
+        __m128 r = _mm_mul_ps(t, p);
+
+        __m128 steep = _mm_cmpgt_ps(ay, ax);
+        r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(vhalf_pi, r)), _mm_andnot_ps(steep, r));
+        __m128 left = _mm_cmplt_ps(x, zero);
+        r = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(vpi, r)), _mm_andnot_ps(left, r));
+        r = _mm_xor_ps(r, _mm_and_ps(sign, _mm_cmplt_ps(y, zero)));
+
+        __m128 result = _mm_add_ps(_mm_mul_ps(half, r), vhalf_pi);
+        result = _mm_sub_ps(result, _mm_and_ps(vpi, _mm_cmpge_ps(result, vpi)));
+        _mm_storeu_ps(angle + i, _mm_andnot_ps(flat, result));
+    }
+#endif
+    for (; i < n; ++i)
+        angle[i] = minorEigenAngle(xx[i], xy[i], yy[i]);
+}
+
+Image structureTensor(const Image &im, float sigmaG, float factorSigma, int numThreads) {
+    if (im.channels() < 3)
+        throw InvalidArgument();
+    vector<float> inner = gauss1DFilterValues(sigmaG, 3.0f);
+    vector<float> outer = gauss1DFilterValues(sigmaG * factorSigma, 3.0f);
+    Image tensor(im.width(), im.height(), 3);
+
+    // every strip recomputes the rows its blurs read above it, so strips
+    // are kept a few times taller than that halo
+    int halo = static_cast<int>(inner.size() / 2 + outer.size() / 2) + 1;
+    if (numThreads <= 0)
+        numThreads = defaultThreadCount();
+    int strips = max(1, min(numThreads, im.height() / (4 * halo)));
+    parallelFor(0, strips, [&](int s) {
+        tensorStrip(im, tensor, im.height() * s / strips, im.height() * (s + 1) / strips, inner, outer);
+    }, numThreads);
+    return tensor;
+}
+
+Image tensorAngles(const Image &tensor, int numThreads) {
+    if (tensor.channels() < 3)
+        throw InvalidArgument();
+    if (tensor.stride(0) != 1)
+        return tensorAngles(tensor.toLayout(IMAGE_PLANAR), numThreads);
+    int width = tensor.width();
+    Image angles(width, tensor.height(), 1);
+    parallelFor(0, tensor.height(), [&](int y) {
+        minorEigenAngles(tensor.row(y, 0), tensor.row(y, 1), tensor.row(y, 2), angles.row(y), width);
+    }, numThreads);
+    return angles;
+}
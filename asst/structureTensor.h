@@ -0,0 +1,40 @@
+/* --------------------------------------------------------------------------
+ * File:    structureTensor.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Orientation of the structure tensor in closed form
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __structureTensor__h
+#define __structureTensor__h
+
+#include "Image.h"
+
+// The structure tensor of im as computeTensor defines it: the Sobel
+// gradients of the luminance blurred by sigmaG, their products xx, xy and
+// yy in channels 0, 1 and 2, blurred by sigmaG * factorSigma. Every stage
+// streams over the rows with line buffers holding only the rows the next
+// stage still needs, so the output is the only full image allocated.
+// Strips of rows are computed in parallel, each with its own buffers.
+Image structureTensor(const Image &im,
+                      float sigmaG = 3.0f,
+                      float factorSigma = 5.0f,
+                      int numThreads = 0);
+
+// Writes to angle[i] the angle in [0, pi) of the eigenvector with the
+// smallest eigenvalue of the symmetric tensor [xx[i] xy[i]; xy[i] yy[i]].
+// The largest one is at 0.5 atan2(2 xy, xx - yy), so no eigen-solver is
+// needed; atan2 is a polynomial accurate to about 1e-6 radians, 4 pixels
+// at a time with SSE2. A tensor with equal eigenvalues has no orientation
+// and gets angle 0.
+void minorEigenAngles(const float *xx, const float *xy, const float *yy, float *angle, int n);
+
+// minorEigenAngles of every pixel of a tensor image laid out as computeTensor
+// returns it (xx, xy and yy in channels 0, 1 and 2), rows in parallel.
+// Returns a single channel image.
+Image tensorAngles(const Image &tensor, int numThreads = 0);
+
+#endif
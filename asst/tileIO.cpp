@@ -0,0 +1,190 @@
+/* --------------------------------------------------------------------------
+ * File:    tileIO.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Rectangle-at-a-time access to images too large to hold in memory
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "tileIO.h"
+#include <algorithm>
+#include <cctype>
+#include <sys/types.h>
+
+using namespace std;
+
+namespace {
+
+int clampTo(int v, int lo, int hi) {
+    return min(max(v, lo), hi);
+}
+
+void checkRegion(const Image &region) {
+    if (region.channels() != 3)
+        throw MismatchedDimensionsException();
+}
+
+unsigned char toByte(float v) {
+    return static_cast<unsigned char>(clampTo(static_cast<int>(v * 255.0f + 0.5f), 0, 255));
+}
+
+// Next whitespace separated number of a PPM header, skipping # comments
+int readHeaderNumber(FILE *f) {
+    int c = fgetc(f);
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#')
+            while (c != EOF && c != '\n')
+                c = fgetc(f);
+        c = fgetc(f);
+    }
+    if (c == EOF || !isdigit(c))
+        throw FileFormatException();
+    int v = 0;
+    while (c != EOF && isdigit(c)) {
+        v = v * 10 + (c - '0');
+        c = fgetc(f);
+    }
+    // exactly one whitespace character ends the header, which this consumed
+    if (c == EOF || !isspace(c))
+        throw FileFormatException();
+    return v;
+}
+
+void seekTo(FILE *f, long long offset) {
+    if (fseeko(f, static_cast<off_t>(offset), SEEK_SET) != 0)
+        throw runtime_error("Could not seek in PPM file");
+}
+
+}
+
+
+// ------------- IMAGES ------------------------------
+void ImageTileSource::read(int x0, int y0, Image &region) const {
+    checkRegion(region);
+    for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < region.height(); ++y) {
+            const float *in = &im.at(0, clampTo(y0 + y, 0, im.height() - 1), c);
+            int step = im.stride(0);
+            for (int x = 0; x < region.width(); ++x)
+                region.at(x, y, c) = in[clampTo(x0 + x, 0, im.width() - 1) * step];
+        }
+    }
+}
+
+void ImageTileSink::write(int x0, int y0, const Image &tile) {
+    checkRegion(tile);
+    if (x0 < 0 || y0 < 0 || x0 + tile.width() > im.width() || y0 + tile.height() > im.height())
+        throw OutOfBoundsException();
+    for (int c = 0; c < 3; ++c)
+        copyValues(ImageView(tile).channel(c),
+                   MutableImageView(im).crop(x0, y0, tile.width(), tile.height()).channel(c));
+}
+// --------- END IMAGES ------------------------------
+
+
+// ------------- PPM FILES ---------------------------
+PPMTileSource::PPMTileSource(const string &filename)
+  : file(fopen(filename.c_str(), "rb")), w(0), h(0), data_offset(0)
+{
+    if (!file)
+        throw FileNotFoundException();
+    try {
+        if (fgetc(file) != 'P' || fgetc(file) != '6')
+            throw FileFormatException();
+        w = readHeaderNumber(file);
+        h = readHeaderNumber(file);
+        if (w <= 0 || h <= 0 || readHeaderNumber(file) != 255)
+            throw FileFormatException();
+        data_offset = ftello(file);
+    } catch (...) {
+        fclose(file);
+        throw;
+    }
+}
+
+PPMTileSource::~PPMTileSource() {
+    fclose(file);
+}
+
+void PPMTileSource::read(int x0, int y0, Image &region) const {
+    checkRegion(region);
+
+    // the columns of the file the region needs, edges included
+    int first = clampTo(x0, 0, w - 1);
+    int last = clampTo(x0 + region.width() - 1, 0, w - 1);
+    vector<unsigned char> row(3 * (last - first + 1));
+
+    for (int y = 0; y < region.height(); ++y) {
+        int file_y = clampTo(y0 + y, 0, h - 1);
+        {
+            lock_guard<mutex> lock(file_mutex);
+            seekTo(file, data_offset + 3 * (static_cast<long long>(file_y) * w + first));
+            if (fread(row.data(), 1, row.size(), file) != row.size())
+                throw FileFormatException();
+        }
+        for (int x = 0; x < region.width(); ++x) {
+            const unsigned char *p = &row[3 * (clampTo(x0 + x, 0, w - 1) - first)];
+            for (int c = 0; c < 3; ++c)
+                region.at(x, y, c) = p[c] / 255.0f;
+        }
+    }
+}
+
+PPMTileSink::PPMTileSink(const string &filename, int width, int height)
+  : file(fopen(filename.c_str(), "w+b")), w(width), h(height), data_offset(0)
+{
+    if (!file)
+        throw runtime_error("Could not open " + filename + " for writing");
+    if (width <= 0 || height <= 0) {
+        fclose(file);
+        throw NegativeDimensionException();
+    }
+
+    // writing the last byte sizes the file; the rest reads back as zeros
+    if (fprintf(file, "P6\n%d %d\n255\n", w, h) < 0 ||
+        (data_offset = ftello(file)) < 0 ||
+        fseeko(file, static_cast<off_t>(data_offset + 3LL * w * h - 1), SEEK_SET) != 0 ||
+        fputc(0, file) == EOF)
+    {
+        fclose(file);
+        throw runtime_error("Could not write " + filename);
+    }
+}
+
+PPMTileSink::~PPMTileSink() {
+    fclose(file);
+}
+
+void PPMTileSink::write(int x0, int y0, const Image &tile) {
+    checkRegion(tile);
+    if (x0 < 0 || y0 < 0 || x0 + tile.width() > w || y0 + tile.height() > h)
+        throw OutOfBoundsException();
+
+    vector<unsigned char> row(3 * tile.width());
+    for (int y = 0; y < tile.height(); ++y) {
+        for (int x = 0; x < tile.width(); ++x)
+            for (int c = 0; c < 3; ++c)
+                row[3 * x + c] = toByte(tile.at(x, y, c));
+
+        lock_guard<mutex> lock(file_mutex);
+        seekTo(file, data_offset + 3 * (static_cast<long long>(y0 + y) * w + x0));
+        if (fwrite(row.data(), 1, row.size(), file) != row.size())
+            throw runtime_error("Could not write PPM file");
+    }
+}
+// --------- END PPM FILES ---------------------------
+
+
+void copyTiles(const TileSource &source, TileSink &sink, int tileSize) {
+    if (tileSize <= 0)
+        throw InvalidArgument();
+    for (int y0 = 0; y0 < source.height(); y0 += tileSize) {
+        for (int x0 = 0; x0 < source.width(); x0 += tileSize) {
+            Image tile(min(tileSize, source.width() - x0), min(tileSize, source.height() - y0), 3);
+            source.read(x0, y0, tile);
+            sink.write(x0, y0, tile);
+        }
+    }
+}
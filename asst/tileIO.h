@@ -0,0 +1,117 @@
+/* --------------------------------------------------------------------------
+ * File:    tileIO.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Rectangle-at-a-time access to images too large to hold in memory
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __tileIO__h
+#define __tileIO__h
+
+#include "Image.h"
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// Read access to a 3 channel image, one rectangle at a time. read() may be
+// called from several threads at once.
+class TileSource {
+public:
+    virtual ~TileSource() {}
+
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+
+    // Fills region (3 channels) with the pixels whose top left corner is
+    // (x0, y0). Pixels outside the image are clamped to the nearest edge,
+    // like smartAccessor(x, y, z, true).
+    virtual void read(int x0, int y0, Image &region) const = 0;
+};
+
+// Write access to a 3 channel image, one rectangle at a time. write() may be
+// called from several threads at once, with disjoint rectangles.
+class TileSink {
+public:
+    virtual ~TileSink() {}
+
+    // Stores tile (3 channels) with its top left corner at (x0, y0). The tile
+    // must lie inside the image.
+    virtual void write(int x0, int y0, const Image &tile) = 0;
+};
+
+// Tiles of an image in memory, for tests and small inputs
+class ImageTileSource : public TileSource {
+public:
+    explicit ImageTileSource(const Image &im_) : im(im_) {}
+
+    int width() const { return im.width(); }
+    int height() const { return im.height(); }
+    void read(int x0, int y0, Image &region) const;
+
+private:
+    const Image &im;
+};
+
+class ImageTileSink : public TileSink {
+public:
+    explicit ImageTileSink(Image &im_) : im(im_) {}
+
+    void write(int x0, int y0, const Image &tile);
+
+private:
+    Image &im;
+};
+
+// Binary 8-bit PPM (P6) files, accessed with a seek per row, so only the
+// rectangle being read or written is ever in memory. Values are mapped
+// between [0, 1] floats and [0, 255] bytes with rounding to nearest, which
+// makes a byte -> float -> byte round trip exact.
+class PPMTileSource : public TileSource {
+public:
+    explicit PPMTileSource(const std::string &filename);
+    ~PPMTileSource();
+
+    int width() const { return w; }
+    int height() const { return h; }
+    void read(int x0, int y0, Image &region) const;
+
+private:
+    FILE *file;
+    int w;
+    int h;
+    long long data_offset;             // start of the pixel data
+    mutable std::mutex file_mutex;     // one seek + read at a time
+
+    PPMTileSource(const PPMTileSource &);
+    PPMTileSource & operator=(const PPMTileSource &);
+};
+
+class PPMTileSink : public TileSink {
+public:
+    // Creates (or truncates) filename as a width x height black image
+    PPMTileSink(const std::string &filename, int width, int height);
+    ~PPMTileSink();
+
+    int width() const { return w; }
+    int height() const { return h; }
+    void write(int x0, int y0, const Image &tile);
+
+private:
+    FILE *file;
+    int w;
+    int h;
+    long long data_offset;
+    std::mutex file_mutex;
+
+    PPMTileSink(const PPMTileSink &);
+    PPMTileSink & operator=(const PPMTileSink &);
+};
+
+// Copies source into sink in tileSize x tileSize blocks, for instance to
+// convert a PPM file into an Image or back
+void copyTiles(const TileSource &source, TileSink &sink, int tileSize = 512);
+
+#endif
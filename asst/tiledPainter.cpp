@@ -0,0 +1,262 @@
+/* --------------------------------------------------------------------------
+ * File:    tiledPainter.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Out-of-core oriented painting of images streamed one tile at a time
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "tiledPainter.h"
+#include "a10.h"
+#include "basicImageManipulation.h"
+#include "brushAtlas.h"
+#include "importanceSampler.h"
+#include "parallel.h"
+#include "strokeRasterizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// Support (in pixels) of a Gaussian blur as built by gauss1DFilterValues
+int gaussSupport(float sigma, float truncate) {
+    return static_cast<int>(ceil(truncate * sigma));
+}
+
+}
+
+vector<int> proportionalShares(const vector<double> &weights, int total) {
+    // each share is a difference of rounded cumulative sums
+    double sum = 0.0;
+    for (size_t i = 0; i < weights.size(); ++i)
+        sum += weights[i];
+
+    vector<int> out(weights.size(), 0);
+    if (sum <= 0.0)
+        return out;
+    double cumulative = 0.0;
+    long long previous = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        cumulative += weights[i];
+        long long next = llround(cumulative / sum * total);
+        out[i] = static_cast<int>(next - previous);
+        previous = next;
+    }
+    return out;
+}
+
+int analysisHalo() {
+    // computeTensor(): blur of sigmaG = 3, Sobel, blur of 5 * sigmaG.
+    // sharpnessEnergy(): blur of sigma = 1 (truncated at 4), blur of 4 * sigma.
+    int tensor = gaussSupport(3.0f, 3.0f) + 1 + gaussSupport(15.0f, 3.0f);
+    int sharpness = gaussSupport(1.0f, 4.0f) + gaussSupport(4.0f, 3.0f);
+    return max(tensor, sharpness) + 1;
+}
+
+int brushRadius(const Image &texture, int size, int numAngles) {
+    const BrushAtlas &atlas = brushAtlas(texture, size, numAngles);
+    return max(atlas.width(), atlas.height()) / 2 + 1;
+}
+
+
+// ------------- TILED STROKES ----------------------
+TiledStrokes::TiledStrokes(int width, int height, int tileSize, int numLayers, int numAngles)
+  : canvas_width(width), canvas_height(height), tile_size(tileSize),
+    tiles_x(0), tiles_y(0), num_layers(numLayers), num_angles(numAngles)
+{
+    if (tileSize <= 0 || numLayers <= 0)
+        throw InvalidArgument();
+    tiles_x = (width + tile_size - 1) / tile_size;
+    tiles_y = (height + tile_size - 1) / tile_size;
+    tiles.assign(numTiles(), StrokePlan(width, height, numAngles));
+    layer_begin.assign(numTiles(), vector<int>(num_layers + 1, 0));
+}
+
+void TiledStrokes::tileRect(int t, int &x0, int &y0, int &w, int &h) const {
+    x0 = (t % tiles_x) * tile_size;
+    y0 = (t / tiles_x) * tile_size;
+    w = min(tile_size, canvas_width - x0);
+    h = min(tile_size, canvas_height - y0);
+}
+
+void TiledStrokes::setTile(int t, const StrokePlan &strokes) {
+    if (t < 0 || t >= numTiles())
+        throw OutOfBoundsException();
+    if (strokes.width != canvas_width || strokes.height != canvas_height ||
+        strokes.numAngles != num_angles)
+        throw MismatchedDimensionsException();
+
+    vector<int> &begin = layer_begin[t];
+    int s = 0;
+    for (int layer = 0; layer < num_layers; ++layer) {
+        begin[layer] = s;
+        while (s < strokes.count() && strokes.layer[s] == layer)
+            ++s;
+    }
+    // anything left is out of order or in a layer we do not have
+    if (s != strokes.count())
+        throw InvalidArgument();
+    begin[num_layers] = s;
+    tiles[t] = strokes;
+}
+
+void TiledStrokes::compositeTile(int t, Image &out, const Image &texture, int brushRadius) const {
+    int x0, y0, w, h;
+    tileRect(t, x0, y0, w, h);
+    if (out.width() != w || out.height() != h)
+        throw MismatchedDimensionsException();
+
+    // tiles whose strokes can reach this one
+    int reach = (brushRadius + tile_size - 1) / tile_size;
+    int tx = t % tiles_x;
+    int ty = t / tiles_x;
+    for (int layer = 0; layer < num_layers; ++layer) {
+        for (int ny = max(ty - reach, 0); ny <= min(ty + reach, tiles_y - 1); ++ny) {
+            for (int nx = max(tx - reach, 0); nx <= min(tx + reach, tiles_x - 1); ++nx) {
+                int n = nx + ny * tiles_x;
+                rasterizeWindow(out, x0, y0, tiles[n], texture,
+                                layer_begin[n][layer], layer_begin[n][layer + 1]);
+            }
+        }
+    }
+}
+
+StrokePlan TiledStrokes::all() const {
+    StrokePlan plan(canvas_width, canvas_height, num_angles);
+    for (int layer = 0; layer < num_layers; ++layer) {
+        for (int t = 0; t < numTiles(); ++t) {
+            const StrokePlan &owned = tiles[t];
+            for (int s = layer_begin[t][layer]; s < layer_begin[t][layer + 1]; ++s) {
+                float color[3] = {owned.r[s], owned.g[s], owned.b[s]};
+                plan.append(owned.x[s], owned.y[s], color, owned.bin[s], owned.size[s], owned.layer[s]);
+            }
+        }
+    }
+    return plan;
+}
+// --------- END TILED STROKES ----------------------
+
+
+StrokePlan sampleOrientedTile(const ImageView &im,
+                              const ImageView &angles,
+                              const ImageView &energy,
+                              int x0, int y0,
+                              int width, int height,
+                              int coarseStrokes,
+                              int fineStrokes,
+                              int size,
+                              float noise,
+                              unsigned int seed,
+                              int tile,
+                              int numAngles)
+{
+    int w = im.width();
+    int h = im.height();
+
+    // a distinct random stream per tile (multiplying by an odd constant is a
+    // bijection, so no two tiles share a key)
+    unsigned int tile_seed = seed ^ (static_cast<unsigned int>(tile) * 0x9E3779B9u);
+    StrokePlan local(w, h, numAngles);
+    sampleSingleScaleOriented(local, im, angles, ImportanceSampler(w, h),
+                              size, coarseStrokes, noise, tile_seed, 0);
+    sampleSingleScaleOriented(local, im, angles, ImportanceSampler(energy),
+                              size / 4, fineStrokes, noise, tile_seed, 1);
+
+    // move the strokes to canvas coordinates
+    StrokePlan owned(width, height, numAngles);
+    owned.reserve(local.count());
+    for (int s = 0; s < local.count(); ++s) {
+        float color[3] = {local.r[s], local.g[s], local.b[s]};
+        owned.append(local.x[s] + x0, local.y[s] + y0, color, local.bin[s], local.size[s], local.layer[s]);
+    }
+    return owned;
+}
+
+
+// ------------- TILED PAINTER ----------------------
+TiledPainter::TiledPainter(const TileSource &source_,
+                           const Image &texture_,
+                           int tileSize,
+                           int numThreads)
+  : source(source_), texture(texture_), num_threads(numThreads), brush_radius(0),
+    tiled(source_.width(), source_.height(), tileSize, 2, num_angles)
+{}
+
+Image TiledPainter::readWithHalo(int t) const {
+    int x0, y0, w, h;
+    tiled.tileRect(t, x0, y0, w, h);
+    int halo = analysisHalo();
+    Image region(w + 2 * halo, h + 2 * halo, 3);
+    source.read(x0 - halo, y0 - halo, region);
+    return region;
+}
+
+void TiledPainter::plan(int strokes, int size, float noise, unsigned int seed) {
+    int num_tiles = tiled.numTiles();
+    int halo = analysisHalo();
+    brush_radius = brushRadius(texture, size, num_angles);
+
+    // Pass 1: how much of the sharpness, and of the area, each tile holds
+    vector<double> area(num_tiles), sharpness(num_tiles);
+    parallelFor(0, num_tiles, [&](int t) {
+        int x0, y0, w, h;
+        tiled.tileRect(t, x0, y0, w, h);
+        Image energy = sharpnessEnergy(readWithHalo(t));
+        double sum = 0.0;
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                sum += energy(halo + x, halo + y);
+        area[t] = static_cast<double>(w) * h;
+        sharpness[t] = sum;
+    }, num_threads);
+
+    vector<int> coarse_strokes = proportionalShares(area, strokes);
+    vector<int> fine_strokes = proportionalShares(sharpness, strokes);
+
+    // Pass 2: each tile samples its strokes from its own analysis
+    parallelFor(0, num_tiles, [&](int t) {
+        int x0, y0, w, h;
+        tiled.tileRect(t, x0, y0, w, h);
+        Image region = readWithHalo(t);
+        Image angles = computeAngles(region), energy = sharpnessEnergy(region);
+        tiled.setTile(t, sampleOrientedTile(ImageView(region).crop(halo, halo, w, h),
+                                            ImageView(angles).crop(halo, halo, w, h),
+                                            ImageView(energy).crop(halo, halo, w, h),
+                                            x0, y0, source.width(), source.height(),
+                                            coarse_strokes[t], fine_strokes[t],
+                                            size, noise, seed, t, num_angles));
+    }, num_threads);
+}
+
+void TiledPainter::composite(TileSink &sink) const {
+    if (brush_radius == 0)
+        throw runtime_error("TiledPainter: composite() called before plan()");
+
+    parallelFor(0, tiled.numTiles(), [&](int t) {
+        int x0, y0, w, h;
+        tiled.tileRect(t, x0, y0, w, h);
+        Image out(w, h, 3);
+        tiled.compositeTile(t, out, texture, brush_radius);
+        sink.write(x0, y0, out);
+    }, num_threads);
+}
+// --------- END TILED PAINTER ----------------------
+
+
+void tiledOrientedPaint(const TileSource &source,
+                        TileSink &sink,
+                        const Image &texture,
+                        int strokes,
+                        int size,
+                        float noise,
+                        unsigned int seed,
+                        int tileSize)
+{
+    TiledPainter painter(source, texture, tileSize);
+    painter.plan(strokes, size, noise, seed);
+    painter.composite(sink);
+}
@@ -0,0 +1,147 @@
+/* --------------------------------------------------------------------------
+ * File:    tiledPainter.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Out-of-core oriented painting of images streamed one tile at a time
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __tiledPainter__h
+#define __tiledPainter__h
+
+#include "Image.h"
+#include "strokePlan.h"
+#include "tileIO.h"
+#include <vector>
+
+// Strokes of a canvas cut into tileSize x tileSize tiles, each tile owning
+// the strokes whose centres fall inside it, sorted by layer. Tiles are
+// composited independently: a tile draws, layer by layer, the strokes of all
+// the tiles within one brush radius of it, in tile order. Every tile thus
+// sees the strokes in the same global order (layer, owning tile, stroke) and
+// there are no seams: the result is the same as rendering all() at once.
+class TiledStrokes {
+public:
+    TiledStrokes(int width, int height, int tileSize, int numLayers, int numAngles);
+
+    int width()     const { return canvas_width; }
+    int height()    const { return canvas_height; }
+    int tileSize()  const { return tile_size; }
+    int tilesX()    const { return tiles_x; }
+    int tilesY()    const { return tiles_y; }
+    int numTiles()  const { return tiles_x * tiles_y; }
+    int numAngles() const { return num_angles; }
+
+    // Core rectangle of tile t
+    void tileRect(int t, int &x0, int &y0, int &w, int &h) const;
+
+    // Replaces the strokes of tile t. strokes is in canvas coordinates and
+    // sorted by layer. Different tiles may be set from different threads.
+    void setTile(int t, const StrokePlan &strokes);
+    const StrokePlan & tile(int t) const { return tiles[t]; }
+
+    // Composites tile t on out (the size of the tile), with brushes that are
+    // at most brushRadius pixels from their centre
+    void compositeTile(int t, Image &out, const Image &texture, int brushRadius) const;
+
+    // All the strokes in compositing order
+    StrokePlan all() const;
+
+private:
+    int canvas_width;
+    int canvas_height;
+    int tile_size;
+    int tiles_x;
+    int tiles_y;
+    int num_layers;
+    int num_angles;
+    std::vector<StrokePlan> tiles;
+    std::vector<std::vector<int>> layer_begin;    // first stroke of each layer, per tile
+};
+
+// Samples the two orientedPaint() layers of the tile whose top left corner
+// is (x0, y0) from its pixels, angles and sharpnessEnergy (views cropped to
+// the tile), and returns them in the coordinates of a width x height canvas.
+// The random stream is keyed by (seed, tile).
+StrokePlan sampleOrientedTile(const ImageView &im,
+                              const ImageView &angles,
+                              const ImageView &energy,
+                              int x0, int y0,
+                              int width, int height,
+                              int coarseStrokes,
+                              int fineStrokes,
+                              int size,
+                              float noise,
+                              unsigned int seed,
+                              int tile,
+                              int numAngles);
+
+// Largest distance from its centre that a stroke of size pixels paints at
+int brushRadius(const Image &texture, int size, int numAngles);
+
+// Pixels of context the analysis (computeAngles and sharpnessEnergy with
+// their default parameters) needs around a pixel
+int analysisHalo();
+
+// Splits total into integer shares proportional to weights that add up to
+// total exactly
+std::vector<int> proportionalShares(const std::vector<double> &weights, int total);
+
+// Paints orientedPaint() style (a uniform coarse layer, then a layer of
+// size/4 strokes drawn from the sharpness) without ever holding the whole
+// image: memory is bounded by a few tiles per thread plus the strokes.
+//   1. stats:  every tile is read with a halo of analysisHalo() pixels and
+//              its share of the total sharpness is measured.
+//   2. plan:   every tile is read again and samples its share of each
+//              layer's strokes from its own analysis.
+//   3. paint:  every output tile is composited from the strokes of its
+//              neighbours (see TiledStrokes) and written to the sink as soon
+//              as it is done.
+class TiledPainter {
+public:
+    TiledPainter(const TileSource &source,
+                 const Image &texture,
+                 int tileSize = 512,
+                 int numThreads = 0);
+
+    // Passes 1 and 2, with the parameters of orientedPaint()
+    void plan(int strokes = 7000,
+              int size = 50,
+              float noise = 0.3f,
+              unsigned int seed = 0);
+
+    // Pass 3. plan() must have been called.
+    void composite(TileSink &sink) const;
+
+    // All the planned strokes in compositing order, for tests
+    StrokePlan strokes() const { return tiled.all(); }
+
+    int tilesX() const { return tiled.tilesX(); }
+    int tilesY() const { return tiled.tilesY(); }
+
+private:
+    const TileSource &source;
+    const Image &texture;
+    int num_threads;
+    int brush_radius;      // of the largest brush, 0 before plan()
+    TiledStrokes tiled;
+
+    static const int num_angles = 36;
+
+    // reads the core of tile t and its halo
+    Image readWithHalo(int t) const;
+};
+
+// Paints source into sink with a TiledPainter
+void tiledOrientedPaint(const TileSource &source,
+                        TileSink &sink,
+                        const Image &texture,
+                        int strokes = 7000,
+                        int size = 50,
+                        float noise = 0.3f,
+                        unsigned int seed = 0,
+                        int tileSize = 512);
+
+#endif
@@ -0,0 +1,238 @@
+/* --------------------------------------------------------------------------
+ * File:    videoPainter.cpp
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Temporally coherent painting of frame sequences with incremental repaint
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#include "videoPainter.h"
+#include "a10.h"
+#include "basicImageManipulation.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+const int num_angles = 36;
+
+}
+
+struct VideoPainter::State {
+    State(int width, int height, int blockSize)
+      : reference(width, height, 3), angles(width, height, 1), energy(width, height, 1),
+        canvas(width, height, 3), tiled(width, height, blockSize, 2, num_angles),
+        block_energy(tiled.numTiles(), 0.0), brush_radius(0)
+    {}
+
+    Image reference;                 // pixels each block was last analysed on
+    Image angles;                    // computeAngles, channel 0
+    Image energy;                    // sharpnessEnergy
+    Image canvas;
+    TiledStrokes tiled;
+    std::vector<int> coarse_strokes; // per block, fixed by the block areas
+    std::vector<double> block_energy;
+    int brush_radius;
+};
+
+VideoPainter::VideoPainter(const Image &texture_,
+                           int strokes_,
+                           int size_,
+                           float noise_,
+                           unsigned int seed_,
+                           float threshold_,
+                           int blockSize,
+                           int numThreads)
+  : texture(texture_), strokes(strokes_), size(size_), noise(noise_), seed(seed_),
+    threshold(threshold_), block_size(blockSize), num_threads(numThreads),
+    num_frames(0), dirty_blocks(0), repainted_blocks(0)
+{
+    if (blockSize <= 0 || threshold_ < 0.0f)
+        throw InvalidArgument();
+}
+
+VideoPainter::~VideoPainter() {}
+
+int VideoPainter::numBlocks() const {
+    return state ? state->tiled.numTiles() : 0;
+}
+
+const Image & VideoPainter::paint(const Image &frame) {
+    if (frame.channels() < 3)
+        throw MismatchedDimensionsException();
+
+    bool first = !state;
+    if (first) {
+        state.reset(new State(frame.width(), frame.height(), block_size));
+        vector<double> area(state->tiled.numTiles());
+        for (int b = 0; b < state->tiled.numTiles(); ++b) {
+            int x0, y0, w, h;
+            state->tiled.tileRect(b, x0, y0, w, h);
+            area[b] = static_cast<double>(w) * h;
+        }
+        state->coarse_strokes = proportionalShares(area, strokes);
+        state->brush_radius = brushRadius(texture, size, num_angles);
+    } else if (frame.width() != state->canvas.width() || frame.height() != state->canvas.height()) {
+        throw MismatchedDimensionsException();
+    }
+    ++num_frames;
+
+    TiledStrokes &tiled = state->tiled;
+    int num_blocks = tiled.numTiles();
+
+    // which blocks changed since they were last analysed
+    vector<char> changed(num_blocks, first);
+    if (!first) {
+        parallelFor(0, num_blocks, [&](int b) {
+            int x0, y0, w, h;
+            tiled.tileRect(b, x0, y0, w, h);
+            double diff = 0.0;
+            for (int c = 0; c < 3; ++c)
+                for (int y = y0; y < y0 + h; ++y)
+                    for (int x = x0; x < x0 + w; ++x)
+                        diff += fabs(frame.at(x, y, c) - state->reference.at(x, y, c));
+            changed[b] = diff / (3.0 * w * h) > threshold;
+        }, num_threads);
+    }
+
+    // The angles and sharpness of a pixel depend on the pixels within
+    // analysisHalo() of it, so the blocks that close to a changed one are
+    // stale too: they are dirty as well.
+    int halo = analysisHalo();
+    int ring = (halo + block_size - 1) / block_size;
+    vector<char> dirty(changed);
+    for (int b = 0; b < num_blocks; ++b) {
+        if (!changed[b] || first)
+            continue;
+        int tx = b % tiled.tilesX(), ty = b / tiled.tilesX();
+        for (int ny = max(ty - ring, 0); ny <= min(ty + ring, tiled.tilesY() - 1); ++ny)
+            for (int nx = max(tx - ring, 0); nx <= min(tx + ring, tiled.tilesX() - 1); ++nx)
+                dirty[nx + ny * tiled.tilesX()] = 1;
+    }
+
+    vector<int> dirty_list;
+    int bx0 = tiled.tilesX(), by0 = tiled.tilesY(), bx1 = -1, by1 = -1;
+    for (int b = 0; b < num_blocks; ++b) {
+        if (dirty[b]) {
+            dirty_list.push_back(b);
+            bx0 = min(bx0, b % tiled.tilesX());
+            bx1 = max(bx1, b % tiled.tilesX());
+            by0 = min(by0, b / tiled.tilesX());
+            by1 = max(by1, b / tiled.tilesX());
+        }
+    }
+    dirty_blocks = static_cast<int>(dirty_list.size());
+    repainted_blocks = 0;
+    if (dirty_list.empty())
+        return state->canvas;
+
+    // Analysis: for the same reason, the dirty blocks can be analysed either
+    // all at once on their bounding box or one by one, whichever reads fewer
+    // pixels, with the same result.
+    ImageTileSource source(frame);
+    auto analyse = [&](int x0, int y0, int w, int h, const vector<int> &blocks) {
+        Image region(w + 2 * halo, h + 2 * halo, 3);
+        source.read(x0 - halo, y0 - halo, region);
+        Image angles = computeAngles(region);
+        Image energy = sharpnessEnergy(region);
+        for (size_t k = 0; k < blocks.size(); ++k) {
+            int cx, cy, cw, ch;
+            tiled.tileRect(blocks[k], cx, cy, cw, ch);
+            for (int y = cy; y < cy + ch; ++y) {
+                const float *a = angles.row(y - y0 + halo, 0) + cx - x0 + halo;
+                const float *e = energy.row(y - y0 + halo, 0) + cx - x0 + halo;
+                copy(a, a + cw, state->angles.row(y) + cx);
+                copy(e, e + cw, state->energy.row(y) + cx);
+            }
+        }
+    };
+
+    int box_x0 = bx0 * block_size, box_y0 = by0 * block_size;
+    int box_w = min((bx1 + 1) * block_size, frame.width()) - box_x0;
+    int box_h = min((by1 + 1) * block_size, frame.height()) - box_y0;
+    double box_pixels = static_cast<double>(box_w + 2 * halo) * (box_h + 2 * halo);
+    double block_pixels = dirty_list.size() * static_cast<double>(block_size + 2 * halo) * (block_size + 2 * halo);
+    if (box_pixels <= block_pixels) {
+        analyse(box_x0, box_y0, box_w, box_h, dirty_list);
+    } else {
+        parallelFor(0, dirty_blocks, [&](int k) {
+            int x0, y0, w, h;
+            tiled.tileRect(dirty_list[k], x0, y0, w, h);
+            analyse(x0, y0, w, h, vector<int>(1, dirty_list[k]));
+        }, num_threads);
+    }
+
+    // remember what the dirty blocks were analysed on, and their sharpness
+    for (int k = 0; k < dirty_blocks; ++k) {
+        int b = dirty_list[k];
+        int x0, y0, w, h;
+        tiled.tileRect(b, x0, y0, w, h);
+        double sum = 0.0;
+        for (int y = y0; y < y0 + h; ++y)
+            for (int x = x0; x < x0 + w; ++x)
+                sum += state->energy.row(y)[x];
+        state->block_energy[b] = sum;
+        for (int c = 0; c < 3; ++c)
+            copyValues(ImageView(frame).crop(x0, y0, w, h).channel(c),
+                       MutableImageView(state->reference).crop(x0, y0, w, h).channel(c));
+    }
+
+    // Fine strokes follow the sharpness: a dirty block gets its share of the
+    // current total. Clean blocks keep their strokes, so the total stroke
+    // count may drift slightly from frame to frame.
+    vector<int> fine_strokes = proportionalShares(state->block_energy, strokes);
+    if (!first) {
+        double total = 0.0;
+        for (int b = 0; b < num_blocks; ++b)
+            total += state->block_energy[b];
+        for (int k = 0; k < dirty_blocks; ++k) {
+            int b = dirty_list[k];
+            fine_strokes[b] = total > 0.0 ? static_cast<int>(llround(strokes * state->block_energy[b] / total)) : 0;
+        }
+    }
+
+    parallelFor(0, dirty_blocks, [&](int k) {
+        int b = dirty_list[k];
+        int x0, y0, w, h;
+        tiled.tileRect(b, x0, y0, w, h);
+        tiled.setTile(b, sampleOrientedTile(ImageView(frame).crop(x0, y0, w, h),
+                                            ImageView(state->angles).crop(x0, y0, w, h),
+                                            ImageView(state->energy).crop(x0, y0, w, h),
+                                            x0, y0, frame.width(), frame.height(),
+                                            state->coarse_strokes[b], fine_strokes[b],
+                                            size, noise, seed, b, num_angles));
+    }, num_threads);
+
+    // composite again every block a resampled stroke can reach
+    int reach = (state->brush_radius + block_size - 1) / block_size;
+    vector<char> repaint(num_blocks, 0);
+    for (int k = 0; k < dirty_blocks; ++k) {
+        int tx = dirty_list[k] % tiled.tilesX();
+        int ty = dirty_list[k] / tiled.tilesX();
+        for (int ny = max(ty - reach, 0); ny <= min(ty + reach, tiled.tilesY() - 1); ++ny)
+            for (int nx = max(tx - reach, 0); nx <= min(tx + reach, tiled.tilesX() - 1); ++nx)
+                repaint[nx + ny * tiled.tilesX()] = 1;
+    }
+    vector<int> repaint_list;
+    for (int b = 0; b < num_blocks; ++b)
+        if (repaint[b])
+            repaint_list.push_back(b);
+    repainted_blocks = static_cast<int>(repaint_list.size());
+
+    ImageTileSink sink(state->canvas);
+    parallelFor(0, repainted_blocks, [&](int k) {
+        int b = repaint_list[k];
+        int x0, y0, w, h;
+        tiled.tileRect(b, x0, y0, w, h);
+        Image out(w, h, 3);
+        tiled.compositeTile(b, out, texture, state->brush_radius);
+        sink.write(x0, y0, out);
+    }, num_threads);
+
+    return state->canvas;
+}
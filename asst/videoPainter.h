@@ -0,0 +1,76 @@
+/* --------------------------------------------------------------------------
+ * File:    videoPainter.h
+ * Created: 2026-10-17
+ * --------------------------------------------------------------------------
+ *
+ * Temporally coherent painting of frame sequences with incremental repaint
+ *
+ * ------------------------------------------------------------------------*/
+
+
+#ifndef __videoPainter__h
+#define __videoPainter__h
+
+#include "Image.h"
+#include "tiledPainter.h"
+#include <memory>
+
+// Paints a sequence of frames orientedPaint() style, keeping the strokes of
+// the previous frame wherever the picture did not change.
+//
+// The canvas is cut into blockSize x blockSize blocks that own the strokes
+// centred in them (see TiledStrokes). For each new frame, a block is dirty
+// when the mean absolute difference between the frame and the pixels the
+// block was last analysed on exceeds threshold; the blocks within
+// analysisHalo() of such a block are dirty too, since their angles and
+// sharpness read its pixels. Only dirty blocks have their angles and
+// sharpness recomputed (on the dirty area plus the analysis halo) and their
+// strokes resampled; only the blocks within one brush radius of a
+// dirty block are composited again. A block always resamples with the same
+// random stream, so strokes that land on unchanged content come back at the
+// same place and the output does not flicker.
+class VideoPainter {
+public:
+    VideoPainter(const Image &texture,
+                 int strokes = 7000,
+                 int size = 50,
+                 float noise = 0.3f,
+                 unsigned int seed = 0,
+                 float threshold = 0.02f,
+                 int blockSize = 64,
+                 int numThreads = 0);
+    ~VideoPainter();
+
+    // Paints the next frame and returns the canvas. Every frame must have
+    // the size of the first one.
+    const Image & paint(const Image &frame);
+
+    // Number of frames painted so far
+    int frames() const { return num_frames; }
+    // Blocks resampled and blocks composited for the last frame
+    int dirtyBlocks() const { return dirty_blocks; }
+    int repaintedBlocks() const { return repainted_blocks; }
+    int numBlocks() const;
+
+private:
+    struct State;
+
+    const Image &texture;
+    int strokes;
+    int size;
+    float noise;
+    unsigned int seed;
+    float threshold;
+    int block_size;
+    int num_threads;
+
+    int num_frames;
+    int dirty_blocks;
+    int repainted_blocks;
+    std::unique_ptr<State> state;   // created by the first frame
+
+    VideoPainter(const VideoPainter &);
+    VideoPainter & operator=(const VideoPainter &);
+};
+
+#endif